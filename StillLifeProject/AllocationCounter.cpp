@@ -0,0 +1,104 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "AllocationCounter.h"
+
+using namespace std;
+
+namespace
+{
+    atomic<bool> gCounting(false);
+    atomic<size_t> gAllocations(0);
+
+    void* allocate(size_t bytes)
+    {
+        if (gCounting.load(memory_order_relaxed))
+            gAllocations.fetch_add(1, memory_order_relaxed);
+        // malloc(0) may return null, new must not
+        return malloc(bytes > 0 ? bytes : 1);
+    }
+
+    void* allocateOrThrow(size_t bytes)
+    {
+        void* memory = allocate(bytes);
+        if (!memory)
+            throw bad_alloc();
+        return memory;
+    }
+}
+
+
+void UStartCountingAllocations()
+{
+    gAllocations = 0;
+    gCounting = true;
+}
+
+
+size_t UStopCountingAllocations()
+{
+    gCounting = false;
+    return gAllocations;
+}
+
+
+// Replacements of the global allocation operators, used by the whole program
+void* operator new(size_t bytes)
+{
+    return allocateOrThrow(bytes);
+}
+
+
+void* operator new[](size_t bytes)
+{
+    return allocateOrThrow(bytes);
+}
+
+
+void* operator new(size_t bytes, const nothrow_t&) noexcept
+{
+    return allocate(bytes);
+}
+
+
+void* operator new[](size_t bytes, const nothrow_t&) noexcept
+{
+    return allocate(bytes);
+}
+
+
+void operator delete(void* memory) noexcept
+{
+    free(memory);
+}
+
+
+void operator delete[](void* memory) noexcept
+{
+    free(memory);
+}
+
+
+void operator delete(void* memory, size_t) noexcept
+{
+    free(memory);
+}
+
+
+void operator delete[](void* memory, size_t) noexcept
+{
+    free(memory);
+}
+
+
+void operator delete(void* memory, const nothrow_t&) noexcept
+{
+    free(memory);
+}
+
+
+void operator delete[](void* memory, const nothrow_t&) noexcept
+{
+    free(memory);
+}
@@ -0,0 +1,14 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstddef>
+
+// Counts every operator new / new[] of the program, whichever container or arena makes it, for benchmarks
+// that must not touch the heap. AllocationCounter.cpp replaces the global allocation operators: they
+// forward to malloc / free and only count between UStartCountingAllocations and UStopCountingAllocations.
+void UStartCountingAllocations();
+
+// Stops counting, returns the allocations made since UStartCountingAllocations
+size_t UStopCountingAllocations();
+
+#endif
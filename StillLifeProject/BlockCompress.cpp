@@ -0,0 +1,471 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BLOCK_COMPRESS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#include "BlockCompress.h"
+
+using namespace std;
+
+namespace
+{
+    // A block in floating point, structure-of-arrays so 4 texels fit an SSE register per channel
+    struct BlockSoA
+    {
+        float c[4][16];     // r, g, b, a
+    };
+
+    void loadBlock(const unsigned char rgba[64], BlockSoA& block)
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            for (int k = 0; k < 4; ++k)
+                block.c[k][i] = rgba[i * 4 + k];
+        }
+    }
+
+    // Principal axis of the texel colors over the first `channels` channels, by power iteration on the covariance
+    void principalAxis(const BlockSoA& block, int channels, float mean[4], float axis[4])
+    {
+        float cov[4][4] = { { 0 } };
+        float minimum[4], maximum[4];
+
+        for (int k = 0; k < 4; ++k)
+        {
+            mean[k] = 0.0f;
+            axis[k] = 0.0f;
+            minimum[k] = 255.0f;
+            maximum[k] = 0.0f;
+        }
+
+        for (int k = 0; k < channels; ++k)
+        {
+            for (int i = 0; i < 16; ++i)
+            {
+                mean[k] += block.c[k][i];
+                minimum[k] = min(minimum[k], block.c[k][i]);
+                maximum[k] = max(maximum[k], block.c[k][i]);
+            }
+            mean[k] /= 16.0f;
+        }
+
+        for (int i = 0; i < 16; ++i)
+        {
+            for (int a = 0; a < channels; ++a)
+            {
+                for (int b = a; b < channels; ++b)
+                    cov[a][b] += (block.c[a][i] - mean[a]) * (block.c[b][i] - mean[b]);
+            }
+        }
+        for (int a = 0; a < channels; ++a)
+        {
+            for (int b = 0; b < a; ++b)
+                cov[a][b] = cov[b][a];
+        }
+
+        // start from the bounding box diagonal, a few iterations converge for 16 points
+        for (int k = 0; k < channels; ++k)
+            axis[k] = maximum[k] - minimum[k];
+
+        for (int iteration = 0; iteration < 8; ++iteration)
+        {
+            float next[4] = { 0, 0, 0, 0 };
+            float length = 0.0f;
+            for (int a = 0; a < channels; ++a)
+            {
+                for (int b = 0; b < channels; ++b)
+                    next[a] += cov[a][b] * axis[b];
+                length = max(length, fabsf(next[a]));
+            }
+            if (length < 1e-6f)
+                break;
+            for (int k = 0; k < channels; ++k)
+                axis[k] = next[k] / length;
+        }
+    }
+
+    // Endpoints at the extreme projections of the texels onto the principal axis
+    void fitEndpoints(const BlockSoA& block, int channels, float e0[4], float e1[4])
+    {
+        float mean[4], axis[4];
+        principalAxis(block, channels, mean, axis);
+
+        float lo = 0.0f, hi = 0.0f;
+        for (int i = 0; i < 16; ++i)
+        {
+            float t = 0.0f;
+            for (int k = 0; k < channels; ++k)
+                t += (block.c[k][i] - mean[k]) * axis[k];
+            lo = min(lo, t);
+            hi = max(hi, t);
+        }
+
+        float axisLength2 = 0.0f;
+        for (int k = 0; k < channels; ++k)
+            axisLength2 += axis[k] * axis[k];
+        if (axisLength2 > 0.0f)
+        {
+            lo /= axisLength2;
+            hi /= axisLength2;
+        }
+
+        for (int k = 0; k < 4; ++k)
+        {
+            e0[k] = k < channels ? min(255.0f, max(0.0f, mean[k] + axis[k] * hi)) : 255.0f;
+            e1[k] = k < channels ? min(255.0f, max(0.0f, mean[k] + axis[k] * lo)) : 255.0f;
+        }
+    }
+
+    // Picks the closest palette entry for every texel and returns the total squared error.
+    // palette holds paletteSize colors as [entry][channel].
+    float selectIndices(const BlockSoA& block, int channels, const float palette[][4], int paletteSize, int indices[16])
+    {
+        float error = 0.0f;
+#ifdef BLOCK_COMPRESS_SSE2
+        for (int group = 0; group < 16; group += 4)
+        {
+            __m128 best = _mm_set1_ps(1e30f);
+            __m128i bestIndex = _mm_setzero_si128();
+            for (int p = 0; p < paletteSize; ++p)
+            {
+                __m128 distance = _mm_setzero_ps();
+                for (int k = 0; k < channels; ++k)
+                {
+                    __m128 d = _mm_sub_ps(_mm_loadu_ps(&block.c[k][group]), _mm_set1_ps(palette[p][k]));
+                    distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+                }
+                __m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+                best = _mm_min_ps(distance, best);
+                bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(p)), _mm_andnot_si128(closer, bestIndex));
+            }
+
+            float bestDistance[4];
+            _mm_storeu_ps(bestDistance, best);
+            _mm_storeu_si128((__m128i*)&indices[group], bestIndex);
+            error += bestDistance[0] + bestDistance[1] + bestDistance[2] + bestDistance[3];
+        }
+#else
+        for (int i = 0; i < 16; ++i)
+        {
+            float best = 1e30f;
+            indices[i] = 0;
+            for (int p = 0; p < paletteSize; ++p)
+            {
+                float distance = 0.0f;
+                for (int k = 0; k < channels; ++k)
+                {
+                    float d = block.c[k][i] - palette[p][k];
+                    distance += d * d;
+                }
+                if (distance < best)
+                {
+                    best = distance;
+                    indices[i] = p;
+                }
+            }
+            error += best;
+        }
+#endif
+        return error;
+    }
+
+    // Least-squares endpoints for fixed interpolation weights (weight of e1 per texel)
+    bool refineEndpoints(const BlockSoA& block, int channels, const float weights[16], float e0[4], float e1[4])
+    {
+        float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+        float ax[4] = { 0, 0, 0, 0 }, bx[4] = { 0, 0, 0, 0 };
+        for (int i = 0; i < 16; ++i)
+        {
+            float b = weights[i];
+            float a = 1.0f - b;
+            aa += a * a;
+            bb += b * b;
+            ab += a * b;
+            for (int k = 0; k < channels; ++k)
+            {
+                ax[k] += a * block.c[k][i];
+                bx[k] += b * block.c[k][i];
+            }
+        }
+
+        float determinant = aa * bb - ab * ab;
+        if (fabsf(determinant) < 1e-6f)
+            return false;
+
+        float inverse = 1.0f / determinant;
+        for (int k = 0; k < channels; ++k)
+        {
+            e0[k] = min(255.0f, max(0.0f, (ax[k] * bb - bx[k] * ab) * inverse));
+            e1[k] = min(255.0f, max(0.0f, (bx[k] * aa - ax[k] * ab) * inverse));
+        }
+        return true;
+    }
+
+    // BC1 /////////////////////////////////////////////////////////////////
+
+    unsigned short packRGB565(const float color[4])
+    {
+        int r = (int)(color[0] * 31.0f / 255.0f + 0.5f);
+        int g = (int)(color[1] * 63.0f / 255.0f + 0.5f);
+        int b = (int)(color[2] * 31.0f / 255.0f + 0.5f);
+        return (unsigned short)((r << 11) | (g << 5) | b);
+    }
+
+    void unpackRGB565(unsigned short packed, float color[4])
+    {
+        int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        color[0] = (float)((r << 3) | (r >> 2));
+        color[1] = (float)((g << 2) | (g >> 4));
+        color[2] = (float)((b << 3) | (b >> 2));
+        color[3] = 255.0f;
+    }
+
+    // Quantizes the endpoints and picks indices, returns the block error
+    float encodeBC1(const BlockSoA& block, const float e0[4], const float e1[4], unsigned short& c0, unsigned short& c1, int indices[16])
+    {
+        c0 = packRGB565(e0);
+        c1 = packRGB565(e1);
+        if (c0 < c1)
+            swap(c0, c1);   // c0 > c1 selects the four color mode
+
+        float palette[4][4];
+        unpackRGB565(c0, palette[0]);
+        unpackRGB565(c1, palette[1]);
+        for (int k = 0; k < 4; ++k)
+        {
+            palette[2][k] = (2.0f * palette[0][k] + palette[1][k]) / 3.0f;
+            palette[3][k] = (palette[0][k] + 2.0f * palette[1][k]) / 3.0f;
+        }
+
+        // equal endpoints fall back to the three color mode, where index 0 is still color0
+        return selectIndices(block, 3, palette, c0 == c1 ? 1 : 4, indices);
+    }
+
+    // BC7 mode 6 //////////////////////////////////////////////////////////
+
+    const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    // 7 bit endpoint plus shared p-bit, the p-bit is chosen per endpoint to minimize error
+    void quantizeBC7Endpoint(const float color[4], int quantized[4], int& pbit)
+    {
+        float bestError = 1e30f;
+        for (int p = 0; p < 2; ++p)
+        {
+            int candidate[4];
+            float error = 0.0f;
+            for (int k = 0; k < 4; ++k)
+            {
+                int q = (int)floorf((color[k] - p) / 2.0f + 0.5f);
+                candidate[k] = min(127, max(0, q));
+                float d = (float)((candidate[k] << 1) | p) - color[k];
+                error += d * d;
+            }
+            if (error < bestError)
+            {
+                bestError = error;
+                pbit = p;
+                memcpy(quantized, candidate, sizeof(candidate));
+            }
+        }
+    }
+
+    float encodeBC7(const BlockSoA& block, const float e0[4], const float e1[4], int q0[4], int q1[4], int& p0, int& p1, int indices[16])
+    {
+        quantizeBC7Endpoint(e0, q0, p0);
+        quantizeBC7Endpoint(e1, q1, p1);
+
+        float palette[16][4];
+        for (int k = 0; k < 4; ++k)
+        {
+            int a = (q0[k] << 1) | p0;
+            int b = (q1[k] << 1) | p1;
+            for (int i = 0; i < 16; ++i)
+                palette[i][k] = (float)(((64 - BC7_WEIGHTS[i]) * a + BC7_WEIGHTS[i] * b + 32) >> 6);
+        }
+        return selectIndices(block, 4, palette, 16, indices);
+    }
+
+    // Writes bits into a 128 bit block, least significant bit first
+    struct BitWriter
+    {
+        unsigned char* out;
+        int position;
+
+        void write(int value, int bits)
+        {
+            for (int i = 0; i < bits; ++i, ++position)
+            {
+                if ((value >> i) & 1)
+                    out[position >> 3] |= (unsigned char)(1 << (position & 7));
+            }
+        }
+    };
+
+    // Gathers a 4x4 block at (bx, by), edge texels are repeated for partial blocks
+    void gatherBlock(const unsigned char* rgba, int width, int height, int bx, int by, unsigned char block[64])
+    {
+        for (int y = 0; y < 4; ++y)
+        {
+            int sy = min(by * 4 + y, height - 1);
+            for (int x = 0; x < 4; ++x)
+            {
+                int sx = min(bx * 4 + x, width - 1);
+                memcpy(&block[(y * 4 + x) * 4], &rgba[((size_t)sy * width + sx) * 4], 4);
+            }
+        }
+    }
+}
+
+
+size_t UBlockSize(BlockFormat format)
+{
+    return format == BLOCK_FORMAT_BC1 ? 8 : 16;
+}
+
+
+size_t UCompressedImageSize(BlockFormat format, int width, int height)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * UBlockSize(format);
+}
+
+
+void UEncodeBC1Block(const unsigned char rgba[64], unsigned char out[8])
+{
+    BlockSoA block;
+    loadBlock(rgba, block);
+
+    float e0[4], e1[4];
+    fitEndpoints(block, 3, e0, e1);
+
+    unsigned short c0, c1;
+    int indices[16];
+    float error = encodeBC1(block, e0, e1, c0, c1, indices);
+
+    // one least-squares pass on the chosen indices, kept only if it lowers the error
+    static const float WEIGHT_OF_C1[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+    if (c0 != c1)
+    {
+        float weights[16];
+        for (int i = 0; i < 16; ++i)
+            weights[i] = WEIGHT_OF_C1[indices[i]];
+
+        float r0[4] = { 0, 0, 0, 255 }, r1[4] = { 0, 0, 0, 255 };
+        unsigned short rc0, rc1;
+        int refined[16];
+        if (refineEndpoints(block, 3, weights, r0, r1) && encodeBC1(block, r0, r1, rc0, rc1, refined) < error)
+        {
+            c0 = rc0;
+            c1 = rc1;
+            memcpy(indices, refined, sizeof(refined));
+        }
+    }
+
+    unsigned int packedIndices = 0;
+    for (int i = 0; i < 16; ++i)
+        packedIndices |= (unsigned int)indices[i] << (i * 2);
+
+    out[0] = (unsigned char)(c0 & 0xff);
+    out[1] = (unsigned char)(c0 >> 8);
+    out[2] = (unsigned char)(c1 & 0xff);
+    out[3] = (unsigned char)(c1 >> 8);
+    for (int i = 0; i < 4; ++i)
+        out[4 + i] = (unsigned char)(packedIndices >> (i * 8));
+}
+
+
+void UEncodeBC7Block(const unsigned char rgba[64], unsigned char out[16])
+{
+    BlockSoA block;
+    loadBlock(rgba, block);
+
+    float e0[4], e1[4];
+    fitEndpoints(block, 4, e0, e1);
+
+    int q0[4], q1[4], p0 = 0, p1 = 0, indices[16];
+    float error = encodeBC7(block, e0, e1, q0, q1, p0, p1, indices);
+
+    // one least-squares pass on the chosen indices, kept only if it lowers the error
+    float weights[16];
+    for (int i = 0; i < 16; ++i)
+        weights[i] = BC7_WEIGHTS[indices[i]] / 64.0f;
+
+    float r0[4], r1[4];
+    int rq0[4], rq1[4], rp0 = 0, rp1 = 0, refined[16];
+    if (refineEndpoints(block, 4, weights, r0, r1) && encodeBC7(block, r0, r1, rq0, rq1, rp0, rp1, refined) < error)
+    {
+        memcpy(q0, rq0, sizeof(q0));
+        memcpy(q1, rq1, sizeof(q1));
+        p0 = rp0;
+        p1 = rp1;
+        memcpy(indices, refined, sizeof(refined));
+    }
+
+    // the anchor index is stored with its top bit implied zero, swap endpoints if needed
+    if (indices[0] >= 8)
+    {
+        for (int k = 0; k < 4; ++k)
+            swap(q0[k], q1[k]);
+        swap(p0, p1);
+        for (int i = 0; i < 16; ++i)
+            indices[i] = 15 - indices[i];
+    }
+
+    memset(out, 0, 16);
+    BitWriter writer = { out, 0 };
+    writer.write(1 << 6, 7);            // mode 6
+    for (int k = 0; k < 4; ++k)
+    {
+        writer.write(q0[k], 7);
+        writer.write(q1[k], 7);
+    }
+    writer.write(p0, 1);
+    writer.write(p1, 1);
+    writer.write(indices[0], 3);
+    for (int i = 1; i < 16; ++i)
+        writer.write(indices[i], 4);
+}
+
+
+void UCompressImage(const unsigned char* rgba, int width, int height, BlockFormat format, unsigned char* out, unsigned int threadCount)
+{
+    int blocksX = (width + 3) / 4;
+    int blocksY = (height + 3) / 4;
+    size_t blockSize = UBlockSize(format);
+
+    if (threadCount == 0)
+        threadCount = max(1u, thread::hardware_concurrency());
+    threadCount = min(threadCount, (unsigned int)blocksY);
+
+    // workers take one row of blocks at a time
+    atomic<int> nextRow(0);
+    vector<thread> workers;
+    for (unsigned int i = 0; i < threadCount; ++i)
+    {
+        workers.push_back(thread([&]()
+        {
+            unsigned char texels[64];
+            for (int by = nextRow++; by < blocksY; by = nextRow++)
+            {
+                for (int bx = 0; bx < blocksX; ++bx)
+                {
+                    gatherBlock(rgba, width, height, bx, by, texels);
+                    unsigned char* block = out + ((size_t)by * blocksX + bx) * blockSize;
+                    if (format == BLOCK_FORMAT_BC1)
+                        UEncodeBC1Block(texels, block);
+                    else
+                        UEncodeBC7Block(texels, block);
+                }
+            }
+        }));
+    }
+
+    for (size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+}
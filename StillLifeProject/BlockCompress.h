@@ -0,0 +1,30 @@
+#ifndef BLOCK_COMPRESS_H
+#define BLOCK_COMPRESS_H
+
+#include <cstddef>
+
+// CPU encoders for the block-compressed texture formats.
+// BC1 (S3TC/DXT1): 8 bytes per 4x4 block, opaque RGB.
+// BC7 (BPTC): 16 bytes per 4x4 block, encoded with mode 6 (one subset, RGBA endpoints, 4 bit indices).
+
+enum BlockFormat
+{
+    BLOCK_FORMAT_BC1,
+    BLOCK_FORMAT_BC7
+};
+
+// Bytes per 4x4 block
+size_t UBlockSize(BlockFormat format);
+
+// Size of a compressed width x height image (partial blocks at the edges are padded)
+size_t UCompressedImageSize(BlockFormat format, int width, int height);
+
+// Encodes one block of 16 RGBA8 texels (row-major) into out
+void UEncodeBC1Block(const unsigned char rgba[64], unsigned char out[8]);
+void UEncodeBC7Block(const unsigned char rgba[64], unsigned char out[16]);
+
+// Encodes a whole RGBA8 image, rows of blocks are split across worker threads (0 = one per hardware
+// thread). out must hold UCompressedImageSize bytes.
+void UCompressImage(const unsigned char* rgba, int width, int height, BlockFormat format, unsigned char* out, unsigned int threadCount = 0);
+
+#endif
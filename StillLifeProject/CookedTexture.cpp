@@ -0,0 +1,240 @@
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "BlockCompress.h"
+#include "CookedTexture.h"
+#include "ImagePreprocess.h"
+#include "TextureDecoder.h"
+
+using namespace std;
+
+namespace
+{
+    const size_t LEVEL_ALIGNMENT = 16;
+
+    size_t alignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    // Larger sizes than any GL implementation accepts are treated as a corrupt header
+    const uint32_t MAX_COOKED_SIZE = 1 << 16;
+
+    // Size in bytes a level of the given format and size must have
+    uint64_t levelSize(uint32_t format, uint32_t width, uint32_t height)
+    {
+        if (format == COOKED_FORMAT_RGBA8)
+            return (uint64_t)width * height * 4;
+        return UCompressedImageSize(format == COOKED_FORMAT_BC1 ? BLOCK_FORMAT_BC1 : BLOCK_FORMAT_BC7, width, height);
+    }
+
+    // Expands a decoded image to 4 channels
+    vector<unsigned char> toRGBA(const DecodedImage& image)
+    {
+        vector<unsigned char> rgba((size_t)image.width * image.height * 4);
+        for (int y = 0; y < image.height; ++y)
+        {
+            const unsigned char* row = image.pixels + (size_t)y * image.stride;
+            for (int x = 0; x < image.width; ++x)
+            {
+                const unsigned char* src = row + (size_t)x * image.channels;
+                unsigned char* dst = &rgba[((size_t)y * image.width + x) * 4];
+                dst[0] = src[0];
+                dst[1] = image.channels > 1 ? src[1] : src[0];
+                dst[2] = image.channels > 2 ? src[2] : src[0];
+                dst[3] = image.channels == 4 ? src[3] : (image.channels == 2 ? src[1] : 255);
+            }
+        }
+        return rgba;
+    }
+
+    // 2x2 box filter, odd edges reuse the last row/column
+    vector<unsigned char> downsample(const vector<unsigned char>& src, int width, int height, int& outWidth, int& outHeight)
+    {
+        outWidth = width > 1 ? width / 2 : 1;
+        outHeight = height > 1 ? height / 2 : 1;
+        vector<unsigned char> dst((size_t)outWidth * outHeight * 4);
+
+        for (int y = 0; y < outHeight; ++y)
+        {
+            int y0 = y * 2;
+            int y1 = y0 + 1 < height ? y0 + 1 : height - 1;
+            for (int x = 0; x < outWidth; ++x)
+            {
+                int x0 = x * 2;
+                int x1 = x0 + 1 < width ? x0 + 1 : width - 1;
+                const unsigned char* a = &src[((size_t)y0 * width + x0) * 4];
+                const unsigned char* b = &src[((size_t)y0 * width + x1) * 4];
+                const unsigned char* c = &src[((size_t)y1 * width + x0) * 4];
+                const unsigned char* d = &src[((size_t)y1 * width + x1) * 4];
+                unsigned char* out = &dst[((size_t)y * outWidth + x) * 4];
+                for (int k = 0; k < 4; ++k)
+                    out[k] = (unsigned char)((a[k] + b[k] + c[k] + d[k] + 2) / 4);
+            }
+        }
+        return dst;
+    }
+}
+
+
+bool CookedTexture::open(const char* path)
+{
+    close();
+    if (!file.open(path))
+        return false;
+
+    if (file.getSize() < sizeof(CookedTextureHeader))
+    {
+        close();
+        return false;
+    }
+
+    header = (const CookedTextureHeader*)file.getData();
+    levels = (const CookedTextureLevel*)(file.getData() + sizeof(CookedTextureHeader));
+
+    bool valid = memcmp(header->magic, "SLTX", 4) == 0 && header->version == COOKED_TEXTURE_VERSION
+        && header->format <= COOKED_FORMAT_BC7
+        && header->width > 0 && header->width <= MAX_COOKED_SIZE && header->height > 0 && header->height <= MAX_COOKED_SIZE
+        && header->levelCount > 0 && header->levelCount <= (uint32_t)UMipLevelCount(header->width, header->height)
+        && file.getSize() >= sizeof(CookedTextureHeader) + header->levelCount * sizeof(CookedTextureLevel);
+
+    // every level must have the size of its place in the mip chain and lie inside the file
+    for (uint32_t i = 0; valid && i < header->levelCount; ++i)
+    {
+        uint32_t width = header->width >> i > 0 ? header->width >> i : 1;
+        uint32_t height = header->height >> i > 0 ? header->height >> i : 1;
+        valid = levels[i].width == width && levels[i].height == height
+            && levels[i].size == levelSize(header->format, width, height)
+            && levels[i].offset <= file.getSize() && levels[i].size <= file.getSize() - levels[i].offset;
+    }
+
+    if (!valid)
+    {
+        cout << "WARNING: " << path << " is not a valid cooked texture" << endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+
+string UCookedTexturePath(const char* sourceFile)
+{
+    string path = sourceFile;
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if (dot != string::npos && (slash == string::npos || dot > slash))
+        path.erase(dot);
+    return path + ".sltex";
+}
+
+
+int UMipLevelCount(int width, int height)
+{
+    int levels = 1;
+    while (width > 1 || height > 1)
+    {
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        ++levels;
+    }
+    return levels;
+}
+
+
+bool UCookTexture(const char* sourceFile, const char* cookedFile, CookedTextureFormat format, int size)
+{
+    DecodedImage image;
+    image.filename = sourceFile;
+    if (!UDecodeImage(image))
+    {
+        cout << "ERROR: Failed to decode " << sourceFile << endl;
+        return false;
+    }
+
+    // build the full mip chain in RGBA8
+    int width = size > 0 ? size : image.width;
+    int height = size > 0 ? size : image.height;
+    int levelCount = UMipLevelCount(width, height);
+    vector< vector<unsigned char> > levelData(levelCount);
+    vector<CookedTextureLevel> levels(levelCount);
+
+    levelData[0] = toRGBA(image);
+    if (width != image.width || height != image.height)
+    {
+        vector<unsigned char> resampled((size_t)width * height * 4);
+        UResampleRGBA(levelData[0].data(), image.width, image.height, resampled.data(), width, height);
+        levelData[0].swap(resampled);
+    }
+    levels[0].width = width;
+    levels[0].height = height;
+    UFreeDecodedImage(image);
+
+    for (int i = 1; i < levelCount; ++i)
+    {
+        int levelWidth, levelHeight;
+        levelData[i] = downsample(levelData[i - 1], levels[i - 1].width, levels[i - 1].height, levelWidth, levelHeight);
+        levels[i].width = levelWidth;
+        levels[i].height = levelHeight;
+    }
+
+    // block-compress every level once the whole RGBA8 chain exists
+    if (format != COOKED_FORMAT_RGBA8)
+    {
+        BlockFormat blockFormat = format == COOKED_FORMAT_BC1 ? BLOCK_FORMAT_BC1 : BLOCK_FORMAT_BC7;
+        for (int i = 0; i < levelCount; ++i)
+        {
+            vector<unsigned char> compressed(UCompressedImageSize(blockFormat, levels[i].width, levels[i].height));
+            UCompressImage(levelData[i].data(), levels[i].width, levels[i].height, blockFormat, compressed.data());
+            levelData[i].swap(compressed);
+        }
+    }
+
+    size_t offset = alignUp(sizeof(CookedTextureHeader) + levelCount * sizeof(CookedTextureLevel), LEVEL_ALIGNMENT);
+    for (int i = 0; i < levelCount; ++i)
+    {
+        levels[i].offset = offset;
+        levels[i].size = levelData[i].size();
+        offset = alignUp(offset + levelData[i].size(), LEVEL_ALIGNMENT);
+    }
+
+    CookedTextureHeader header;
+    memcpy(header.magic, "SLTX", 4);
+    header.version = COOKED_TEXTURE_VERSION;
+    header.format = format;
+    header.width = levels[0].width;
+    header.height = levels[0].height;
+    header.levelCount = levelCount;
+
+    ofstream out(cookedFile, ios::binary | ios::trunc);
+    if (!out)
+    {
+        cout << "ERROR: Cannot write " << cookedFile << endl;
+        return false;
+    }
+
+    out.write((const char*)&header, sizeof(header));
+    out.write((const char*)levels.data(), levelCount * sizeof(CookedTextureLevel));
+
+    static const char padding[LEVEL_ALIGNMENT] = { 0 };
+    for (int i = 0; out && i < levelCount; ++i)
+    {
+        out.write(padding, (streamsize)(levels[i].offset - (uint64_t)out.tellp()));
+        out.write((const char*)levelData[i].data(), levelData[i].size());
+    }
+
+    out.close();
+    bool success = !out.fail();
+    if (success)
+    {
+        static const char* const FORMAT_NAMES[] = { "RGBA8", "BC1", "BC7" };
+        cout << "INFO: Cooked " << sourceFile << " -> " << cookedFile << " (" << FORMAT_NAMES[format] << ", "
+             << levelCount << " levels, " << offset / 1024 << " KB)" << endl;
+    }
+    else
+        cout << "ERROR: Failed writing " << cookedFile << endl;
+
+    return success;
+}
@@ -0,0 +1,68 @@
+#ifndef COOKED_TEXTURE_H
+#define COOKED_TEXTURE_H
+
+#include <cstdint>
+#include <string>
+#include "MappedFile.h"
+
+// A cooked texture (.sltex) holds every mip level already flipped for OpenGL, so loading it is
+// a straight copy from the mapped file into immutable texture storage. Layout:
+//   CookedTextureHeader
+//   CookedTextureLevel[levelCount]
+//   level data, each level starting on a 16 byte boundary
+const uint32_t COOKED_TEXTURE_VERSION = 1;
+
+enum CookedTextureFormat
+{
+    COOKED_FORMAT_RGBA8 = 0,    // 4 bytes per texel
+    COOKED_FORMAT_BC1 = 1,      // 8 bytes per 4x4 block
+    COOKED_FORMAT_BC7 = 2       // 16 bytes per 4x4 block
+};
+
+struct CookedTextureHeader
+{
+    char magic[4];          // "SLTX"
+    uint32_t version;       // COOKED_TEXTURE_VERSION
+    uint32_t format;        // CookedTextureFormat
+    uint32_t width;         // level 0 size in texels
+    uint32_t height;
+    uint32_t levelCount;
+};
+
+struct CookedTextureLevel
+{
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;        // from the start of the file
+    uint64_t size;          // in bytes
+};
+
+// A cooked texture file mapped into memory
+class CookedTexture
+{
+public:
+    // maps and validates the file, returns false if it is missing or not a usable cooked texture
+    bool open(const char* path);
+    void close()                                        { file.close(); header = nullptr; levels = nullptr; }
+
+    const CookedTextureHeader& getHeader() const        { return *header; }
+    const CookedTextureLevel& getLevel(int level) const { return levels[level]; }
+    const unsigned char* getLevelData(int level) const  { return file.getData() + levels[level].offset; }
+
+private:
+    MappedFile file;
+    const CookedTextureHeader* header = nullptr;
+    const CookedTextureLevel* levels = nullptr;
+};
+
+// Path of the cooked version of an image: the file name with its extension replaced by .sltex
+std::string UCookedTexturePath(const char* sourceFile);
+
+// Decodes sourceFile, builds its full mip chain, block-compresses it for the BC formats and writes it to cookedFile.
+// A non-zero size resamples the image to size x size first (texture array layers all share one size).
+bool UCookTexture(const char* sourceFile, const char* cookedFile, CookedTextureFormat format = COOKED_FORMAT_RGBA8, int size = 0);
+
+// Number of mip levels down to 1x1
+int UMipLevelCount(int width, int height);
+
+#endif
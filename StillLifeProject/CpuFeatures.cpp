@@ -0,0 +1,56 @@
+#include "CpuFeatures.h"
+
+#if defined(CPU_X86_SIMD) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace
+{
+    struct CpuFeatures
+    {
+        bool ssse3 = false;
+        bool avx2 = false;
+
+        CpuFeatures()
+        {
+#if defined(CPU_X86_SIMD) && defined(_MSC_VER)
+            int info[4] = { 0, 0, 0, 0 };
+            __cpuid(info, 0);
+            int maxLeaf = info[0];
+            __cpuid(info, 1);
+            ssse3 = (info[2] & (1 << 9)) != 0;
+            bool osxsave = (info[2] & (1 << 27)) != 0;
+            bool avx = (info[2] & (1 << 28)) != 0;
+
+            // AVX2 also needs the OS to save the YMM registers
+            if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6)
+            {
+                __cpuidex(info, 7, 0);
+                avx2 = (info[1] & (1 << 5)) != 0;
+            }
+#elif defined(CPU_X86_SIMD)
+            ssse3 = __builtin_cpu_supports("ssse3") != 0;
+            avx2 = __builtin_cpu_supports("avx2") != 0;
+#endif
+        }
+    };
+
+    const CpuFeatures& cpuFeatures()
+    {
+        static const CpuFeatures features;
+        return features;
+    }
+}
+
+
+bool UCpuHasSSSE3()
+{
+    return cpuFeatures().ssse3;
+}
+
+
+bool UCpuHasAVX2()
+{
+    return cpuFeatures().avx2;
+}
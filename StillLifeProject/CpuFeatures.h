@@ -0,0 +1,18 @@
+#ifndef CPU_FEATURES_H
+#define CPU_FEATURES_H
+
+// x86 builds always have SSE2; SSSE3 and AVX2 kernels are compiled alongside and picked at runtime
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CPU_X86_SIMD 1
+#ifdef _MSC_VER
+#define CPU_TARGET(isa)     // MSVC emits any intrinsic without /arch
+#else
+#define CPU_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+// Instruction sets of the running CPU, detected on first use
+bool UCpuHasSSSE3();
+bool UCpuHasAVX2();
+
+#endif
@@ -0,0 +1,185 @@
+#include <GL/glew.h>
+
+// the wrappers below call the real GL 1.1 functions
+#define GL_CALL_COUNTER_IMPLEMENTATION
+#include "GLCallCounter.h"
+
+namespace
+{
+    unsigned long long gCalls = 0;
+
+    // One wrapper per entry point, Slot is GLEW's pointer to it. call's arguments are deduced from the
+    // pointer type when it is assigned.
+    template <typename Proc, Proc* Slot>
+    struct CountedEntry
+    {
+        static Proc original;
+
+        template <typename... Args>
+        static auto GLAPIENTRY call(Args... args) -> decltype(original(args...))
+        {
+            ++gCalls;
+            return original(args...);
+        }
+    };
+    template <typename Proc, Proc* Slot>
+    Proc CountedEntry<Proc, Slot>::original = nullptr;
+
+    // entry points the driver doesn't have stay null
+    template <typename Proc, Proc* Slot>
+    void UCountCalls()
+    {
+        typedef CountedEntry<Proc, Slot> Entry;
+        if (*Slot && !Entry::original)
+        {
+            Entry::original = *Slot;
+            *Slot = &Entry::call;
+        }
+    }
+}
+
+#define COUNT_GL_CALLS(function) UCountCalls<decltype(function), &function>()
+
+
+void UInstallGLCallCounters()
+{
+    // programs and uniforms
+    COUNT_GL_CALLS(glUseProgram);
+    COUNT_GL_CALLS(glGetUniformLocation);
+    COUNT_GL_CALLS(glUniform1f);
+    COUNT_GL_CALLS(glUniform2fv);
+    COUNT_GL_CALLS(glUniform3f);
+    COUNT_GL_CALLS(glUniform3fv);
+    COUNT_GL_CALLS(glUniform3i);
+    COUNT_GL_CALLS(glUniformMatrix4fv);
+
+    // buffers and vertex arrays
+    COUNT_GL_CALLS(glBindBuffer);
+    COUNT_GL_CALLS(glBindBufferBase);
+    COUNT_GL_CALLS(glBindBufferRange);
+    COUNT_GL_CALLS(glBufferData);
+    COUNT_GL_CALLS(glBufferSubData);
+    COUNT_GL_CALLS(glMapBufferRange);
+    COUNT_GL_CALLS(glUnmapBuffer);
+    COUNT_GL_CALLS(glBindVertexArray);
+    COUNT_GL_CALLS(glBindVertexBuffer);
+
+    // textures and samplers
+    COUNT_GL_CALLS(glActiveTexture);
+    COUNT_GL_CALLS(glBindSampler);
+    COUNT_GL_CALLS(glTexSubImage3D);
+    COUNT_GL_CALLS(glCompressedTexSubImage3D);
+    COUNT_GL_CALLS(glTexPageCommitmentARB);
+
+    // draws
+    COUNT_GL_CALLS(glDrawElementsBaseVertex);
+    COUNT_GL_CALLS(glDrawElementsInstancedBaseVertexBaseInstance);
+    COUNT_GL_CALLS(glMultiDrawElementsIndirect);
+    COUNT_GL_CALLS(glPatchParameteri);
+
+    // synchronization and timer queries
+    COUNT_GL_CALLS(glFenceSync);
+    COUNT_GL_CALLS(glClientWaitSync);
+    COUNT_GL_CALLS(glDeleteSync);
+    COUNT_GL_CALLS(glBeginQuery);
+    COUNT_GL_CALLS(glEndQuery);
+    COUNT_GL_CALLS(glGetQueryObjectiv);
+    COUNT_GL_CALLS(glGetQueryObjectui64v);
+}
+
+
+unsigned long long UGLCallCount()
+{
+    return gCalls;
+}
+
+
+void UCountedBindTexture(GLenum target, GLuint texture)
+{
+    ++gCalls;
+    glBindTexture(target, texture);
+}
+
+
+void UCountedClear(GLbitfield mask)
+{
+    ++gCalls;
+    glClear(mask);
+}
+
+
+void UCountedClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha)
+{
+    ++gCalls;
+    glClearColor(red, green, blue, alpha);
+}
+
+
+void UCountedDisable(GLenum cap)
+{
+    ++gCalls;
+    glDisable(cap);
+}
+
+
+void UCountedDrawArrays(GLenum mode, GLint first, GLsizei count)
+{
+    ++gCalls;
+    glDrawArrays(mode, first, count);
+}
+
+
+void UCountedDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+{
+    ++gCalls;
+    glDrawElements(mode, count, type, indices);
+}
+
+
+void UCountedEnable(GLenum cap)
+{
+    ++gCalls;
+    glEnable(cap);
+}
+
+
+void UCountedFinish()
+{
+    ++gCalls;
+    glFinish();
+}
+
+
+void UCountedGetIntegerv(GLenum pname, GLint* data)
+{
+    ++gCalls;
+    glGetIntegerv(pname, data);
+}
+
+
+const GLubyte* UCountedGetString(GLenum name)
+{
+    ++gCalls;
+    return glGetString(name);
+}
+
+
+void UCountedGetTexParameteriv(GLenum target, GLenum pname, GLint* params)
+{
+    ++gCalls;
+    glGetTexParameteriv(target, pname, params);
+}
+
+
+void UCountedTexParameteri(GLenum target, GLenum pname, GLint param)
+{
+    ++gCalls;
+    glTexParameteri(target, pname, param);
+}
+
+
+void UCountedViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    ++gCalls;
+    glViewport(x, y, width, height);
+}
@@ -0,0 +1,46 @@
+#ifndef GL_CALL_COUNTER_H
+#define GL_CALL_COUNTER_H
+
+#include <GL/glew.h>
+
+// Counts the GL calls the renderer makes. Each of GLEW's function pointers is swapped for a wrapper that
+// bumps the count and forwards; installed once after glewInit, before any other GL call.
+void UInstallGLCallCounters();
+
+// Calls counted so far
+unsigned long long UGLCallCount();
+
+// GL 1.1 functions (glClear, glBindTexture, glDrawArrays...) are linked straight from the system library,
+// not reached through GLEW, so there is no pointer to swap. Files including this header call them through
+// these counting wrappers instead.
+void UCountedBindTexture(GLenum target, GLuint texture);
+void UCountedClear(GLbitfield mask);
+void UCountedClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha);
+void UCountedDisable(GLenum cap);
+void UCountedDrawArrays(GLenum mode, GLint first, GLsizei count);
+void UCountedDrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices);
+void UCountedEnable(GLenum cap);
+void UCountedFinish();
+void UCountedGetIntegerv(GLenum pname, GLint* data);
+const GLubyte* UCountedGetString(GLenum name);
+void UCountedGetTexParameteriv(GLenum target, GLenum pname, GLint* params);
+void UCountedTexParameteri(GLenum target, GLenum pname, GLint param);
+void UCountedViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+#ifndef GL_CALL_COUNTER_IMPLEMENTATION
+#define glBindTexture       UCountedBindTexture
+#define glClear             UCountedClear
+#define glClearColor        UCountedClearColor
+#define glDisable           UCountedDisable
+#define glDrawArrays        UCountedDrawArrays
+#define glDrawElements      UCountedDrawElements
+#define glEnable            UCountedEnable
+#define glFinish            UCountedFinish
+#define glGetIntegerv       UCountedGetIntegerv
+#define glGetString         UCountedGetString
+#define glGetTexParameteriv UCountedGetTexParameteriv
+#define glTexParameteri     UCountedTexParameteri
+#define glViewport          UCountedViewport
+#endif
+
+#endif
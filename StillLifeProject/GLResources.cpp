@@ -0,0 +1,181 @@
+#include "GLResources.h"
+
+namespace
+{
+    const char* const KIND_NAMES[GL_RESOURCE_KIND_COUNT] = { "textures", "buffers", "vertex arrays", "programs", "samplers" };
+}
+
+
+GLuint GLResourceRegistry::createTexture(const char* label)
+{
+    GLuint id = 0;
+    glGenTextures(1, &id);
+    return track(GL_RESOURCE_TEXTURE, id, label);
+}
+
+
+GLuint GLResourceRegistry::createBuffer(const char* label)
+{
+    GLuint id = 0;
+    glGenBuffers(1, &id);
+    return track(GL_RESOURCE_BUFFER, id, label);
+}
+
+
+GLuint GLResourceRegistry::createVertexArray(const char* label)
+{
+    GLuint id = 0;
+    glGenVertexArrays(1, &id);
+    return track(GL_RESOURCE_VERTEX_ARRAY, id, label);
+}
+
+
+GLuint GLResourceRegistry::createProgram(const char* label)
+{
+    return track(GL_RESOURCE_PROGRAM, glCreateProgram(), label);
+}
+
+
+GLuint GLResourceRegistry::createSampler(const char* label)
+{
+    GLuint id = 0;
+    glGenSamplers(1, &id);
+    return track(GL_RESOURCE_SAMPLER, id, label);
+}
+
+
+void GLResourceRegistry::setSize(GLResourceKind kind, GLuint id, size_t bytes)
+{
+    std::vector<Entry>::iterator it = find(kind, id);
+    if (it != entries.end())
+        it->bytes = bytes;
+}
+
+
+void GLResourceRegistry::destroy(GLResourceKind kind, GLuint id)
+{
+    if (id == 0)
+        return;
+
+    std::vector<Entry>::iterator it = find(kind, id);
+    if (it == entries.end())
+        return; // not owned by the registry (or already released)
+
+    deleteObject(kind, id);
+    entries.erase(it);
+}
+
+
+void GLResourceRegistry::destroyAll()
+{
+    while (!entries.empty())
+    {
+        deleteObject(entries.back().kind, entries.back().id);
+        entries.pop_back();
+    }
+}
+
+
+unsigned int GLResourceRegistry::getLiveCount(GLResourceKind kind) const
+{
+    unsigned int count = 0;
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        if (entries[i].kind == kind)
+            ++count;
+    }
+    return count;
+}
+
+
+size_t GLResourceRegistry::getLiveBytes(GLResourceKind kind) const
+{
+    size_t bytes = 0;
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        if (entries[i].kind == kind)
+            bytes += entries[i].bytes;
+    }
+    return bytes;
+}
+
+
+void GLResourceRegistry::report(std::ostream& out) const
+{
+    size_t totalBytes = 0;
+    out << "INFO: GPU resources:" << std::endl;
+    for (int kind = 0; kind < GL_RESOURCE_KIND_COUNT; ++kind)
+    {
+        size_t bytes = getLiveBytes((GLResourceKind)kind);
+        totalBytes += bytes;
+        out << "    " << KIND_NAMES[kind] << ": " << getLiveCount((GLResourceKind)kind) << " live, ~"
+            << bytes / 1024 << " KB" << std::endl;
+    }
+    out << "    total: ~" << totalBytes / 1024 << " KB" << std::endl;
+}
+
+
+unsigned int GLResourceRegistry::reportLeaks(std::ostream& out) const
+{
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        out << "WARNING: leaked " << KIND_NAMES[entries[i].kind] << " object " << entries[i].id
+            << " (" << entries[i].label << ", ~" << entries[i].bytes / 1024 << " KB)" << std::endl;
+    }
+
+    if (entries.empty())
+        out << "INFO: No GPU resource leaks" << std::endl;
+
+    return (unsigned int)entries.size();
+}
+
+
+GLuint GLResourceRegistry::track(GLResourceKind kind, GLuint id, const char* label)
+{
+    if (id == 0)
+        return 0;
+
+    Entry entry;
+    entry.kind = kind;
+    entry.id = id;
+    entry.bytes = 0;
+    entry.label = label ? label : "";
+    entries.push_back(entry);
+    return id;
+}
+
+
+void GLResourceRegistry::deleteObject(GLResourceKind kind, GLuint id)
+{
+    switch (kind)
+    {
+    case GL_RESOURCE_TEXTURE:
+        glDeleteTextures(1, &id);
+        break;
+    case GL_RESOURCE_BUFFER:
+        glDeleteBuffers(1, &id);
+        break;
+    case GL_RESOURCE_VERTEX_ARRAY:
+        glDeleteVertexArrays(1, &id);
+        break;
+    case GL_RESOURCE_PROGRAM:
+        glDeleteProgram(id);
+        break;
+    case GL_RESOURCE_SAMPLER:
+        glDeleteSamplers(1, &id);
+        break;
+    default:
+        break;
+    }
+}
+
+
+std::vector<GLResourceRegistry::Entry>::iterator GLResourceRegistry::find(GLResourceKind kind, GLuint id)
+{
+    for (std::vector<Entry>::iterator it = entries.begin(); it != entries.end(); ++it)
+    {
+        if (it->kind == kind && it->id == id)
+            return it;
+    }
+    return entries.end();
+}
@@ -0,0 +1,71 @@
+#ifndef GL_RESOURCES_H
+#define GL_RESOURCES_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <GL/glew.h>
+
+// Categories of GL objects owned by the registry
+enum GLResourceKind
+{
+    GL_RESOURCE_TEXTURE,
+    GL_RESOURCE_BUFFER,
+    GL_RESOURCE_VERTEX_ARRAY,
+    GL_RESOURCE_PROGRAM,
+    GL_RESOURCE_SAMPLER,
+    GL_RESOURCE_KIND_COUNT
+};
+
+// Owns every GL object the application creates. Objects are created and deleted through the
+// registry so it can report live counts and estimated GPU memory per category, and flag
+// anything that was never released before shutdown.
+class GLResourceRegistry
+{
+public:
+    GLResourceRegistry() {}
+    ~GLResourceRegistry() {}
+
+    // creation, label is used in reports
+    GLuint createTexture(const char* label);
+    GLuint createBuffer(const char* label);
+    GLuint createVertexArray(const char* label);
+    GLuint createProgram(const char* label);
+    GLuint createSampler(const char* label);
+
+    // records the estimated GPU memory used by an object (texture levels, buffer store)
+    void setSize(GLResourceKind kind, GLuint id, size_t bytes);
+
+    // deletes a single object, 0 is ignored like glDelete* does
+    void destroy(GLResourceKind kind, GLuint id);
+
+    // deletes every live object in reverse creation order
+    void destroyAll();
+
+    unsigned int getLiveCount(GLResourceKind kind) const;
+    size_t getLiveBytes(GLResourceKind kind) const;
+
+    // prints live counts and bytes per category
+    void report(std::ostream& out) const;
+
+    // prints every object still alive and returns how many there are
+    unsigned int reportLeaks(std::ostream& out) const;
+
+private:
+    struct Entry
+    {
+        GLResourceKind kind;
+        GLuint id;
+        size_t bytes;
+        std::string label;
+    };
+
+    GLuint track(GLResourceKind kind, GLuint id, const char* label);
+    void deleteObject(GLResourceKind kind, GLuint id);
+    std::vector<Entry>::iterator find(GLResourceKind kind, GLuint id);
+
+    std::vector<Entry> entries;     // live objects in creation order
+};
+
+#endif
@@ -0,0 +1,295 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "GeometryPool.h"
+
+using namespace std;
+
+
+void GeometryPool::create(GLResourceRegistry& resources, size_t vertexCapacityHint, size_t indexCapacityHint,
+                          bool quantizePositions, const GLfloat boundsLow[3], const GLfloat boundsHigh[3])
+{
+    registry = &resources;
+    quantized = quantizePositions && boundsLow && boundsHigh;
+    vertexSize = quantized ? sizeof(QuantizedVertex) : sizeof(PackedVertex);
+    for (int k = 0; k < 3; ++k)
+    {
+        // normalized shorts cover -1..1, mapped onto the bounds
+        positionScale[k] = quantized ? max((boundsHigh[k] - boundsLow[k]) * 0.5f, 1e-6f) : 1.0f;
+        positionOffset[k] = quantized ? (boundsHigh[k] + boundsLow[k]) * 0.5f : 0.0f;
+    }
+
+    // the stores are created by the first reserve, the vertex attributes point into the vertex store
+    vao = resources.createVertexArray("scene geometry");
+    vbo = ebo = 0;
+    vertexCapacity = indexCapacity = 0;
+    vertexCount = indexCount = meshCount = 0;
+    indexType = GL_UNSIGNED_SHORT;
+    writtenBytes = 0;
+    reallocations = 0;
+    reserve(vertexCapacityHint, indexCapacityHint, GL_UNSIGNED_SHORT);
+}
+
+
+void GeometryPool::destroy(GLResourceRegistry& resources)
+{
+    resources.destroy(GL_RESOURCE_VERTEX_ARRAY, vao);
+    resources.destroy(GL_RESOURCE_BUFFER, vbo);
+    resources.destroy(GL_RESOURCE_BUFFER, ebo);
+    vao = vbo = ebo = 0;
+    vertexCapacity = indexCapacity = 0;
+    vertexCount = indexCount = meshCount = 0;
+    indexType = GL_UNSIGNED_SHORT;
+    staging.clear();
+}
+
+
+void GeometryPool::reserve(size_t vertexTotal, size_t indexTotal, GLenum type)
+{
+    glBindVertexArray(vao);
+    grow(vertexTotal, indexTotal, type);
+    glBindVertexArray(0);
+}
+
+
+MeshRange GeometryPool::add(const PoolVertex* meshVertices, size_t meshVertexCount, const GLuint* meshIndices, size_t meshIndexCount)
+{
+    MeshRange range;
+    range.firstIndex = (GLuint)indexCount;
+    range.indexCount = (GLuint)meshIndexCount;
+    range.baseVertex = (GLint)vertexCount;
+
+    GLuint maxIndex = meshIndexCount == 0 ? 0 : *max_element(meshIndices, meshIndices + meshIndexCount);
+    glBindVertexArray(vao);
+    grow(vertexCount + meshVertexCount, indexCount + meshIndexCount, UIndexTypeFor((size_t)maxIndex + 1));
+
+    // the vertices are packed straight into the store
+    size_t firstByte = vertexCount * vertexSize;
+    size_t bytes = meshVertexCount * vertexSize;
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    unsigned char* out = mapNewRange(GL_ARRAY_BUFFER, firstByte, bytes);
+    for (size_t i = 0; i < meshVertexCount; ++i)
+        pack(meshVertices[i], out + i * vertexSize);
+    unmapNewRange(GL_ARRAY_BUFFER, firstByte, bytes);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    writtenBytes += bytes;
+
+    firstByte = indexCount * getIndexSize();
+    bytes = meshIndexCount * getIndexSize();
+    if (meshIndexCount > 0)
+    {
+        out = mapNewRange(GL_ELEMENT_ARRAY_BUFFER, firstByte, bytes);
+        UStoreIndices(meshIndices, meshIndexCount, indexType, out);
+        unmapNewRange(GL_ELEMENT_ARRAY_BUFFER, firstByte, bytes);
+    }
+    glBindVertexArray(0);
+    writtenBytes += bytes;
+
+    vertexCount += meshVertexCount;
+    indexCount += meshIndexCount;
+    ++meshCount;
+    return range;
+}
+
+
+void GeometryPool::bind() const
+{
+    glBindVertexArray(vao);
+}
+
+
+void GeometryPool::draw(const MeshRange& range) const
+{
+    glDrawElementsBaseVertex(GL_TRIANGLES, range.indexCount, getIndexType(), (void*)(range.firstIndex * getIndexSize()), range.baseVertex);
+}
+
+
+// Moves the stores into new buffers holding at least the given counts, doubling so repeated adds stay cheap.
+// The contents are copied on the GPU; an index store widened to 32-bit is read back once and converted.
+// Expects the vertex array to be bound, it is repointed at the new buffers.
+void GeometryPool::grow(size_t vertexTotal, size_t indexTotal, GLenum type)
+{
+    if (vertexTotal > vertexCapacity)
+    {
+        size_t capacity = max(vertexTotal, vertexCapacity * 2);
+        GLuint store = registry->createBuffer("scene vertices");
+        glBindBuffer(GL_ARRAY_BUFFER, store);
+        glBufferData(GL_ARRAY_BUFFER, capacity * vertexSize, nullptr, GL_STATIC_DRAW);
+        if (vertexCount > 0)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, vbo);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ARRAY_BUFFER, 0, 0, vertexCount * vertexSize);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            ++reallocations;
+        }
+        registry->destroy(GL_RESOURCE_BUFFER, vbo);
+        registry->setSize(GL_RESOURCE_BUFFER, store, capacity * vertexSize);
+        vbo = store;
+        vertexCapacity = capacity;
+        setVertexAttributes();
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    bool widen = type == GL_UNSIGNED_INT && indexType == GL_UNSIGNED_SHORT;
+    if (indexTotal > indexCapacity || widen || !ebo)
+    {
+        size_t capacity = max(indexTotal, indexTotal > indexCapacity ? indexCapacity * 2 : indexCapacity);
+        GLenum storeType = widen ? GL_UNSIGNED_INT : indexType;
+        GLuint store = registry->createBuffer("scene indices");
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, store);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, capacity * UIndexTypeSize(storeType), nullptr, GL_STATIC_DRAW);
+        if (indexCount > 0)
+        {
+            glBindBuffer(GL_COPY_READ_BUFFER, ebo);
+            if (widen)
+            {
+                vector<GLushort> narrow(indexCount);
+                glGetBufferSubData(GL_COPY_READ_BUFFER, 0, indexCount * sizeof(GLushort), narrow.data());
+                vector<GLuint> wide(narrow.begin(), narrow.end());
+                glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, indexCount * sizeof(GLuint), wide.data());
+            }
+            else
+            {
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ELEMENT_ARRAY_BUFFER, 0, 0, indexCount * getIndexSize());
+            }
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            ++reallocations;
+        }
+        registry->destroy(GL_RESOURCE_BUFFER, ebo);
+        registry->setSize(GL_RESOURCE_BUFFER, store, capacity * UIndexTypeSize(storeType));
+        ebo = store;
+        indexCapacity = capacity;
+        indexType = storeType;
+    }
+}
+
+
+// The attribute pointers capture the buffer bound to GL_ARRAY_BUFFER, expects the vertex array and vertex store bound
+void GeometryPool::setVertexAttributes() const
+{
+    if (quantized)
+        glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, (GLsizei)vertexSize, (void*)offsetof(QuantizedVertex, position));
+    else
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, (GLsizei)vertexSize, (void*)offsetof(PackedVertex, position));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, (GLsizei)vertexSize,
+                          (void*)(quantized ? offsetof(QuantizedVertex, normal) : offsetof(PackedVertex, normal)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, (GLsizei)vertexSize,
+                          (void*)(quantized ? offsetof(QuantizedVertex, uv) : offsetof(PackedVertex, uv)));
+    glEnableVertexAttribArray(2);
+}
+
+
+// Maps a range past everything drawn so far for writing. Nothing has read it, so the map neither waits for
+// the GPU nor preserves the old contents; the driver transfers the range after the unmap while the next mesh
+// is packed. If the driver cannot map, the range is packed into staging and written with glBufferSubData.
+unsigned char* GeometryPool::mapNewRange(GLenum target, size_t offset, size_t bytes)
+{
+    if (bytes == 0)
+        return nullptr;
+    if (!mapFailed)
+    {
+        void* mapped = glMapBufferRange(target, offset, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (mapped)
+            return (unsigned char*)mapped;
+        cout << "WARNING: Geometry pool could not map its buffers, writing through a staging copy" << endl;
+        mapFailed = true;
+    }
+    staging.resize(bytes);
+    return staging.data();
+}
+
+
+// glUnmapBuffer fails when the store was lost while mapped (a display mode change). There is no copy
+// to restore it from, so this is reported and the later ranges go through staging.
+void GeometryPool::unmapNewRange(GLenum target, size_t offset, size_t bytes)
+{
+    if (bytes == 0)
+        return;
+    if (mapFailed)
+    {
+        glBufferSubData(target, offset, bytes, staging.data());
+        return;
+    }
+    if (!glUnmapBuffer(target))
+    {
+        cout << "ERROR: Geometry pool buffer contents were lost while mapped" << endl;
+        mapFailed = true;
+    }
+}
+
+
+void GeometryPool::pack(const PoolVertex& vertex, unsigned char* out) const
+{
+    uint32_t normal = UPackNormal(vertex.normal);
+    uint16_t uv[2] = { UFloatToHalf(vertex.uv[0]), UFloatToHalf(vertex.uv[1]) };
+
+    if (quantized)
+    {
+        QuantizedVertex packed;
+        for (int k = 0; k < 3; ++k)
+        {
+            float unit = (vertex.position[k] - positionOffset[k]) / positionScale[k];
+            packed.position[k] = (int16_t)lrintf(max(-1.0f, min(1.0f, unit)) * 32767.0f);
+        }
+        packed.position[3] = 0;
+        packed.normal = normal;
+        memcpy(packed.uv, uv, sizeof(uv));
+        memcpy(out, &packed, sizeof(packed));
+    }
+    else
+    {
+        PackedVertex packed;
+        memcpy(packed.position, vertex.position, sizeof(packed.position));
+        packed.normal = normal;
+        memcpy(packed.uv, uv, sizeof(uv));
+        memcpy(out, &packed, sizeof(packed));
+    }
+}
+
+
+uint16_t UFloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int exponent = (int)((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if (exponent >= 31)     // overflow, infinity and NaN
+        return (uint16_t)(sign | 0x7C00 | (((bits >> 23) & 0xFF) == 0xFF && mantissa ? 0x200 : 0));
+    if (exponent <= 0)      // denormal or zero
+    {
+        if (exponent < -10)
+            return (uint16_t)sign;
+        mantissa |= 0x800000;
+        int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t middle = 1u << (shift - 1);
+        if (rest > middle || (rest == middle && (half & 1)))
+            ++half;
+        return (uint16_t)(sign | half);
+    }
+
+    uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        ++half;     // may carry into the exponent, which rounds up correctly
+    return (uint16_t)half;
+}
+
+
+uint32_t UPackNormal(const GLfloat normal[3])
+{
+    uint32_t packed = 0;
+    for (int k = 0; k < 3; ++k)
+    {
+        int value = (int)lrintf(max(-1.0f, min(1.0f, normal[k])) * 511.0f);
+        packed |= ((uint32_t)value & 0x3FF) << (10 * k);
+    }
+    return packed;
+}
@@ -0,0 +1,124 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <GL/glew.h>
+
+#include "GLResources.h"
+#include "IndexBuffer.h"
+
+// Vertex as the generators produce it, packed by the pool on upload
+struct PoolVertex
+{
+    GLfloat position[3];
+    GLfloat normal[3];
+    GLfloat uv[2];
+};
+
+// Describes PoolVertex for the mesh cache keys, change it with the struct
+const char* const POOL_VERTEX_FORMAT = "position 3f, normal 3f, uv 2f";
+
+// Vertex layouts in the pool's buffer. Normals are GL_INT_2_10_10_10_REV, UVs half floats.
+struct PackedVertex             // 20 bytes
+{
+    GLfloat position[3];
+    uint32_t normal;
+    uint16_t uv[2];
+};
+
+struct QuantizedVertex          // 16 bytes, positions as normalized shorts inside the pool bounds
+{
+    int16_t position[4];        // w is padding
+    uint32_t normal;
+    uint16_t uv[2];
+};
+
+// Where a mesh lives in the pool. Indices are relative to the mesh's first vertex, the draw adds baseVertex.
+struct MeshRange
+{
+    GLuint firstIndex = 0;
+    GLuint indexCount = 0;
+    GLint baseVertex = 0;
+};
+
+// All scene geometry in one vertex buffer and one index buffer, described by a single vertex array.
+// Meshes are offset ranges drawn with glDrawElementsBaseVertex, so switching meshes needs no binds.
+// Adding a mesh maps the new ranges of the stores and packs the vertices and indices straight into
+// them, the pool keeps no CPU copy. When the capacity runs out the stores are moved into larger
+// buffers on the GPU with glCopyBufferSubData.
+class GeometryPool
+{
+public:
+    GeometryPool() {}
+    ~GeometryPool() {}
+
+    // Creates the vertex array and the two buffers with room for the given counts.
+    // With quantized positions every vertex must lie inside boundsLow..boundsHigh, positions outside are clamped.
+    void create(GLResourceRegistry& resources, size_t vertexCapacity, size_t indexCapacity,
+                bool quantizePositions = false, const GLfloat boundsLow[3] = nullptr, const GLfloat boundsHigh[3] = nullptr);
+    void destroy(GLResourceRegistry& resources);
+
+    // Makes room for the given totals so the adds up to them never reallocate a store
+    void reserve(size_t vertexCount, size_t indexCount, GLenum indexType);
+
+    // appends a mesh, its indices are local to its vertices. The index store is 16-bit until a mesh
+    // has more than 65536 vertices, then the whole store is widened to 32-bit.
+    MeshRange add(const PoolVertex* vertices, size_t vertexCount, const GLuint* indices, size_t indexCount);
+    MeshRange add(const std::vector<PoolVertex>& vertices, const std::vector<GLuint>& indices)
+    {
+        return add(vertices.data(), vertices.size(), indices.data(), indices.size());
+    }
+
+    // binds the vertex array, once before any number of draws
+    void bind() const;
+    void draw(const MeshRange& range) const;
+    GLenum getIndexType() const     { return indexType; }
+    size_t getIndexSize() const     { return UIndexTypeSize(indexType); }
+
+    // The vertex shader rebuilds positions as offset + scale * attribute (1 and 0 for float positions)
+    const GLfloat* getPositionScale() const     { return positionScale; }
+    const GLfloat* getPositionOffset() const    { return positionOffset; }
+
+    size_t getVertexCount() const   { return vertexCount; }
+    size_t getIndexCount() const    { return indexCount; }
+    size_t getMeshCount() const     { return meshCount; }
+    size_t getVertexSize() const    { return vertexSize; }
+    size_t getWrittenBytes() const  { return writtenBytes; }
+    unsigned int getReallocations() const { return reallocations; }
+
+private:
+    void grow(size_t vertexCount, size_t indexCount, GLenum indexType);
+    void setVertexAttributes() const;
+    unsigned char* mapNewRange(GLenum target, size_t offset, size_t bytes);
+    void unmapNewRange(GLenum target, size_t offset, size_t bytes);
+    void pack(const PoolVertex& vertex, unsigned char* out) const;
+
+    GLResourceRegistry* registry = nullptr;
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLuint ebo = 0;
+    bool quantized = false;
+    size_t vertexSize = sizeof(PackedVertex);
+    GLfloat positionScale[3] = { 1.0f, 1.0f, 1.0f };
+    GLfloat positionOffset[3] = { 0.0f, 0.0f, 0.0f };
+    size_t vertexCapacity = 0;
+    size_t indexCapacity = 0;
+    GLenum indexType = GL_UNSIGNED_SHORT;
+    size_t vertexCount = 0;
+    size_t indexCount = 0;
+    size_t meshCount = 0;
+    size_t writtenBytes = 0;            // packed into mapped ranges
+    unsigned int reallocations = 0;     // stores moved into larger buffers
+    bool mapFailed = false;             // after a failed map or unmap the ranges go through staging
+    std::vector<unsigned char> staging;
+};
+
+// Float to IEEE half, round to nearest even
+uint16_t UFloatToHalf(float value);
+
+// Unit normal to GL_INT_2_10_10_10_REV, signed normalized with w = 0
+uint32_t UPackNormal(const GLfloat normal[3]);
+
+#endif
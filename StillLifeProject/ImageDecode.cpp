@@ -0,0 +1,570 @@
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#include "CpuFeatures.h"
+#include "ImageDecode.h"
+
+#ifdef CPU_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#define STBI_SIMD 1         // must match ImageDecodeStb.c, it exposes the kernel hooks
+#include "stb_image_aug.h"
+
+using namespace std;
+
+namespace
+{
+    // Same fixed point constants and rounding as stb_image_aug, so every kernel set is bit exact
+    int f2f(float x)
+    {
+        return (int)(x * 4096 + 0.5);
+    }
+
+    int float2fixed(float x)
+    {
+        return (int)(x * 65536 + 0.5);
+    }
+
+    unsigned char clampPixel(int x)
+    {
+        return (unsigned char)(x < 0 ? 0 : (x > 255 ? 255 : x));
+    }
+
+    // jidctint DCT_ISLOW on 8 values, the bias is added to the even part before descaling
+    void idct1D(int s[8], int bias)
+    {
+        int p2 = s[2], p3 = s[6];
+        int p1 = (p2 + p3) * f2f(0.5411961f);
+        int t2 = p1 + p3 * f2f(-1.847759065f);
+        int t3 = p1 + p2 * f2f(0.765366865f);
+        int t0 = (s[0] + s[4]) << 12;
+        int t1 = (s[0] - s[4]) << 12;
+        int x0 = t0 + t3 + bias, x3 = t0 - t3 + bias;
+        int x1 = t1 + t2 + bias, x2 = t1 - t2 + bias;
+
+        t0 = s[7]; t1 = s[5]; t2 = s[3]; t3 = s[1];
+        p3 = t0 + t2;
+        int p4 = t1 + t3;
+        p1 = t0 + t3;
+        p2 = t1 + t2;
+        int p5 = (p3 + p4) * f2f(1.175875602f);
+        t0 *= f2f(0.298631336f);
+        t1 *= f2f(2.053119869f);
+        t2 *= f2f(3.072711026f);
+        t3 *= f2f(1.501321110f);
+        p1 = p5 + p1 * f2f(-0.899976223f);
+        p2 = p5 + p2 * f2f(-2.562915447f);
+        p3 *= f2f(-1.961570560f);
+        p4 *= f2f(-0.390180644f);
+        t3 += p1 + p4;
+        t2 += p2 + p3;
+        t1 += p2 + p4;
+        t0 += p1 + p3;
+
+        s[0] = x0 + t3; s[7] = x0 - t3;
+        s[1] = x1 + t2; s[6] = x1 - t2;
+        s[2] = x2 + t1; s[5] = x2 - t1;
+        s[3] = x3 + t0; s[4] = x3 - t0;
+    }
+
+    // Bias of the row pass also carries the +128 level shift
+    const int COLUMN_BIAS = 512;
+    const int ROW_BIAS = 65536 + (128 << 17);
+
+    void idctScalar(stbi_uc* out, int outStride, short data[64], unsigned short* dequantize)
+    {
+        int values[64];
+        for (int x = 0; x < 8; ++x)
+        {
+            int s[8];
+            for (int y = 0; y < 8; ++y)
+                s[y] = data[y * 8 + x] * dequantize[y * 8 + x];
+            idct1D(s, COLUMN_BIAS);
+            for (int y = 0; y < 8; ++y)
+                values[y * 8 + x] = s[y] >> 10;
+        }
+
+        for (int y = 0; y < 8; ++y, out += outStride)
+        {
+            int s[8];
+            for (int x = 0; x < 8; ++x)
+                s[x] = values[y * 8 + x];
+            idct1D(s, ROW_BIAS);
+            for (int x = 0; x < 8; ++x)
+                out[x] = clampPixel(s[x] >> 17);
+        }
+    }
+
+    void YCbCrToRGBScalar(stbi_uc* out, stbi_uc const* y, stbi_uc const* cb, stbi_uc const* cr, int count, int step)
+    {
+        for (int i = 0; i < count; ++i, out += step)
+        {
+            int yFixed = (y[i] << 16) + 32768;
+            int crValue = cr[i] - 128;
+            int cbValue = cb[i] - 128;
+            out[0] = clampPixel((yFixed + crValue * float2fixed(1.40200f)) >> 16);
+            out[1] = clampPixel((yFixed - crValue * float2fixed(0.71414f) - cbValue * float2fixed(0.34414f)) >> 16);
+            out[2] = clampPixel((yFixed + cbValue * float2fixed(1.77200f)) >> 16);
+            out[3] = 255;
+        }
+    }
+
+#ifdef CPU_X86_SIMD
+    // 16 bit lanes, one row of 8 coefficients per register. Dequantized values and the column pass
+    // results fit 16 bits for any real JPEG. On malformed input the multiplies and adds wrap, so those
+    // blocks can decode to other (still 0-255) pixels than the scalar path.
+    void idctSSE2(stbi_uc* out, int outStride, short data[64], unsigned short* dequantize)
+    {
+        __m128i row[8];
+        for (int i = 0; i < 8; ++i)
+            row[i] = _mm_mullo_epi16(_mm_loadu_si128((const __m128i*)(data + i * 8)), _mm_loadu_si128((const __m128i*)(dequantize + i * 8)));
+
+        // a rotation multiplies interleaved pairs (x, y) by (c0, c1) with one madd
+        struct Rotation
+        {
+            __m128i lo, hi;
+        };
+        auto rotate = [](__m128i x, __m128i y, int c0, int c1, Rotation& result)
+        {
+            __m128i c = _mm_setr_epi16((short)c0, (short)c1, (short)c0, (short)c1, (short)c0, (short)c1, (short)c0, (short)c1);
+            result.lo = _mm_madd_epi16(_mm_unpacklo_epi16(x, y), c);
+            result.hi = _mm_madd_epi16(_mm_unpackhi_epi16(x, y), c);
+        };
+        auto widen = [](__m128i x, Rotation& result)
+        {
+            result.lo = _mm_srai_epi32(_mm_unpacklo_epi16(_mm_setzero_si128(), x), 4);
+            result.hi = _mm_srai_epi32(_mm_unpackhi_epi16(_mm_setzero_si128(), x), 4);
+        };
+        auto add = [](const Rotation& a, const Rotation& b) { Rotation r = { _mm_add_epi32(a.lo, b.lo), _mm_add_epi32(a.hi, b.hi) }; return r; };
+        auto sub = [](const Rotation& a, const Rotation& b) { Rotation r = { _mm_sub_epi32(a.lo, b.lo), _mm_sub_epi32(a.hi, b.hi) }; return r; };
+        auto butterfly = [](const Rotation& a, const Rotation& b, __m128i bias, int shift, __m128i& sum, __m128i& difference)
+        {
+            __m128i lo = _mm_add_epi32(a.lo, bias), hi = _mm_add_epi32(a.hi, bias);
+            sum = _mm_packs_epi32(_mm_srai_epi32(_mm_add_epi32(lo, b.lo), shift), _mm_srai_epi32(_mm_add_epi32(hi, b.hi), shift));
+            difference = _mm_packs_epi32(_mm_srai_epi32(_mm_sub_epi32(lo, b.lo), shift), _mm_srai_epi32(_mm_sub_epi32(hi, b.hi), shift));
+        };
+
+        auto pass = [&](__m128i bias, int shift)
+        {
+            // even part
+            Rotation t2, t3, t0, t1;
+            rotate(row[2], row[6], f2f(0.5411961f), f2f(0.5411961f) + f2f(-1.847759065f), t2);
+            rotate(row[2], row[6], f2f(0.5411961f) + f2f(0.765366865f), f2f(0.5411961f), t3);
+            widen(_mm_add_epi16(row[0], row[4]), t0);
+            widen(_mm_sub_epi16(row[0], row[4]), t1);
+            Rotation x0 = add(t0, t3), x3 = sub(t0, t3), x1 = add(t1, t2), x2 = sub(t1, t2);
+
+            // odd part
+            Rotation y0, y1, y2, y3, y4, y5;
+            rotate(row[7], row[3], f2f(-1.961570560f) + f2f(0.298631336f), f2f(-1.961570560f), y0);
+            rotate(row[7], row[3], f2f(-1.961570560f), f2f(-1.961570560f) + f2f(3.072711026f), y2);
+            rotate(row[5], row[1], f2f(-0.390180644f) + f2f(2.053119869f), f2f(-0.390180644f), y1);
+            rotate(row[5], row[1], f2f(-0.390180644f), f2f(-0.390180644f) + f2f(1.501321110f), y3);
+            __m128i sum17 = _mm_add_epi16(row[1], row[7]);
+            __m128i sum35 = _mm_add_epi16(row[3], row[5]);
+            rotate(sum17, sum35, f2f(1.175875602f) + f2f(-0.899976223f), f2f(1.175875602f), y4);
+            rotate(sum17, sum35, f2f(1.175875602f), f2f(1.175875602f) + f2f(-2.562915447f), y5);
+            Rotation x4 = add(y0, y4), x5 = add(y1, y5), x6 = add(y2, y5), x7 = add(y3, y4);
+
+            butterfly(x0, x7, bias, shift, row[0], row[7]);
+            butterfly(x1, x6, bias, shift, row[1], row[6]);
+            butterfly(x2, x5, bias, shift, row[2], row[5]);
+            butterfly(x3, x4, bias, shift, row[3], row[4]);
+        };
+
+        // 16 bit 8x8 transpose in three interleave steps
+        auto interleave16 = [](__m128i& a, __m128i& b)
+        {
+            __m128i t = a;
+            a = _mm_unpacklo_epi16(a, b);
+            b = _mm_unpackhi_epi16(t, b);
+        };
+        auto interleave8 = [](__m128i& a, __m128i& b)
+        {
+            __m128i t = a;
+            a = _mm_unpacklo_epi8(a, b);
+            b = _mm_unpackhi_epi8(t, b);
+        };
+
+        pass(_mm_set1_epi32(COLUMN_BIAS), 10);
+
+        interleave16(row[0], row[4]); interleave16(row[1], row[5]); interleave16(row[2], row[6]); interleave16(row[3], row[7]);
+        interleave16(row[0], row[2]); interleave16(row[1], row[3]); interleave16(row[4], row[6]); interleave16(row[5], row[7]);
+        interleave16(row[0], row[1]); interleave16(row[2], row[3]); interleave16(row[4], row[5]); interleave16(row[6], row[7]);
+
+        pass(_mm_set1_epi32(ROW_BIAS), 17);
+
+        // pack to bytes and transpose back
+        __m128i p0 = _mm_packus_epi16(row[0], row[1]);
+        __m128i p1 = _mm_packus_epi16(row[2], row[3]);
+        __m128i p2 = _mm_packus_epi16(row[4], row[5]);
+        __m128i p3 = _mm_packus_epi16(row[6], row[7]);
+        interleave8(p0, p2); interleave8(p1, p3);
+        interleave8(p0, p1); interleave8(p2, p3);
+        interleave8(p0, p2); interleave8(p1, p3);
+
+        __m128i rows[4] = { p0, p2, p1, p3 };
+        for (int i = 0; i < 4; ++i)
+        {
+            _mm_storel_epi64((__m128i*)out, rows[i]); out += outStride;
+            _mm_storel_epi64((__m128i*)out, _mm_shuffle_epi32(rows[i], 0x4e)); out += outStride;
+        }
+    }
+
+    // Only RGBA output is vectorized (the texture path always asks for 4 channels),
+    // 8 pixels per iteration in 32 bit lanes. Constants over 16 bits are split into a shift and a madd.
+    void YCbCrToRGBSSE2(stbi_uc* out, stbi_uc const* y, stbi_uc const* cb, stbi_uc const* cr, int count, int step)
+    {
+        int i = 0;
+        if (step == 4)
+        {
+            const int CR_R = float2fixed(1.40200f), CR_G = float2fixed(0.71414f);
+            const int CB_G = float2fixed(0.34414f), CB_B = float2fixed(1.77200f);
+            // (cr, cb) pairs times (r, g, b) factors: r = cr << 16 + ..., g = -(cr << 16) + ..., b = cb << 17 + ...
+            const __m128i rFactors = _mm_setr_epi16((short)(CR_R - 65536), 0, (short)(CR_R - 65536), 0, (short)(CR_R - 65536), 0, (short)(CR_R - 65536), 0);
+            const __m128i gFactors = _mm_setr_epi16((short)(65536 - CR_G), (short)-CB_G, (short)(65536 - CR_G), (short)-CB_G, (short)(65536 - CR_G), (short)-CB_G, (short)(65536 - CR_G), (short)-CB_G);
+            const __m128i bFactors = _mm_setr_epi16(0, (short)(CB_B - 131072), 0, (short)(CB_B - 131072), 0, (short)(CB_B - 131072), 0, (short)(CB_B - 131072));
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i bias128 = _mm_set1_epi16(128);
+            const __m128i rounding = _mm_set1_epi32(32768);
+            const __m128i highHalf = _mm_set1_epi32((int)0xffff0000);
+
+            for (; i + 8 <= count; i += 8)
+            {
+                __m128i y16 = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(y + i)), zero);
+                __m128i cr16 = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(cr + i)), zero), bias128);
+                __m128i cb16 = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(cb + i)), zero), bias128);
+
+                __m128i r[2], g[2], b[2];
+                for (int half = 0; half < 2; ++half)
+                {
+                    __m128i crcb = half ? _mm_unpackhi_epi16(cr16, cb16) : _mm_unpacklo_epi16(cr16, cb16);
+                    __m128i y32 = half ? _mm_unpackhi_epi16(y16, zero) : _mm_unpacklo_epi16(y16, zero);
+                    __m128i yFixed = _mm_add_epi32(_mm_slli_epi32(y32, 16), rounding);
+                    __m128i crShifted = _mm_slli_epi32(crcb, 16);
+                    __m128i cbShifted = _mm_and_si128(crcb, highHalf);
+
+                    r[half] = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(yFixed, crShifted), _mm_madd_epi16(crcb, rFactors)), 16);
+                    g[half] = _mm_srai_epi32(_mm_add_epi32(_mm_sub_epi32(yFixed, crShifted), _mm_madd_epi16(crcb, gFactors)), 16);
+                    b[half] = _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(yFixed, _mm_slli_epi32(cbShifted, 1)), _mm_madd_epi16(crcb, bFactors)), 16);
+                }
+
+                __m128i rb = _mm_packus_epi16(_mm_packs_epi32(r[0], r[1]), _mm_packs_epi32(b[0], b[1]));
+                __m128i ga = _mm_packus_epi16(_mm_packs_epi32(g[0], g[1]), _mm_set1_epi16(255));
+                __m128i rg = _mm_unpacklo_epi8(rb, ga);
+                __m128i ba = _mm_unpackhi_epi8(rb, ga);
+                _mm_storeu_si128((__m128i*)(out + i * 4), _mm_unpacklo_epi16(rg, ba));
+                _mm_storeu_si128((__m128i*)(out + i * 4 + 16), _mm_unpackhi_epi16(rg, ba));
+            }
+        }
+        YCbCrToRGBScalar(out + i * step, y + i, cb + i, cr + i, count - i, step);
+    }
+
+    // idct1D on 8 lanes; written out because GCC cannot inline AVX2 helpers into generic code
+    CPU_TARGET("avx2")
+    void idct1DAVX2(__m256i s[8], int bias)
+    {
+        __m256i p2 = s[2], p3 = s[6];
+        __m256i p1 = _mm256_mullo_epi32(_mm256_add_epi32(p2, p3), _mm256_set1_epi32(f2f(0.5411961f)));
+        __m256i t2 = _mm256_add_epi32(p1, _mm256_mullo_epi32(p3, _mm256_set1_epi32(f2f(-1.847759065f))));
+        __m256i t3 = _mm256_add_epi32(p1, _mm256_mullo_epi32(p2, _mm256_set1_epi32(f2f(0.765366865f))));
+        __m256i t0 = _mm256_add_epi32(_mm256_slli_epi32(_mm256_add_epi32(s[0], s[4]), 12), _mm256_set1_epi32(bias));
+        __m256i t1 = _mm256_add_epi32(_mm256_slli_epi32(_mm256_sub_epi32(s[0], s[4]), 12), _mm256_set1_epi32(bias));
+        __m256i x0 = _mm256_add_epi32(t0, t3), x3 = _mm256_sub_epi32(t0, t3);
+        __m256i x1 = _mm256_add_epi32(t1, t2), x2 = _mm256_sub_epi32(t1, t2);
+
+        t0 = s[7]; t1 = s[5]; t2 = s[3]; t3 = s[1];
+        p3 = _mm256_add_epi32(t0, t2);
+        __m256i p4 = _mm256_add_epi32(t1, t3);
+        p1 = _mm256_add_epi32(t0, t3);
+        p2 = _mm256_add_epi32(t1, t2);
+        __m256i p5 = _mm256_mullo_epi32(_mm256_add_epi32(p3, p4), _mm256_set1_epi32(f2f(1.175875602f)));
+        t0 = _mm256_mullo_epi32(t0, _mm256_set1_epi32(f2f(0.298631336f)));
+        t1 = _mm256_mullo_epi32(t1, _mm256_set1_epi32(f2f(2.053119869f)));
+        t2 = _mm256_mullo_epi32(t2, _mm256_set1_epi32(f2f(3.072711026f)));
+        t3 = _mm256_mullo_epi32(t3, _mm256_set1_epi32(f2f(1.501321110f)));
+        p1 = _mm256_add_epi32(p5, _mm256_mullo_epi32(p1, _mm256_set1_epi32(f2f(-0.899976223f))));
+        p2 = _mm256_add_epi32(p5, _mm256_mullo_epi32(p2, _mm256_set1_epi32(f2f(-2.562915447f))));
+        p3 = _mm256_mullo_epi32(p3, _mm256_set1_epi32(f2f(-1.961570560f)));
+        p4 = _mm256_mullo_epi32(p4, _mm256_set1_epi32(f2f(-0.390180644f)));
+        t3 = _mm256_add_epi32(t3, _mm256_add_epi32(p1, p4));
+        t2 = _mm256_add_epi32(t2, _mm256_add_epi32(p2, p3));
+        t1 = _mm256_add_epi32(t1, _mm256_add_epi32(p2, p4));
+        t0 = _mm256_add_epi32(t0, _mm256_add_epi32(p1, p3));
+
+        s[0] = _mm256_add_epi32(x0, t3); s[7] = _mm256_sub_epi32(x0, t3);
+        s[1] = _mm256_add_epi32(x1, t2); s[6] = _mm256_sub_epi32(x1, t2);
+        s[2] = _mm256_add_epi32(x2, t1); s[5] = _mm256_sub_epi32(x2, t1);
+        s[3] = _mm256_add_epi32(x3, t0); s[4] = _mm256_sub_epi32(x3, t0);
+    }
+
+    CPU_TARGET("avx2")
+    void transpose8x8(__m256i v[8])
+    {
+        __m256i t[8], u[8];
+        for (int i = 0; i < 4; ++i)
+        {
+            t[i * 2] = _mm256_unpacklo_epi32(v[i * 2], v[i * 2 + 1]);
+            t[i * 2 + 1] = _mm256_unpackhi_epi32(v[i * 2], v[i * 2 + 1]);
+        }
+        for (int i = 0; i < 2; ++i)
+        {
+            u[i * 4 + 0] = _mm256_unpacklo_epi64(t[i * 4 + 0], t[i * 4 + 2]);
+            u[i * 4 + 1] = _mm256_unpackhi_epi64(t[i * 4 + 0], t[i * 4 + 2]);
+            u[i * 4 + 2] = _mm256_unpacklo_epi64(t[i * 4 + 1], t[i * 4 + 3]);
+            u[i * 4 + 3] = _mm256_unpackhi_epi64(t[i * 4 + 1], t[i * 4 + 3]);
+        }
+        for (int i = 0; i < 4; ++i)
+        {
+            v[i] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x20);
+            v[i + 4] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x31);
+        }
+    }
+
+    // 32 bit lanes, the scalar arithmetic on 8 columns at once, so no 16 bit saturation anywhere
+    CPU_TARGET("avx2")
+    void idctAVX2(stbi_uc* out, int outStride, short data[64], unsigned short* dequantize)
+    {
+        __m256i v[8];
+        for (int i = 0; i < 8; ++i)
+        {
+            __m256i coefficients = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(data + i * 8)));
+            __m256i factors = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(dequantize + i * 8)));
+            v[i] = _mm256_mullo_epi32(coefficients, factors);
+        }
+
+        idct1DAVX2(v, COLUMN_BIAS);
+        for (int i = 0; i < 8; ++i)
+            v[i] = _mm256_srai_epi32(v[i], 10);
+
+        transpose8x8(v);
+        idct1DAVX2(v, ROW_BIAS);
+        for (int i = 0; i < 8; ++i)
+            v[i] = _mm256_srai_epi32(v[i], 17);
+        transpose8x8(v);
+
+        // saturate to bytes four rows at a time, then gather each row's two halves
+        const __m256i rowOrder = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        for (int i = 0; i < 8; i += 4)
+        {
+            __m256i bytes = _mm256_packus_epi16(_mm256_packs_epi32(v[i], v[i + 1]), _mm256_packs_epi32(v[i + 2], v[i + 3]));
+            bytes = _mm256_permutevar8x32_epi32(bytes, rowOrder);
+            __m128i low = _mm256_castsi256_si128(bytes);
+            __m128i high = _mm256_extracti128_si256(bytes, 1);
+            _mm_storel_epi64((__m128i*)out, low); out += outStride;
+            _mm_storel_epi64((__m128i*)out, _mm_unpackhi_epi64(low, low)); out += outStride;
+            _mm_storel_epi64((__m128i*)out, high); out += outStride;
+            _mm_storel_epi64((__m128i*)out, _mm_unpackhi_epi64(high, high)); out += outStride;
+        }
+    }
+
+    CPU_TARGET("avx2")
+    void YCbCrToRGBAVX2(stbi_uc* out, stbi_uc const* y, stbi_uc const* cb, stbi_uc const* cr, int count, int step)
+    {
+        int i = 0;
+        if (step == 4)
+        {
+            const __m256i crR = _mm256_set1_epi32(float2fixed(1.40200f)), crG = _mm256_set1_epi32(float2fixed(0.71414f));
+            const __m256i cbG = _mm256_set1_epi32(float2fixed(0.34414f)), cbB = _mm256_set1_epi32(float2fixed(1.77200f));
+            const __m256i bias128 = _mm256_set1_epi32(128);
+            const __m256i rounding = _mm256_set1_epi32(32768);
+            const __m256i alpha = _mm256_set1_epi32(255);
+            // per 128 bit lane: rrrr gggg bbbb aaaa -> rgba rgba rgba rgba
+            const __m256i interleave = _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+                                                        0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256i yFixed = _mm256_add_epi32(_mm256_slli_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(y + i))), 16), rounding);
+                __m256i crValue = _mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(cr + i))), bias128);
+                __m256i cbValue = _mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(cb + i))), bias128);
+
+                __m256i r = _mm256_srai_epi32(_mm256_add_epi32(yFixed, _mm256_mullo_epi32(crValue, crR)), 16);
+                __m256i g = _mm256_srai_epi32(_mm256_sub_epi32(_mm256_sub_epi32(yFixed, _mm256_mullo_epi32(crValue, crG)), _mm256_mullo_epi32(cbValue, cbG)), 16);
+                __m256i b = _mm256_srai_epi32(_mm256_add_epi32(yFixed, _mm256_mullo_epi32(cbValue, cbB)), 16);
+
+                __m256i pixels = _mm256_packus_epi16(_mm256_packs_epi32(r, g), _mm256_packs_epi32(b, alpha));
+                _mm256_storeu_si256((__m256i*)(out + i * 4), _mm256_shuffle_epi8(pixels, interleave));
+            }
+        }
+        YCbCrToRGBScalar(out + i * step, y + i, cb + i, cr + i, count - i, step);
+    }
+#endif
+
+    ImageDecodeKernels gKernels = IMAGE_KERNELS_SCALAR;
+
+    ImageDecodeKernels fastestKernels()
+    {
+#ifdef CPU_X86_SIMD
+        return UCpuHasAVX2() ? IMAGE_KERNELS_AVX2 : IMAGE_KERNELS_SSE2;
+#else
+        return IMAGE_KERNELS_SCALAR;
+#endif
+    }
+
+    bool installKernels(ImageDecodeKernels kernels)
+    {
+        switch (kernels)
+        {
+        case IMAGE_KERNELS_SCALAR:
+            stbi_install_idct(idctScalar);
+            stbi_install_YCbCr_to_RGB(YCbCrToRGBScalar);
+            break;
+#ifdef CPU_X86_SIMD
+        case IMAGE_KERNELS_SSE2:
+            stbi_install_idct(idctSSE2);
+            stbi_install_YCbCr_to_RGB(YCbCrToRGBSSE2);
+            break;
+        case IMAGE_KERNELS_AVX2:
+            if (!UCpuHasAVX2())
+                return false;
+            stbi_install_idct(idctAVX2);
+            stbi_install_YCbCr_to_RGB(YCbCrToRGBAVX2);
+            break;
+#endif
+        default:
+            return false;
+        }
+        gKernels = kernels;
+        return true;
+    }
+
+    // Runs once, thread safe through the static initialization in ensureInitialized
+    bool initialize()
+    {
+        return installKernels(fastestKernels());
+    }
+
+    void ensureInitialized()
+    {
+        static const bool initialized = initialize();
+        (void)initialized;
+    }
+
+    bool readFile(const string& filename, vector<unsigned char>& bytes)
+    {
+        ifstream file(filename.c_str(), ios::binary);
+        if (!file)
+            return false;
+        bytes.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        return true;
+    }
+}
+
+
+ImageDecodeKernels UInitImageDecoder()
+{
+    ensureInitialized();
+    return gKernels;
+}
+
+
+bool USetImageDecodeKernels(ImageDecodeKernels kernels)
+{
+    ensureInitialized();
+    return installKernels(kernels);
+}
+
+
+ImageDecodeKernels UGetImageDecodeKernels()
+{
+    ensureInitialized();
+    return gKernels;
+}
+
+
+const char* UImageDecodeKernelsName(ImageDecodeKernels kernels)
+{
+    switch (kernels)
+    {
+    case IMAGE_KERNELS_SCALAR: return "scalar";
+    case IMAGE_KERNELS_SSE2: return "SSE2";
+    case IMAGE_KERNELS_AVX2: return "AVX2";
+    default: return "unknown";
+    }
+}
+
+
+unsigned char* ULoadImage(const char* filename, int& width, int& height, int& channels, int desiredChannels)
+{
+    ensureInitialized();
+    return stbi_load(filename, &width, &height, &channels, desiredChannels);
+}
+
+
+void UFreeImage(unsigned char* pixels)
+{
+    stbi_image_free(pixels);
+}
+
+
+const char* UImageDecodeFailure()
+{
+    const char* reason = stbi_failure_reason();
+    return reason ? reason : "unknown error";
+}
+
+
+void UBenchmarkImageDecoding(const vector<string>& filenames)
+{
+    const int runs = 5;
+    ImageDecodeKernels selected = UGetImageDecodeKernels();
+
+    // decode from memory so only the decoder is timed
+    vector<vector<unsigned char> > files(filenames.size());
+    for (size_t i = 0; i < filenames.size(); ++i)
+    {
+        if (!readFile(filenames[i], files[i]))
+            cout << "Failed to read " << filenames[i] << endl;
+    }
+
+    cout << "INFO: Image decoding benchmark (RGBA output, best of " << runs << " runs per file)" << endl;
+    vector<unsigned char> reference;
+    for (int k = 0; k < IMAGE_KERNELS_COUNT; ++k)
+    {
+        ImageDecodeKernels kernels = (ImageDecodeKernels)k;
+        if (!USetImageDecodeKernels(kernels))
+            continue;
+
+        double seconds = 0.0;
+        size_t bytes = 0;
+        vector<unsigned char> output;
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            if (files[i].empty())
+                continue;
+
+            double best = 1e30;
+            for (int run = 0; run < runs; ++run)
+            {
+                int width, height, channels;
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                unsigned char* pixels = stbi_load_from_memory(files[i].data(), (int)files[i].size(), &width, &height, &channels, 4);
+                best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+                if (!pixels)
+                    break;
+
+                if (run == 0)
+                {
+                    bytes += (size_t)width * height * 4;
+                    output.insert(output.end(), pixels, pixels + (size_t)width * height * 4);
+                }
+                stbi_image_free(pixels);
+            }
+            seconds += best;
+        }
+
+        if (reference.empty())
+            reference = output;
+
+        cout << "    " << UImageDecodeKernelsName(kernels) << ": " << bytes / (1024.0 * 1024.0) / seconds << " MB/s ("
+             << seconds * 1000.0 << " ms for " << files.size() << " files)"
+             << (output == reference ? "" : ", OUTPUT DIFFERS FROM SCALAR") << endl;
+    }
+
+    USetImageDecodeKernels(selected);
+    cout << "    runtime selection: " << UImageDecodeKernelsName(selected) << endl;
+}
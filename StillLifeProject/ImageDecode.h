@@ -0,0 +1,38 @@
+#ifndef IMAGE_DECODE_H
+#define IMAGE_DECODE_H
+
+#include <string>
+#include <vector>
+
+// IDCT and YCbCr -> RGB kernels installed into the JPEG decoder, all produce identical pixels
+enum ImageDecodeKernels
+{
+    IMAGE_KERNELS_SCALAR,
+    IMAGE_KERNELS_SSE2,
+    IMAGE_KERNELS_AVX2,
+    IMAGE_KERNELS_COUNT
+};
+
+// Installs the fastest kernels the CPU supports. Runs on the first decode,
+// calling it up front just moves the CPU detection out of the worker threads.
+ImageDecodeKernels UInitImageDecoder();
+
+// Switches kernels (benchmarking), returns false if the CPU cannot run them.
+// Not thread safe, no decode may be running.
+bool USetImageDecodeKernels(ImageDecodeKernels kernels);
+ImageDecodeKernels UGetImageDecodeKernels();
+const char* UImageDecodeKernelsName(ImageDecodeKernels kernels);
+
+// Decodes a JPEG, PNG, BMP, TGA or PSD file. channels receives the channel count stored in the file,
+// the pixels have desiredChannels channels (0 = as stored). Release them with UFreeImage.
+unsigned char* ULoadImage(const char* filename, int& width, int& height, int& channels, int desiredChannels);
+void UFreeImage(unsigned char* pixels);
+
+// Reason of the last failed decode on the calling thread, so a worker must read it right after its own
+// failed decode; other threads' failures don't overwrite it
+const char* UImageDecodeFailure();
+
+// Decodes every file with each supported kernel set and prints the throughput in MB of pixels per second
+void UBenchmarkImageDecoding(const std::vector<std::string>& filenames);
+
+#endif
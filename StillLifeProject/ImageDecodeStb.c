@@ -0,0 +1,20 @@
+/* Builds the one image decoder of the project: stb_image_aug with its installable
+   IDCT and YCbCr -> RGB hooks turned on. ImageDecode.cpp installs the kernels. */
+
+#define STBI_SIMD 1
+#define STBI_NO_DDS         /* stbi_DDS_aug.h is not shipped */
+#define STBI_NO_WRITE
+#define _CRT_SECURE_NO_WARNINGS
+
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable: 4244 4267 4703 4996)
+#else
+#define __declspec(attribute)   /* block alignment hint only, the kernels use unaligned loads */
+#endif
+
+#include "stb_image_aug.c"
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "CpuFeatures.h"
+#include "ImagePreprocess.h"
+#include "TextureDecoder.h"
+
+#ifdef CPU_X86_SIMD
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    // Scalar RGB -> RGBA for the tail of a row (and for CPUs without SSSE3)
+    void expandRowScalar(const unsigned char* src, unsigned char* dst, int pixels)
+    {
+        for (int i = 0; i < pixels; ++i)
+        {
+            dst[i * 4 + 0] = src[i * 3 + 0];
+            dst[i * 4 + 1] = src[i * 3 + 1];
+            dst[i * 4 + 2] = src[i * 3 + 2];
+            dst[i * 4 + 3] = 255;
+        }
+    }
+
+#ifdef CPU_X86_SIMD
+    enum SimdLevel
+    {
+        SIMD_SSE2,
+        SIMD_SSSE3,
+        SIMD_AVX2
+    };
+
+    SimdLevel detectSimdLevel()
+    {
+        return UCpuHasAVX2() ? SIMD_AVX2 : (UCpuHasSSSE3() ? SIMD_SSSE3 : SIMD_SSE2);
+    }
+
+    const SimdLevel SIMD_LEVEL = detectSimdLevel();
+
+    // 4 RGB pixels (12 bytes) -> 4 RGBA pixels per shuffle, alpha is or-ed in
+    CPU_TARGET("ssse3")
+    void expandRowSSSE3(const unsigned char* src, unsigned char* dst, int pixels)
+    {
+        const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+
+        // 16 byte loads read 4 bytes past the 4 pixels used, so stop while a full load stays in the row
+        int i = 0;
+        for (; i + 6 <= pixels; i += 4)
+        {
+            __m128i rgb = _mm_loadu_si128((const __m128i*)(src + i * 3));
+            _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_or_si128(_mm_shuffle_epi8(rgb, shuffle), alpha));
+        }
+        expandRowScalar(src + i * 3, dst + i * 4, pixels - i);
+    }
+
+    // 8 RGB pixels per iteration, each 128 bit lane expands 4 of them
+    CPU_TARGET("avx2")
+    void expandRowAVX2(const unsigned char* src, unsigned char* dst, int pixels)
+    {
+        const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                                 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+        const __m256i alpha = _mm256_set1_epi32((int)0xff000000);
+
+        int i = 0;
+        for (; i + 10 <= pixels; i += 8)
+        {
+            __m128i low = _mm_loadu_si128((const __m128i*)(src + i * 3));
+            __m128i high = _mm_loadu_si128((const __m128i*)(src + i * 3 + 12));
+            __m256i rgb = _mm256_inserti128_si256(_mm256_castsi128_si256(low), high, 1);
+            _mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_or_si256(_mm256_shuffle_epi8(rgb, shuffle), alpha));
+        }
+        expandRowScalar(src + i * 3, dst + i * 4, pixels - i);
+    }
+
+    CPU_TARGET("avx2")
+    void copyRowAVX2(const unsigned char* src, unsigned char* dst, size_t bytes)
+    {
+        size_t i = 0;
+        for (; i + 32 <= bytes; i += 32)
+            _mm256_storeu_si256((__m256i*)(dst + i), _mm256_loadu_si256((const __m256i*)(src + i)));
+        memcpy(dst + i, src + i, bytes - i);
+    }
+#endif
+
+    void expandRow(const unsigned char* src, unsigned char* dst, int pixels)
+    {
+#ifdef CPU_X86_SIMD
+        if (SIMD_LEVEL == SIMD_AVX2)
+            expandRowAVX2(src, dst, pixels);
+        else if (SIMD_LEVEL == SIMD_SSSE3)
+            expandRowSSSE3(src, dst, pixels);
+        else
+#endif
+            expandRowScalar(src, dst, pixels);
+    }
+
+    void copyRow(const unsigned char* src, unsigned char* dst, size_t bytes)
+    {
+#ifdef CPU_X86_SIMD
+        if (SIMD_LEVEL == SIMD_AVX2)
+        {
+            copyRowAVX2(src, dst, bytes);
+            return;
+        }
+#endif
+        memcpy(dst, src, bytes);
+    }
+
+    double millisecondsSince(chrono::steady_clock::time_point start)
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+}
+
+
+int UPreprocessedChannels(int channels, const PreprocessOptions& options)
+{
+    return channels == 3 && options.expandToRGBA ? 4 : channels;
+}
+
+
+size_t UPreprocessedStride(int width, int channels, const PreprocessOptions& options)
+{
+    size_t alignment = options.rowAlignment > 0 ? (size_t)options.rowAlignment : 1;
+    size_t bytes = (size_t)width * UPreprocessedChannels(channels, options);
+    return (bytes + alignment - 1) / alignment * alignment;
+}
+
+
+void UPreprocessImage(const unsigned char* src, int width, int height, int channels, unsigned char* dst, const PreprocessOptions& options)
+{
+    size_t srcStride = (size_t)width * channels;
+    size_t dstStride = UPreprocessedStride(width, channels, options);
+    bool expand = UPreprocessedChannels(channels, options) != channels;
+    size_t rowBytes = (size_t)width * UPreprocessedChannels(channels, options);
+
+    // every output row is written exactly once: read the mirrored source row, expand or copy it, then pad
+    for (int y = 0; y < height; ++y)
+    {
+        const unsigned char* srcRow = src + (size_t)(options.flip ? height - 1 - y : y) * srcStride;
+        unsigned char* dstRow = dst + (size_t)y * dstStride;
+
+        if (expand)
+            expandRow(srcRow, dstRow, width);
+        else
+            copyRow(srcRow, dstRow, rowBytes);
+
+        if (dstStride > rowBytes)
+            memset(dstRow + rowBytes, 0, dstStride - rowBytes);
+    }
+}
+
+
+void UResampleRGBA(const unsigned char* src, int width, int height, unsigned char* dst, int dstWidth, int dstHeight)
+{
+    // texel centres of the destination mapped onto the source, edges clamped
+    float scaleX = (float)width / dstWidth, scaleY = (float)height / dstHeight;
+    for (int y = 0; y < dstHeight; ++y)
+    {
+        float sy = max(0.0f, (y + 0.5f) * scaleY - 0.5f);
+        int y0 = min((int)sy, height - 1), y1 = min(y0 + 1, height - 1);
+        float fy = sy - y0;
+
+        for (int x = 0; x < dstWidth; ++x)
+        {
+            float sx = max(0.0f, (x + 0.5f) * scaleX - 0.5f);
+            int x0 = min((int)sx, width - 1), x1 = min(x0 + 1, width - 1);
+            float fx = sx - x0;
+
+            const unsigned char* p00 = src + ((size_t)y0 * width + x0) * 4;
+            const unsigned char* p01 = src + ((size_t)y0 * width + x1) * 4;
+            const unsigned char* p10 = src + ((size_t)y1 * width + x0) * 4;
+            const unsigned char* p11 = src + ((size_t)y1 * width + x1) * 4;
+            unsigned char* out = dst + ((size_t)y * dstWidth + x) * 4;
+            for (int c = 0; c < 4; ++c)
+            {
+                float top = p00[c] + (p01[c] - p00[c]) * fx;
+                float bottom = p10[c] + (p11[c] - p10[c]) * fx;
+                out[c] = (unsigned char)(top + (bottom - top) * fy + 0.5f);
+            }
+        }
+    }
+}
+
+
+void UBenchmarkPreprocess()
+{
+    const int sizes[][2] = { { 3840, 2160 }, { 7680, 4320 } };
+    const int runs = 5;
+
+    cout << "INFO: Image preprocessing benchmark (RGB8, best of " << runs << " runs)" << endl;
+    for (int s = 0; s < 2; ++s)
+    {
+        int width = sizes[s][0], height = sizes[s][1];
+        vector<unsigned char> image((size_t)width * height * 3);
+        for (size_t i = 0; i < image.size(); ++i)
+            image[i] = (unsigned char)(i * 31);
+
+        PreprocessOptions flipOnly;
+        flipOnly.expandToRGBA = false;
+        flipOnly.rowAlignment = 1;
+        PreprocessOptions flipExpand;
+
+        vector<unsigned char> output(height * UPreprocessedStride(width, 3, flipExpand));
+
+        double legacy = 1e30, flip = 1e30, expand = 1e30;
+        for (int run = 0; run < runs; ++run)
+        {
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            flipImageVertically(image.data(), width, height, 3);
+            legacy = min(legacy, millisecondsSince(start));
+
+            start = chrono::steady_clock::now();
+            UPreprocessImage(image.data(), width, height, 3, output.data(), flipOnly);
+            flip = min(flip, millisecondsSince(start));
+
+            start = chrono::steady_clock::now();
+            UPreprocessImage(image.data(), width, height, 3, output.data(), flipExpand);
+            expand = min(expand, millisecondsSince(start));
+        }
+
+        double megabytes = image.size() / (1024.0 * 1024.0);
+        cout << "    " << width << "x" << height << ": flipImageVertically " << legacy << " ms (" << megabytes / legacy * 1000.0 << " MB/s), "
+             << "single-pass flip " << flip << " ms (" << megabytes / flip * 1000.0 << " MB/s), "
+             << "flip + RGBA expansion " << expand << " ms (" << megabytes / expand * 1000.0 << " MB/s)" << endl;
+    }
+}
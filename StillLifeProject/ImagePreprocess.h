@@ -0,0 +1,28 @@
+#ifndef IMAGE_PREPROCESS_H
+#define IMAGE_PREPROCESS_H
+
+#include <cstddef>
+
+// Turns decoded pixels into an upload-ready buffer in a single pass over memory:
+// vertical flip, optional RGB -> RGBA expansion and padding of every row to rowAlignment bytes.
+struct PreprocessOptions
+{
+    bool flip = true;               // OpenGL expects the bottom row first
+    bool expandToRGBA = true;       // 3 channel images become 4 channels with alpha 255
+    int rowAlignment = 4;           // matches the default GL_UNPACK_ALIGNMENT
+};
+
+// Channels and row stride of the preprocessed image
+int UPreprocessedChannels(int channels, const PreprocessOptions& options);
+size_t UPreprocessedStride(int width, int channels, const PreprocessOptions& options);
+
+// dst must hold height * UPreprocessedStride bytes and must not overlap src
+void UPreprocessImage(const unsigned char* src, int width, int height, int channels, unsigned char* dst, const PreprocessOptions& options);
+
+// Bilinear resize of a tightly packed RGBA image, used to bring images to a common size
+void UResampleRGBA(const unsigned char* src, int width, int height, unsigned char* dst, int dstWidth, int dstHeight);
+
+// Times the old byte-by-byte flip against the single-pass preprocessing on 4K and 8K images
+void UBenchmarkPreprocess();
+
+#endif
@@ -0,0 +1,33 @@
+#include <cstring>
+
+#include "IndexBuffer.h"
+
+using namespace std;
+
+
+GLenum UIndexTypeFor(size_t vertexCount)
+{
+    return vertexCount <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+
+size_t UIndexTypeSize(GLenum type)
+{
+    return type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+}
+
+
+void UStoreIndices(const GLuint* indices, size_t count, GLenum type, void* out)
+{
+    if (type == GL_UNSIGNED_INT)
+    {
+        memcpy(out, indices, count * sizeof(GLuint));
+        return;
+    }
+    unsigned char* bytes = (unsigned char*)out;
+    for (size_t i = 0; i < count; ++i)
+    {
+        GLushort index = (GLushort)indices[i];
+        memcpy(bytes + i * sizeof(GLushort), &index, sizeof(index));
+    }
+}
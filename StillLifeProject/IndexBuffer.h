@@ -0,0 +1,14 @@
+#ifndef INDEX_BUFFER_H
+#define INDEX_BUFFER_H
+
+#include <cstddef>
+#include <GL/glew.h>
+
+// Narrowest element type that can address vertexCount vertices
+GLenum UIndexTypeFor(size_t vertexCount);
+size_t UIndexTypeSize(GLenum type);
+
+// Writes count indices to out as elements of type, which must be wide enough for them
+void UStoreIndices(const GLuint* indices, size_t count, GLenum type, void* out);
+
+#endif
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cstring>
+
+#include "IndirectDraws.h"
+
+using namespace std;
+
+namespace
+{
+    // vertex buffer binding the instanced attributes read the records from
+    const GLuint RECORD_BINDING = 3;
+}
+
+
+bool UIndirectDrawsSupported()
+{
+    return (GLEW_VERSION_4_3 || (GLEW_ARB_multi_draw_indirect && GLEW_ARB_shader_storage_buffer_object))
+        && GLEW_ARB_shader_draw_parameters;
+}
+
+
+void IndirectDrawList::create(GLResourceRegistry& resources, const GeometryPool& pool, StreamBuffer* frameStream)
+{
+    registry = &resources;
+    stream = frameStream;
+    commandBuffer = resources.createBuffer("indirect draw commands");
+    recordBuffer = resources.createBuffer("instance records");
+
+    GLint alignment = 0;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    recordAlignment = max((size_t)alignment, (size_t)16);
+
+    // attributes 3-6 are the model matrix columns, 7 the material, advancing once per instance. They share
+    // one binding, so pointing them at each frame's records is a single glBindVertexBuffer.
+    pool.bind();
+    for (int column = 0; column < 4; ++column)
+    {
+        glVertexAttribFormat(3 + column, 4, GL_FLOAT, GL_FALSE, (GLuint)(offsetof(DrawRecord, model) + column * 4 * sizeof(GLfloat)));
+        glVertexAttribBinding(3 + column, RECORD_BINDING);
+        glEnableVertexAttribArray(3 + column);
+    }
+    glVertexAttribIFormat(7, 4, GL_INT, (GLuint)offsetof(DrawRecord, material));
+    glVertexAttribBinding(7, RECORD_BINDING);
+    glEnableVertexAttribArray(7);
+    glVertexBindingDivisor(RECORD_BINDING, 1);
+    glBindVertexBuffer(RECORD_BINDING, recordBuffer, 0, sizeof(DrawRecord));
+    glBindVertexArray(0);
+}
+
+
+void IndirectDrawList::destroy(GLResourceRegistry& resources)
+{
+    resources.destroy(GL_RESOURCE_BUFFER, commandBuffer);
+    resources.destroy(GL_RESOURCE_BUFFER, recordBuffer);
+    commandBuffer = recordBuffer = 0;
+    clear();
+}
+
+
+void IndirectDrawList::add(const MeshRange& range, const GLfloat model[16], int layer, int wrap, int minLevel)
+{
+    // a scene has a few distinct ranges, one per mesh and level of detail
+    size_t c = 0;
+    while (c < commands.size() && (commands[c].firstIndex != range.firstIndex || commands[c].baseVertex != range.baseVertex))
+        ++c;
+    if (c == commands.size())
+    {
+        DrawElementsIndirectCommand command;
+        command.count = range.indexCount;
+        command.instanceCount = 0;
+        command.firstIndex = range.firstIndex;
+        command.baseVertex = range.baseVertex;
+        command.baseInstance = 0;
+        commands.push_back(command);
+    }
+    ++commands[c].instanceCount;
+    recordCommands.push_back((GLuint)c);
+
+    DrawRecord record;
+    memcpy(record.model, model, sizeof(record.model));
+    record.material[0] = layer;
+    record.material[1] = wrap;
+    record.material[2] = minLevel;
+    record.material[3] = 0;
+    records.push_back(record);
+}
+
+
+void IndirectDrawList::submit(const GeometryPool& pool)
+{
+    if (commands.empty())
+        return;
+    upload();
+    uploadCommands();
+
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, uploadedRecords, uploadedRecordsOffset, records.size() * sizeof(DrawRecord));
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, uploadedCommands);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, pool.getIndexType(), (void*)uploadedCommandsOffset, (GLsizei)commands.size(), 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+
+void IndirectDrawList::submitInstanced(const GeometryPool& pool, bool drawPerInstance)
+{
+    if (commands.empty())
+        return;
+    upload();
+
+    for (const DrawElementsIndirectCommand& command : commands)
+    {
+        void* firstIndex = (void*)(command.firstIndex * pool.getIndexSize());
+        if (!drawPerInstance)
+        {
+            glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, command.count, pool.getIndexType(), firstIndex,
+                                                          command.instanceCount, command.baseVertex, command.baseInstance);
+            continue;
+        }
+        for (GLuint i = 0; i < command.instanceCount; ++i)
+        {
+            glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, command.count, pool.getIndexType(), firstIndex,
+                                                          1, command.baseVertex, command.baseInstance + i);
+        }
+    }
+}
+
+
+// Sets every command's baseInstance and uploads the records grouped by command, then points the
+// instanced attributes at them. Expects the pool's vertex array to be bound.
+void IndirectDrawList::upload()
+{
+    GLuint first = 0;
+    for (DrawElementsIndirectCommand& command : commands)
+    {
+        command.baseInstance = first;
+        first += command.instanceCount;
+        command.instanceCount = 0;  // counted again below as the records are placed
+    }
+
+    // the records are placed straight into the stream buffer, the CPU-side grouping is only the fallback
+    size_t bytes = records.size() * sizeof(DrawRecord);
+    StreamAllocation allocation = stream ? stream->allocate(bytes, recordAlignment) : StreamAllocation();
+    DrawRecord* placed = (DrawRecord*)allocation.data;
+    if (!placed)
+    {
+        sortedRecords.resize(records.size());
+        placed = sortedRecords.data();
+    }
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        DrawElementsIndirectCommand& command = commands[recordCommands[i]];
+        placed[command.baseInstance + command.instanceCount++] = records[i];
+    }
+
+    if (allocation.data)
+    {
+        uploadedRecords = allocation.buffer;
+        uploadedRecordsOffset = allocation.offset;
+    }
+    else
+    {
+        // respecifying the store each frame lets the driver hand out fresh memory instead of waiting on the GPU
+        glBindBuffer(GL_ARRAY_BUFFER, recordBuffer);
+        glBufferData(GL_ARRAY_BUFFER, bytes, sortedRecords.data(), GL_STREAM_DRAW);
+        registry->setSize(GL_RESOURCE_BUFFER, recordBuffer, bytes);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        uploadedRecords = recordBuffer;
+        uploadedRecordsOffset = 0;
+    }
+    glBindVertexBuffer(RECORD_BINDING, uploadedRecords, uploadedRecordsOffset, sizeof(DrawRecord));
+}
+
+
+// Uploads the commands after upload() set their instances, same fallback as the records
+void IndirectDrawList::uploadCommands()
+{
+    size_t bytes = commands.size() * sizeof(DrawElementsIndirectCommand);
+    StreamAllocation allocation = stream ? stream->allocate(bytes, sizeof(GLuint)) : StreamAllocation();
+    if (allocation.data)
+    {
+        memcpy(allocation.data, commands.data(), bytes);
+        uploadedCommands = allocation.buffer;
+        uploadedCommandsOffset = allocation.offset;
+        return;
+    }
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, bytes, commands.data(), GL_STREAM_DRAW);
+    registry->setSize(GL_RESOURCE_BUFFER, commandBuffer, bytes);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    uploadedCommands = commandBuffer;
+    uploadedCommandsOffset = 0;
+}
@@ -0,0 +1,85 @@
+#ifndef INDIRECT_DRAWS_H
+#define INDIRECT_DRAWS_H
+
+#include <cstddef>
+#include <vector>
+#include <GL/glew.h>
+
+#include "GLResources.h"
+#include "GeometryPool.h"
+#include "StreamBuffer.h"
+
+// Layout glMultiDrawElementsIndirect reads from the GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Per-instance data, std430 layout in the shader storage buffer (indexed with gl_BaseInstanceARB + gl_InstanceID)
+// and instanced vertex attributes 3-7 (model columns, material) on the instanced path
+struct DrawRecord
+{
+    GLfloat model[16];      // column-major model matrix
+    GLint material[4];      // layer, wrap, finest resident mip level, unused
+};
+
+// Whether the driver can run the indirect path: multi-draw indirect, storage buffers and gl_BaseInstanceARB
+// (ARB_shader_draw_parameters), since gl_InstanceID does not include the command's baseInstance
+bool UIndirectDrawsSupported();
+
+// A frame's worth of instances from a geometry pool. Instances of the same mesh range share one command,
+// their records are stored together at the command's baseInstance. Submitted with one
+// glMultiDrawElementsIndirect call, or with one glDrawElementsInstanced per command where that isn't supported.
+// Commands and records are rebuilt every frame on the CPU and written right before the draw, into the
+// current frame's region of a stream buffer when there is one. Without it, or when the region is full,
+// the list's own buffers are respecified with the data instead.
+class IndirectDrawList
+{
+public:
+    IndirectDrawList() {}
+    ~IndirectDrawList() {}
+
+    // also adds the instanced vertex attributes to the pool's vertex array. stream may be null.
+    void create(GLResourceRegistry& resources, const GeometryPool& pool, StreamBuffer* stream);
+    void destroy(GLResourceRegistry& resources);
+    // switches the stream buffer later uploads go to, may be null
+    void setStream(StreamBuffer* frameStream)   { stream = frameStream; }
+
+    void clear()                        { commands.clear(); records.clear(); recordCommands.clear(); }
+    void add(const MeshRange& range, const GLfloat model[16], int layer, int wrap, int minLevel);
+    size_t getDrawCount() const         { return commands.size(); }
+    size_t getInstanceCount() const     { return records.size(); }
+
+    // uploads the commands and records, binds the records to storage buffer binding 0 and draws.
+    // The pool's vertex array must be bound.
+    void submit(const GeometryPool& pool);
+
+    // uploads the records and draws every command with glDrawElementsInstancedBaseVertexBaseInstance, the
+    // shader reads the records as vertex attributes. drawPerInstance issues one draw per instance instead,
+    // the baseline instancing is measured against. The pool's vertex array must be bound.
+    void submitInstanced(const GeometryPool& pool, bool drawPerInstance = false);
+
+private:
+    void upload();
+    void uploadCommands();
+
+    GLResourceRegistry* registry = nullptr;
+    StreamBuffer* stream = nullptr;
+    GLuint commandBuffer = 0;
+    GLuint recordBuffer = 0;
+    size_t recordAlignment = 0;         // storage buffer offset alignment
+    GLuint uploadedRecords = 0;         // buffer and offset of this frame's records
+    GLintptr uploadedRecordsOffset = 0;
+    GLuint uploadedCommands = 0;        // and of its commands
+    GLintptr uploadedCommandsOffset = 0;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<DrawRecord> records;            // in the order they were added
+    std::vector<GLuint> recordCommands;         // command of each record
+    std::vector<DrawRecord> sortedRecords;      // grouped by command, what the GPU reads
+};
+
+#endif
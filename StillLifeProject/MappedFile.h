@@ -0,0 +1,32 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const char* path);
+    void close();
+
+    bool isOpen() const                     { return bytes != nullptr; }
+    const unsigned char* getData() const    { return bytes; }
+    size_t getSize() const                  { return size; }
+
+private:
+    MappedFile(const MappedFile&);              // not copyable
+    MappedFile& operator=(const MappedFile&);
+
+    const unsigned char* bytes;
+    size_t size;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include "MeshCache.h"
+
+using namespace std;
+
+namespace
+{
+    const size_t ARRAY_ALIGNMENT = 16;
+
+    size_t alignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+    {
+        const unsigned char* bytes = (const unsigned char*)data;
+        for (size_t i = 0; i < size; ++i)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        return hash;
+    }
+}
+
+
+bool CachedMesh::open(const char* path, uint64_t key)
+{
+    close();
+    if (!file.open(path))
+        return false;
+
+    if (file.getSize() < sizeof(CachedMeshHeader))
+    {
+        close();
+        return false;
+    }
+
+    header = (const CachedMeshHeader*)file.getData();
+    bool valid = memcmp(header->magic, "SLMS", 4) == 0 && header->version == MESH_CACHE_VERSION && header->key == key
+        && header->vertexSize == sizeof(PoolVertex) && header->indexSize == sizeof(GLuint)
+        && header->vertexOffset % ARRAY_ALIGNMENT == 0 && header->indexOffset % ARRAY_ALIGNMENT == 0
+        && header->vertexOffset + header->vertexCount * sizeof(PoolVertex) <= file.getSize()
+        && header->indexOffset + header->indexCount * sizeof(GLuint) <= file.getSize();
+
+    // every index has to land inside the mesh, the pool trusts them
+    const GLuint* indices = valid ? getIndices() : nullptr;
+    for (uint64_t i = 0; valid && i < header->indexCount; ++i)
+        valid = indices[i] < header->vertexCount;
+
+    if (!valid)
+    {
+        cout << "WARNING: " << path << " is not a valid cached mesh, regenerating it" << endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+
+uint64_t UMeshCacheKey(const char* generator, const float* params, int paramCount, const char* vertexFormat)
+{
+    uint64_t hash = 14695981039346656037ull;
+    hash = hashBytes(hash, generator, strlen(generator) + 1);
+    hash = hashBytes(hash, &paramCount, sizeof(paramCount));
+    hash = hashBytes(hash, params, paramCount * sizeof(float));
+    return hashBytes(hash, vertexFormat, strlen(vertexFormat) + 1);
+}
+
+
+string UMeshCachePath(uint64_t key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "mesh_%016llx.slmesh", (unsigned long long)key);
+    return name;
+}
+
+
+bool UWriteCachedMesh(const char* path, uint64_t key, const PoolVertex* vertices, size_t vertexCount,
+                      const GLuint* indices, size_t indexCount)
+{
+    CachedMeshHeader header;
+    memcpy(header.magic, "SLMS", 4);
+    header.version = MESH_CACHE_VERSION;
+    header.key = key;
+    header.vertexSize = sizeof(PoolVertex);
+    header.indexSize = sizeof(GLuint);
+    header.vertexCount = vertexCount;
+    header.indexCount = indexCount;
+    header.vertexOffset = alignUp(sizeof(CachedMeshHeader), ARRAY_ALIGNMENT);
+    header.indexOffset = alignUp(header.vertexOffset + vertexCount * sizeof(PoolVertex), ARRAY_ALIGNMENT);
+
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out)
+    {
+        cout << "ERROR: Cannot write " << path << endl;
+        return false;
+    }
+
+    static const char padding[ARRAY_ALIGNMENT] = { 0 };
+    out.write((const char*)&header, sizeof(header));
+    out.write(padding, (streamsize)(header.vertexOffset - sizeof(header)));
+    out.write((const char*)vertices, vertexCount * sizeof(PoolVertex));
+    out.write(padding, (streamsize)(header.indexOffset - header.vertexOffset - vertexCount * sizeof(PoolVertex)));
+    out.write((const char*)indices, indexCount * sizeof(GLuint));
+
+    out.close();
+    if (out.fail())
+    {
+        cout << "ERROR: Failed writing " << path << endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,62 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <GL/glew.h>
+
+#include "GeometryPool.h"
+#include "MappedFile.h"
+
+// A cached mesh (.slmesh) holds one generated mesh in the pool's input layout, already optimized, so a later
+// launch maps the file and hands its arrays straight to the geometry pool instead of running the generator.
+// Files are named after a key hashed from the generator, its parameters and the vertex format. Layout:
+//   CachedMeshHeader
+//   PoolVertex[vertexCount], starting on a 16 byte boundary
+//   GLuint[indexCount], starting on a 16 byte boundary
+const uint32_t MESH_CACHE_VERSION = 2;    // bumped whenever the optimizer output changes
+
+struct CachedMeshHeader
+{
+    char magic[4];          // "SLMS"
+    uint32_t version;       // MESH_CACHE_VERSION
+    uint64_t key;           // UMeshCacheKey of the generator call
+    uint32_t vertexSize;    // sizeof(PoolVertex)
+    uint32_t indexSize;     // sizeof(GLuint)
+    uint64_t vertexCount;
+    uint64_t indexCount;
+    uint64_t vertexOffset;  // from the start of the file
+    uint64_t indexOffset;
+};
+
+// A cached mesh file mapped into memory
+class CachedMesh
+{
+public:
+    // maps and validates the file, returns false if it is missing or not a usable cached mesh for key
+    bool open(const char* path, uint64_t key);
+    void close()                            { file.close(); header = nullptr; }
+
+    const PoolVertex* getVertices() const   { return (const PoolVertex*)(file.getData() + header->vertexOffset); }
+    size_t getVertexCount() const           { return (size_t)header->vertexCount; }
+    const GLuint* getIndices() const        { return (const GLuint*)(file.getData() + header->indexOffset); }
+    size_t getIndexCount() const            { return (size_t)header->indexCount; }
+    size_t getByteSize() const              { return file.getSize(); }
+
+private:
+    MappedFile file;
+    const CachedMeshHeader* header = nullptr;
+};
+
+// FNV-1a of the generator name, its parameters and a description of the vertex format,
+// changing any of them gives another key and so another file
+uint64_t UMeshCacheKey(const char* generator, const float* params, int paramCount, const char* vertexFormat);
+
+// Cache file of a key: mesh_<16 hex digits>.slmesh in the working directory
+std::string UMeshCachePath(uint64_t key);
+
+bool UWriteCachedMesh(const char* path, uint64_t key, const PoolVertex* vertices, size_t vertexCount,
+                      const GLuint* indices, size_t indexCount);
+
+#endif
@@ -0,0 +1,504 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "CpuFeatures.h"
+#include "MeshGenerators.h"
+
+#ifdef CPU_X86_SIMD
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace
+{
+    const float PI = 3.1415926f;    // the constant the generators always used
+
+    typedef void (*RowKernel)(const VertexRow& row, const float* cosines, const float* sines, const float* params,
+                              int count, float* out, size_t stride);
+
+    // Same operation order in every kernel, so all of them produce the same bits
+    void emitRowScalar(const VertexRow& row, const float* cosines, const float* sines, const float* params,
+                       int count, float* out, size_t stride)
+    {
+        for (int j = 0; j < count; ++j, out += stride)
+        {
+            for (int k = 0; k < MESH_FLOATS_PER_VERTEX; ++k)
+                out[k] = row.base[k] + row.cosWeight[k] * cosines[j] + row.sinWeight[k] * sines[j] + row.paramWeight[k] * params[j];
+        }
+    }
+
+#ifdef CPU_X86_SIMD
+    // a vertex is two 4-float halves
+    void emitRowSSE2(const VertexRow& row, const float* cosines, const float* sines, const float* params,
+                     int count, float* out, size_t stride)
+    {
+        __m128 base[2], cosWeight[2], sinWeight[2], paramWeight[2];
+        for (int h = 0; h < 2; ++h)
+        {
+            base[h] = _mm_loadu_ps(row.base + h * 4);
+            cosWeight[h] = _mm_loadu_ps(row.cosWeight + h * 4);
+            sinWeight[h] = _mm_loadu_ps(row.sinWeight + h * 4);
+            paramWeight[h] = _mm_loadu_ps(row.paramWeight + h * 4);
+        }
+        for (int j = 0; j < count; ++j, out += stride)
+        {
+            __m128 c = _mm_set1_ps(cosines[j]);
+            __m128 s = _mm_set1_ps(sines[j]);
+            __m128 p = _mm_set1_ps(params[j]);
+            for (int h = 0; h < 2; ++h)
+            {
+                __m128 v = _mm_add_ps(base[h], _mm_mul_ps(cosWeight[h], c));
+                v = _mm_add_ps(v, _mm_mul_ps(sinWeight[h], s));
+                v = _mm_add_ps(v, _mm_mul_ps(paramWeight[h], p));
+                _mm_storeu_ps(out + h * 4, v);
+            }
+        }
+    }
+
+    // a vertex is exactly one 8-float register, no FMA so the rounding matches the other kernels
+    CPU_TARGET("avx2")
+    void emitRowAVX2(const VertexRow& row, const float* cosines, const float* sines, const float* params,
+                     int count, float* out, size_t stride)
+    {
+        __m256 base = _mm256_loadu_ps(row.base);
+        __m256 cosWeight = _mm256_loadu_ps(row.cosWeight);
+        __m256 sinWeight = _mm256_loadu_ps(row.sinWeight);
+        __m256 paramWeight = _mm256_loadu_ps(row.paramWeight);
+        for (int j = 0; j < count; ++j, out += stride)
+        {
+            __m256 v = _mm256_add_ps(base, _mm256_mul_ps(cosWeight, _mm256_set1_ps(cosines[j])));
+            v = _mm256_add_ps(v, _mm256_mul_ps(sinWeight, _mm256_set1_ps(sines[j])));
+            v = _mm256_add_ps(v, _mm256_mul_ps(paramWeight, _mm256_set1_ps(params[j])));
+            _mm256_storeu_ps(out, v);
+        }
+    }
+#endif
+
+    MeshKernels gKernels = MESH_KERNELS_SCALAR;
+    RowKernel gRowKernel = emitRowScalar;
+
+    MeshKernels fastestKernels()
+    {
+#ifdef CPU_X86_SIMD
+        return UCpuHasAVX2() ? MESH_KERNELS_AVX2 : MESH_KERNELS_SSE2;
+#else
+        return MESH_KERNELS_SCALAR;
+#endif
+    }
+
+    bool installKernels(MeshKernels kernels)
+    {
+        switch (kernels)
+        {
+        case MESH_KERNELS_SCALAR:
+            gRowKernel = emitRowScalar;
+            break;
+#ifdef CPU_X86_SIMD
+        case MESH_KERNELS_SSE2:
+            gRowKernel = emitRowSSE2;
+            break;
+        case MESH_KERNELS_AVX2:
+            if (!UCpuHasAVX2())
+                return false;
+            gRowKernel = emitRowAVX2;
+            break;
+#endif
+        default:
+            return false;
+        }
+        gKernels = kernels;
+        return true;
+    }
+
+    bool initialize()
+    {
+        return installKernels(fastestKernels());
+    }
+
+    void ensureInitialized()
+    {
+        static const bool initialized = initialize();
+        (void)initialized;
+    }
+
+    void clearRow(VertexRow& row)
+    {
+        memset(&row, 0, sizeof(row));
+    }
+
+    // How the sphere was built before the tables, one sinf / cosf per vertex, as the benchmark's reference
+    void sphereRowsPerVertex(float radius, int sectors, int stacks, int firstStack, int stackRows, float* out)
+    {
+        float sectorStep = 2 * PI / sectors;
+        float stackStep = PI / stacks;
+        float lengthInv = 1.0f / radius;
+        for (int i = firstStack; i < firstStack + stackRows; ++i)
+        {
+            float stackAngle = PI / 2 - i * stackStep;
+            float xy = radius * cosf(stackAngle);
+            float z = radius * sinf(stackAngle);
+            for (int j = 0; j <= sectors; ++j, out += MESH_FLOATS_PER_VERTEX)
+            {
+                float sectorAngle = j * sectorStep;
+                float x = xy * cosf(sectorAngle);
+                float y = xy * sinf(sectorAngle);
+                out[0] = x;
+                out[1] = y;
+                out[2] = z;
+                out[3] = x * lengthInv;
+                out[4] = y * lengthInv;
+                out[5] = z * lengthInv;
+                out[6] = (float)j / sectors;
+                out[7] = (float)i / stacks;
+            }
+        }
+    }
+}
+
+
+bool USetMeshKernels(MeshKernels kernels)
+{
+    ensureInitialized();
+    return installKernels(kernels);
+}
+
+
+MeshKernels UGetMeshKernels()
+{
+    ensureInitialized();
+    return gKernels;
+}
+
+
+const char* UMeshKernelsName(MeshKernels kernels)
+{
+    switch (kernels)
+    {
+    case MESH_KERNELS_SCALAR: return "scalar";
+    case MESH_KERNELS_SSE2: return "SSE2";
+    case MESH_KERNELS_AVX2: return "AVX2";
+    default: return "unknown";
+    }
+}
+
+
+void UBuildSinCosTable(SinCosTable& table, int count, float start, float step, float paramStep, ScratchArena& arena)
+{
+    table.cosines = arena.allocate<float>(count);
+    table.sines = arena.allocate<float>(count);
+    table.params = arena.allocate<float>(count);
+    for (int i = 0; i < count; ++i)
+    {
+        float angle = start + i * step;
+        table.cosines[i] = cosf(angle);
+        table.sines[i] = sinf(angle);
+        table.params[i] = i * paramStep;
+    }
+}
+
+
+void UEmitVertexRow(const VertexRow& row, const SinCosTable& table, int first, int count, float* out, size_t stride)
+{
+    ensureInitialized();
+    gRowKernel(row, table.cosines + first, table.sines + first, table.params + first, count, out, stride);
+}
+
+
+size_t UCylinderVertexCount(int segments)
+{
+    return 4 * (size_t)segments;
+}
+
+
+size_t UCylinderIndexCount(int segments)
+{
+    return 6 * (size_t)(segments - 2) + 6 * (size_t)segments;
+}
+
+
+// The caps and the side get their own rings so the caps keep flat normals facing away from each other and
+// the side keeps radial ones. Every ring uses the cap's planar UVs.
+void UGenerateCylinder(float cx, float cy, float z, float r, int segments, float length, float* vertices, unsigned int* indices,
+                       ScratchArena& scratch)
+{
+    SinCosTable table;
+    UBuildSinCosTable(table, segments, 0.0f, 2.0f * PI / segments, 0.0f, scratch);
+
+    // the circles sit at z and at length, the cap further along +Z faces +Z
+    const float circleZ[2] = { z, length };
+    const float capNormal[2] = { z >= length ? 1.0f : -1.0f, z >= length ? -1.0f : 1.0f };
+
+    // rings: first cap, second cap, first side, second side
+    for (int ring = 0; ring < 4; ring++)
+    {
+        bool side = ring >= 2;
+        VertexRow row;
+        clearRow(row);
+        row.base[0] = cx;
+        row.base[1] = cy;
+        row.base[2] = circleZ[ring % 2];
+        row.base[5] = side ? 0.0f : capNormal[ring % 2];
+        row.base[6] = row.base[7] = 0.5f;
+        row.cosWeight[0] = r;
+        row.cosWeight[3] = side ? 1.0f : 0.0f;
+        row.cosWeight[6] = 0.5f;
+        row.sinWeight[1] = r;
+        row.sinWeight[4] = side ? 1.0f : 0.0f;
+        row.sinWeight[7] = 0.5f;
+        UEmitVertexRow(row, table, 0, segments, vertices + (size_t)ring * segments * MESH_FLOATS_PER_VERTEX, MESH_FLOATS_PER_VERTEX);
+    }
+
+    // connect triangles for both circles as fans
+    unsigned int* out = indices;
+    for (int cap = 0; cap < 2; cap++)
+    {
+        unsigned int first = (unsigned int)(cap * segments);
+        for (int i = 0; i < segments - 2; i++)
+        {
+            *out++ = first;
+            *out++ = first + i + 1;
+            *out++ = first + i + 2;
+        }
+    }
+
+    // cylinder slats between the side rings, the last one wraps to the first
+    unsigned int top = (unsigned int)(2 * segments);
+    unsigned int bottom = (unsigned int)(3 * segments);
+    for (int i = 0; i < segments; i++)
+    {
+        int next = (i + 1) % segments;
+        *out++ = top + i;
+        *out++ = top + next;
+        *out++ = bottom + next;
+        *out++ = top + i;
+        *out++ = bottom + i;
+        *out++ = bottom + next;
+    }
+}
+
+
+size_t UTorusVertexCount(int tubeSegments, int ringSegments)
+{
+    return (size_t)ringSegments * (tubeSegments + 1) * 2;
+}
+
+
+// two triangles for every even vertex count from 4 on, see UGenerateTorus
+size_t UTorusIndexCount(int tubeSegments, int ringSegments)
+{
+    return 3 * UTorusVertexCount(tubeSegments, ringSegments) - 6;
+}
+
+
+// Vertices come in pairs at the two ends of a ring step, walking around the tube and on to the next step.
+// Column k of step i lies at ring angle i + k, so each (step, k) is one row written every other vertex.
+void UGenerateTorus(float x, float y, float z, float tubeRadius, float ringRadius, int tubeSegments, int ringSegments,
+                    float* vertices, unsigned int* indices, ScratchArena& scratch)
+{
+    // ring angles 0..2 pi, u texture coordinate along the ring
+    SinCosTable ring;
+    UBuildSinCosTable(ring, ringSegments + 1, 0.0f, 2 * PI / ringSegments, 1.0f / ringSegments, scratch);
+
+    // tube angles, the last vertex closes the tube at angle 0 again, v texture coordinate around the tube
+    SinCosTable tube;
+    UBuildSinCosTable(tube, tubeSegments + 1, 0.0f, 2 * PI / tubeSegments, 1.0f / tubeSegments, scratch);
+    tube.cosines[tubeSegments] = tube.cosines[0];
+    tube.sines[tubeSegments] = tube.sines[0];
+    tube.params[tubeSegments] = tube.params[0];
+
+    // position (R + r cos v) (cos u, sin u) + centre, r sin v; normal from the tube's centre line
+    VertexRow row;
+    clearRow(row);
+    row.base[2] = z;
+    row.sinWeight[2] = tubeRadius;
+    row.sinWeight[5] = 1.0f;
+    row.paramWeight[7] = 1.0f;
+    for (int i = 0; i < ringSegments; i++)
+    {
+        for (int k = 0; k < 2; k++)
+        {
+            float cu = ring.cosines[i + k];
+            float su = ring.sines[i + k];
+            row.base[0] = ringRadius * cu + x;
+            row.base[1] = ringRadius * su + y;
+            row.base[6] = ring.params[i + k];
+            row.cosWeight[0] = tubeRadius * cu;
+            row.cosWeight[1] = tubeRadius * su;
+            row.cosWeight[3] = cu;
+            row.cosWeight[4] = su;
+            float* out = vertices + ((size_t)i * (tubeSegments + 1) * 2 + k) * MESH_FLOATS_PER_VERTEX;
+            UEmitVertexRow(row, tube, 0, tubeSegments + 1, out, 2 * MESH_FLOATS_PER_VERTEX);
+        }
+    }
+
+    // After every second vertex, two triangles join the last four; counter is the vertex count plus one
+    size_t vertexCount = UTorusVertexCount(tubeSegments, ringSegments);
+    unsigned int* out = indices;
+    for (unsigned int counter = 4; counter <= vertexCount; counter += 2)
+    {
+        if (counter % 4 == 0)
+        {
+            *out++ = counter - 1;
+            *out++ = counter - 2;
+            *out++ = counter - 3;
+            *out++ = counter - 2;
+            *out++ = counter - 3;
+            *out++ = counter - 4;
+        }
+        else
+        {
+            *out++ = counter - 4;
+            *out++ = counter - 3;
+            *out++ = counter - 2;
+            *out++ = counter - 2;
+            *out++ = counter - 3;
+            *out++ = counter - 1;
+        }
+    }
+}
+
+
+size_t USphereVertexCount(int sectors, int stacks)
+{
+    return (size_t)(stacks + 1) * (sectors + 1);
+}
+
+
+// two triangles per sector except on the first and last stacks
+size_t USphereIndexCount(int sectors, int stacks)
+{
+    return 6 * (size_t)sectors * (stacks - 1);
+}
+
+
+// vertical lines on every stack, horizontal ones except on the first
+size_t USphereLineIndexCount(int sectors, int stacks)
+{
+    return (size_t)sectors * (4 * stacks - 2);
+}
+
+
+// x = r * cos(u) * cos(v), y = r * cos(u) * sin(v), z = r * sin(u) with u the stack angle from pi/2 down
+// to -pi/2 and v the sector angle from 0 to 2 pi. The first and last vertices of a row have the same
+// position and normal but different tex coords.
+void UGenerateSphereVertices(float radius, int sectors, int stacks, int firstStack, int stackRows, float* vertices,
+                             ScratchArena& scratch)
+{
+    SinCosTable sector;
+    UBuildSinCosTable(sector, sectors + 1, 0.0f, 2 * PI / sectors, 1.0f / sectors, scratch);
+    SinCosTable stack;
+    UBuildSinCosTable(stack, firstStack + stackRows, PI / 2, -PI / stacks, 1.0f / stacks, scratch);
+
+    float lengthInv = 1.0f / radius;
+    VertexRow row;
+    clearRow(row);
+    row.paramWeight[6] = 1.0f;
+    for (int i = firstStack; i < firstStack + stackRows; ++i)
+    {
+        float xy = radius * stack.cosines[i];
+        float z = radius * stack.sines[i];
+        row.base[2] = z;
+        row.base[5] = z * lengthInv;
+        row.base[7] = stack.params[i];
+        row.cosWeight[0] = xy;
+        row.cosWeight[3] = xy * lengthInv;
+        row.sinWeight[1] = xy;
+        row.sinWeight[4] = xy * lengthInv;
+        float* out = vertices + (size_t)(i - firstStack) * (sectors + 1) * MESH_FLOATS_PER_VERTEX;
+        UEmitVertexRow(row, sector, 0, sectors + 1, out, MESH_FLOATS_PER_VERTEX);
+    }
+}
+
+
+//  k1--k1+1
+//  |  / |
+//  | /  |
+//  k2--k2+1
+void UGenerateSphereIndices(int sectors, int stacks, unsigned int* indices, unsigned int* lineIndices)
+{
+    for (int i = 0; i < stacks; ++i)
+    {
+        unsigned int k1 = i * (sectors + 1);    // beginning of current stack
+        unsigned int k2 = k1 + sectors + 1;     // beginning of next stack
+        for (int j = 0; j < sectors; ++j, ++k1, ++k2)
+        {
+            if (i != 0)
+            {
+                *indices++ = k1;
+                *indices++ = k2;
+                *indices++ = k1 + 1;
+            }
+            if (i != stacks - 1)
+            {
+                *indices++ = k1 + 1;
+                *indices++ = k2;
+                *indices++ = k2 + 1;
+            }
+            if (lineIndices)
+            {
+                *lineIndices++ = k1;
+                *lineIndices++ = k2;
+                if (i != 0)
+                {
+                    *lineIndices++ = k1;
+                    *lineIndices++ = k1 + 1;
+                }
+            }
+        }
+    }
+}
+
+
+void UBenchmarkMeshGeneration()
+{
+    // 100 million vertices, 3.2 GB interleaved, generated a band of stacks at a time into one buffer
+    const int sectors = 10000;
+    const int stacks = 10000;
+    const int bandStacks = 64;
+    const size_t rowFloats = (size_t)(sectors + 1) * MESH_FLOATS_PER_VERTEX;
+    vector<float> band(rowFloats * bandStacks);
+    ScratchArena scratch;
+    MeshKernels selected = UGetMeshKernels();
+
+    cout << "INFO: Mesh generation benchmark (" << sectors << " x " << stacks << " sphere vertices, "
+         << bandStacks << " stacks per band)" << endl;
+    vector<float> reference;
+    for (int k = -1; k < MESH_KERNELS_COUNT; ++k)
+    {
+        // -1 is the per-vertex sinf / cosf loop the tables replaced
+        if (k >= 0 && !USetMeshKernels((MeshKernels)k))
+            continue;
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int first = 0; first <= stacks; first += bandStacks)
+        {
+            int rows = min(bandStacks, stacks + 1 - first);
+            scratch.reset();
+            if (k < 0)
+                sphereRowsPerVertex(1.0f, sectors, stacks, first, rows, band.data());
+            else
+                UGenerateSphereVertices(1.0f, sectors, stacks, first, rows, band.data(), scratch);
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        // the last band is compared, it has the largest angles
+        int lastFirst = stacks / bandStacks * bandStacks;
+        vector<float> output(band.begin(), band.begin() + rowFloats * (stacks + 1 - lastFirst));
+        if (k == MESH_KERNELS_SCALAR)
+            reference = output;
+
+        double vertices = (double)USphereVertexCount(sectors, stacks);
+        cout << "    " << (k < 0 ? "sinf/cosf per vertex" : UMeshKernelsName((MeshKernels)k)) << ": "
+             << vertices / seconds / 1e6 << " Mvertices/s, " << vertices * MESH_FLOATS_PER_VERTEX * sizeof(float) / seconds / 1e9
+             << " GB/s (" << seconds * 1000.0 << " ms)"
+             << (k > MESH_KERNELS_SCALAR && output != reference ? ", OUTPUT DIFFERS FROM SCALAR" : "") << endl;
+    }
+
+    USetMeshKernels(selected);
+    cout << "    runtime selection: " << UMeshKernelsName(selected) << endl;
+}
@@ -0,0 +1,85 @@
+#ifndef MESH_GENERATORS_H
+#define MESH_GENERATORS_H
+
+#include <cstddef>
+
+#include "ScratchArena.h"
+
+// Parametric meshes written straight into their final interleaved layout, x, y, z, nx, ny, nz, u, v.
+// Callers size the outputs from the count functions, the generators never touch the heap: the angles come
+// from sin / cos tables built once per call in a scratch arena and every row of vertices is one kernel call.
+const int MESH_FLOATS_PER_VERTEX = 8;
+
+// Row kernels, all produce identical vertices
+enum MeshKernels
+{
+    MESH_KERNELS_SCALAR,
+    MESH_KERNELS_SSE2,
+    MESH_KERNELS_AVX2,
+    MESH_KERNELS_COUNT
+};
+
+// Switches kernels (benchmarking), returns false if the CPU cannot run them. The fastest supported
+// set is picked on first use.
+bool USetMeshKernels(MeshKernels kernels);
+MeshKernels UGetMeshKernels();
+const char* UMeshKernelsName(MeshKernels kernels);
+
+// cos and sin of start + i * step, and a parameter i * paramStep, for i < count, stored in the arena
+struct SinCosTable
+{
+    float* cosines;
+    float* sines;
+    float* params;
+};
+void UBuildSinCosTable(SinCosTable& table, int count, float start, float step, float paramStep, ScratchArena& arena);
+
+// A generated mesh's arrays in a ScratchArena, valid until the arena is reset
+struct GeneratedMesh
+{
+    float* vertices;
+    size_t vertexCount;
+    unsigned int* indices;
+    size_t indexCount;
+};
+
+// Every float of vertex j in a row is base + cosWeight * cos[j] + sinWeight * sin[j] + paramWeight * param[j]
+struct VertexRow
+{
+    float base[MESH_FLOATS_PER_VERTEX];
+    float cosWeight[MESH_FLOATS_PER_VERTEX];
+    float sinWeight[MESH_FLOATS_PER_VERTEX];
+    float paramWeight[MESH_FLOATS_PER_VERTEX];
+};
+
+// Writes count vertices of a row from table entries first.., stride floats apart
+void UEmitVertexRow(const VertexRow& row, const SinCosTable& table, int first, int count, float* out, size_t stride);
+
+// The generators below take their tables from scratch, which may also hold the outputs.
+
+// Circles at z and at length around (cx, cy): both caps, then the side with its own rings
+size_t UCylinderVertexCount(int segments);
+size_t UCylinderIndexCount(int segments);
+void UGenerateCylinder(float cx, float cy, float z, float r, int segments, float length, float* vertices, unsigned int* indices,
+                       ScratchArena& scratch);
+
+// Ring of ringRadius around the Z axis through (x, y, z)
+size_t UTorusVertexCount(int tubeSegments, int ringSegments);
+size_t UTorusIndexCount(int tubeSegments, int ringSegments);
+void UGenerateTorus(float x, float y, float z, float tubeRadius, float ringRadius, int tubeSegments, int ringSegments,
+                    float* vertices, unsigned int* indices, ScratchArena& scratch);
+
+// Smooth UV sphere around the origin, stacks + 1 rows of sectors + 1 vertices from the +Z pole down.
+// UGenerateSphereVertices writes rows firstStack..firstStack + stackRows - 1 only, so very large spheres
+// can be generated in bands. lineIndices may be null.
+size_t USphereVertexCount(int sectors, int stacks);
+size_t USphereIndexCount(int sectors, int stacks);
+size_t USphereLineIndexCount(int sectors, int stacks);
+void UGenerateSphereVertices(float radius, int sectors, int stacks, int firstStack, int stackRows, float* vertices,
+                             ScratchArena& scratch);
+void UGenerateSphereIndices(int sectors, int stacks, unsigned int* indices, unsigned int* lineIndices);
+
+// Generates a 10,000 x 10,000 sphere in bands with each supported kernel set and prints vertices per second
+void UBenchmarkMeshGeneration();
+
+#endif
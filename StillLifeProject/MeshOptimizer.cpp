@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <cmath>
+
+#include "MeshOptimizer.h"
+
+using namespace std;
+
+
+VertexCacheStats UAnalyzeVertexCache(const vector<GLuint>& indices, size_t vertexCount)
+{
+    // a vertex is cached while fewer than MESH_CACHE_SIZE misses happened since its own
+    vector<unsigned int> cacheTime(vertexCount, 0);
+    unsigned int time = MESH_CACHE_SIZE + 1;
+
+    VertexCacheStats stats;
+    for (GLuint index : indices)
+    {
+        if (time - cacheTime[index] > MESH_CACHE_SIZE)
+        {
+            cacheTime[index] = time++;
+            ++stats.transforms;
+        }
+    }
+    if (!indices.empty())
+        stats.acmr = (float)stats.transforms / (float)(indices.size() / 3);
+    if (vertexCount)
+        stats.atvr = (float)stats.transforms / (float)vertexCount;
+    return stats;
+}
+
+
+vector<size_t> UOptimizeVertexCache(vector<GLuint>& indices, size_t vertexCount)
+{
+    vector<size_t> clusterStarts;
+    if (indices.empty())
+        return clusterStarts;
+
+    // triangles around each vertex, firstTriangle[v]..firstTriangle[v + 1] in adjacency
+    vector<unsigned int> firstTriangle(vertexCount + 1, 0);
+    for (GLuint index : indices)
+        ++firstTriangle[index + 1];
+    for (size_t v = 0; v < vertexCount; ++v)
+        firstTriangle[v + 1] += firstTriangle[v];
+    vector<unsigned int> adjacency(indices.size());
+    vector<unsigned int> fill(firstTriangle.begin(), firstTriangle.end() - 1);
+    for (size_t i = 0; i < indices.size(); ++i)
+        adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+
+    // triangles not yet emitted around each vertex
+    vector<int> live(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        live[v] = (int)(firstTriangle[v + 1] - firstTriangle[v]);
+
+    vector<unsigned int> cacheTime(vertexCount, 0);
+    unsigned int time = MESH_CACHE_SIZE + 1;
+    vector<bool> emitted(indices.size() / 3, false);
+    vector<GLuint> deadEnd;         // recently emitted vertices, where the walk resumes when it gets stuck
+    vector<GLuint> candidates;
+    vector<GLuint> output;
+    output.reserve(indices.size());
+    size_t cursor = 0;              // next vertex in input order when the dead-end stack runs dry
+
+    int fan = indices[0];
+    clusterStarts.push_back(0);
+    while (fan >= 0)
+    {
+        // emit every remaining triangle around the fan vertex
+        candidates.clear();
+        for (unsigned int a = firstTriangle[fan]; a < firstTriangle[fan + 1]; ++a)
+        {
+            unsigned int triangle = adjacency[a];
+            if (emitted[triangle])
+                continue;
+            emitted[triangle] = true;
+            for (int k = 0; k < 3; ++k)
+            {
+                GLuint v = indices[triangle * 3 + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                --live[v];
+                if (time - cacheTime[v] > MESH_CACHE_SIZE)
+                    cacheTime[v] = time++;
+            }
+        }
+
+        // next fan: the oldest candidate whose remaining triangles still fit before it is evicted,
+        // otherwise any candidate with triangles left
+        fan = -1;
+        int bestPriority = -1;
+        for (GLuint v : candidates)
+        {
+            if (live[v] <= 0)
+                continue;
+            int age = (int)(time - cacheTime[v]);
+            int priority = age + 2 * live[v] <= MESH_CACHE_SIZE ? age : 0;
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                fan = v;
+            }
+        }
+
+        if (fan < 0)
+        {
+            // dead end, the cache is cold from here on so a new cluster starts
+            while (fan < 0 && !deadEnd.empty())
+            {
+                GLuint v = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[v] > 0)
+                    fan = v;
+            }
+            for (; fan < 0 && cursor < vertexCount; ++cursor)
+            {
+                if (live[cursor] > 0)
+                    fan = (int)cursor;
+            }
+            if (fan >= 0)
+                clusterStarts.push_back(output.size() / 3);
+        }
+    }
+
+    indices.swap(output);
+    return clusterStarts;
+}
+
+
+void UOptimizeOverdraw(vector<GLuint>& indices, const vector<PoolVertex>& vertices,
+                       const vector<size_t>& clusterStarts, float threshold)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0 || clusterStarts.empty())
+        return;
+
+    vector<unsigned int> cacheTime(vertices.size(), 0);
+    unsigned int time = MESH_CACHE_SIZE + 1;
+    auto misses = [&](size_t triangle)
+    {
+        int count = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            GLuint v = indices[triangle * 3 + k];
+            if (time - cacheTime[v] > MESH_CACHE_SIZE)
+            {
+                cacheTime[v] = time++;
+                ++count;
+            }
+        }
+        return count;
+    };
+    // ACMR of triangles first..end - 1 drawn from a cold cache
+    auto runAcmr = [&](size_t first, size_t end)
+    {
+        time += MESH_CACHE_SIZE + 1;
+        int runMisses = 0;
+        for (size_t t = first; t < end; ++t)
+            runMisses += misses(t);
+        return (float)runMisses / (float)(end - first);
+    };
+
+    // Splits every cluster as soon as the part walked so far, from a cold cache, is within the threshold
+    // of the whole cluster's ACMR. Small clusters sort well without costing much cache efficiency.
+    vector<size_t> starts;
+    for (size_t c = 0; c < clusterStarts.size(); ++c)
+    {
+        size_t begin = clusterStarts[c];
+        size_t end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : triangleCount;
+
+        float limit = threshold * runAcmr(begin, end);
+
+        time += MESH_CACHE_SIZE + 1;
+        starts.push_back(begin);
+        int runMisses = 0;
+        int runTriangles = 0;
+        for (size_t t = begin; t < end; ++t)
+        {
+            runMisses += misses(t);
+            ++runTriangles;
+            if (t + 1 < end && (float)runMisses / (float)runTriangles <= limit)
+            {
+                starts.push_back(t + 1);
+                time += MESH_CACHE_SIZE + 1;
+                runMisses = runTriangles = 0;
+            }
+        }
+
+        // the last run ends with the cluster, not at a split that passed the test: merge it into the
+        // runs before it until it does (the whole cluster always passes)
+        if (runTriangles > 0 && (float)runMisses / (float)runTriangles > limit)
+        {
+            starts.pop_back();
+            while (starts.back() > begin && runAcmr(starts.back(), end) > limit)
+                starts.pop_back();
+        }
+    }
+
+    // area weighted centroid and normal of every cluster and of the whole mesh
+    size_t clusterCount = starts.size();
+    vector<float> centroids(clusterCount * 3, 0.0f);
+    vector<float> normals(clusterCount * 3, 0.0f);
+    vector<float> areas(clusterCount, 0.0f);
+    float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+    float meshArea = 0.0f;
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        size_t end = c + 1 < clusterCount ? starts[c + 1] : triangleCount;
+        for (size_t t = starts[c]; t < end; ++t)
+        {
+            const GLfloat* p0 = vertices[indices[t * 3 + 0]].position;
+            const GLfloat* p1 = vertices[indices[t * 3 + 1]].position;
+            const GLfloat* p2 = vertices[indices[t * 3 + 2]].position;
+            float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+            float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            float area = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int k = 0; k < 3; ++k)
+            {
+                float center = (p0[k] + p1[k] + p2[k]) / 3.0f;
+                centroids[c * 3 + k] += center * area;
+                normals[c * 3 + k] += n[k];
+                meshCentroid[k] += center * area;
+            }
+            areas[c] += area;
+            meshArea += area;
+        }
+    }
+    for (int k = 0; k < 3; ++k)
+        meshCentroid[k] = meshArea > 0.0f ? meshCentroid[k] / meshArea : 0.0f;
+
+    // clusters facing away from the centre are drawn first, they are the ones that occlude the rest
+    vector<float> sortKey(clusterCount, 0.0f);
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        const float* n = &normals[c * 3];
+        float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (areas[c] <= 0.0f || length <= 0.0f)
+            continue;
+        for (int k = 0; k < 3; ++k)
+            sortKey[c] += (centroids[c * 3 + k] / areas[c] - meshCentroid[k]) * n[k] / length;
+    }
+
+    vector<size_t> order(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c)
+        order[c] = c;
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+    vector<GLuint> output;
+    output.reserve(indices.size());
+    for (size_t c : order)
+    {
+        size_t end = c + 1 < clusterCount ? starts[c + 1] : triangleCount;
+        output.insert(output.end(), indices.begin() + starts[c] * 3, indices.begin() + end * 3);
+    }
+    indices.swap(output);
+}
+
+
+void UOptimizeVertexFetch(vector<PoolVertex>& vertices, vector<GLuint>& indices)
+{
+    vector<int> remap(vertices.size(), -1);
+    vector<PoolVertex> ordered;
+    ordered.reserve(vertices.size());
+    for (GLuint& index : indices)
+    {
+        if (remap[index] < 0)
+        {
+            remap[index] = (int)ordered.size();
+            ordered.push_back(vertices[index]);
+        }
+        index = (GLuint)remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+
+void UOptimizeMesh(vector<PoolVertex>& vertices, vector<GLuint>& indices)
+{
+    vector<size_t> clusterStarts = UOptimizeVertexCache(indices, vertices.size());
+
+    // the clusters are measured from a cold cache but drawn after each other, so check the
+    // sorted order as a whole and keep the cache order if it lost more than the threshold
+    vector<GLuint> sorted = indices;
+    UOptimizeOverdraw(sorted, vertices, clusterStarts, MESH_OVERDRAW_THRESHOLD);
+    if (UAnalyzeVertexCache(sorted, vertices.size()).acmr
+        <= MESH_OVERDRAW_THRESHOLD * UAnalyzeVertexCache(indices, vertices.size()).acmr)
+        indices.swap(sorted);
+
+    UOptimizeVertexFetch(vertices, indices);
+}
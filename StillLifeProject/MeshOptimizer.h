@@ -0,0 +1,42 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstddef>
+#include <vector>
+#include <GL/glew.h>
+
+#include "GeometryPool.h"
+
+// FIFO size the orderings are tuned for and the statistics are measured with
+const int MESH_CACHE_SIZE = 16;
+
+// Largest ACMR increase the overdraw pass may cost, relative to the cache order it starts from
+const float MESH_OVERDRAW_THRESHOLD = 1.05f;
+
+// Post-transform cache efficiency of an index order, simulated with a FIFO of MESH_CACHE_SIZE entries
+struct VertexCacheStats
+{
+    size_t transforms = 0;      // cache misses, one vertex shader run each
+    float acmr = 0.0f;          // average cache miss ratio, transforms per triangle (0.5 is ideal for large grids)
+    float atvr = 0.0f;          // average transform to vertex ratio, 1.0 means every vertex is shaded once
+};
+
+VertexCacheStats UAnalyzeVertexCache(const std::vector<GLuint>& indices, size_t vertexCount);
+
+// Tipsify (Sander et al. 2007): walks the mesh fan by fan around the vertex that stays longest in the cache.
+// Returns the positions in the new order where the walk had to restart, which begin a new cluster.
+std::vector<size_t> UOptimizeVertexCache(std::vector<GLuint>& indices, size_t vertexCount);
+
+// Splits the Tipsify clusters where the cache order allows it and draws the clusters facing away from the
+// mesh centre first, so the outer surfaces hide the inner ones. Costs at most `threshold` times the ACMR.
+void UOptimizeOverdraw(std::vector<GLuint>& indices, const std::vector<PoolVertex>& vertices,
+                       const std::vector<size_t>& clusterStarts, float threshold = MESH_OVERDRAW_THRESHOLD);
+
+// Renumbers the vertices in the order the indices first reference them, dropping unreferenced ones
+void UOptimizeVertexFetch(std::vector<PoolVertex>& vertices, std::vector<GLuint>& indices);
+
+// All three passes in order, before uploading a generated mesh. The overdraw order is dropped if the
+// whole mesh's ACMR grows by more than MESH_OVERDRAW_THRESHOLD.
+void UOptimizeMesh(std::vector<PoolVertex>& vertices, std::vector<GLuint>& indices);
+
+#endif
@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <new>
+
+#include "ScratchArena.h"
+
+using namespace std;
+
+namespace
+{
+    // every allocation is rounded to the alignment, so a merged block replays a round without padding
+    const size_t ARENA_ALIGNMENT = 16;
+    const size_t MIN_BLOCK_SIZE = 64 * 1024;
+
+    size_t alignUp(size_t bytes)
+    {
+        return (bytes + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+    }
+}
+
+
+struct ScratchArena::Block
+{
+    Block* next;
+    size_t size;
+    size_t used;
+
+    unsigned char* data()   { return reinterpret_cast<unsigned char*>(this) + alignUp(sizeof(Block)); }
+};
+
+
+ScratchArena::~ScratchArena()
+{
+    release();
+}
+
+
+void* ScratchArena::allocateBytes(size_t bytes)
+{
+    bytes = alignUp(max(bytes, (size_t)1));
+    if (!blocks || blocks->used + bytes > blocks->size)
+    {
+        // at least double the last block, so a growing round chains few of them
+        addBlock(max(bytes, max(MIN_BLOCK_SIZE, blocks ? blocks->size * 2 : (size_t)0)));
+    }
+
+    void* memory = blocks->data() + blocks->used;
+    blocks->used += bytes;
+    used += bytes;
+    return memory;
+}
+
+
+void ScratchArena::reset()
+{
+    if (blocks && blocks->next)
+    {
+        size_t merged = capacity;
+        release();
+        addBlock(merged);
+    }
+    if (blocks)
+        blocks->used = 0;
+    used = 0;
+}
+
+
+void ScratchArena::release()
+{
+    while (blocks)
+    {
+        Block* next = blocks->next;
+        delete[] reinterpret_cast<unsigned char*>(blocks);
+        blocks = next;
+    }
+    used = 0;
+    capacity = 0;
+}
+
+
+void ScratchArena::addBlock(size_t size)
+{
+    // operator new[] memory is aligned for any fundamental type, the header is padded to keep data aligned
+    unsigned char* memory = new unsigned char[alignUp(sizeof(Block)) + size];
+    Block* block = new (memory) Block;
+    block->next = blocks;
+    block->size = size;
+    block->used = 0;
+    blocks = block;
+    capacity += size;
+    ++heapAllocations;
+}
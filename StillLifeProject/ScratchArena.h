@@ -0,0 +1,43 @@
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#include <cstddef>
+
+// Linear allocator for temporary and generated geometry. Allocations bump an offset through one block and are
+// only given back all at once by reset(). A round that outgrows the block chains more blocks; the next reset()
+// merges them into one block big enough for the whole round, so repeating the same work takes nothing from
+// the heap. Only meant for trivially copyable data, nothing is constructed or destroyed.
+class ScratchArena
+{
+public:
+    ScratchArena() {}
+    ~ScratchArena();
+
+    // uninitialized room for count T, 16-byte aligned, valid until the next reset() or release()
+    template <typename T>
+    T* allocate(size_t count)   { return static_cast<T*>(allocateBytes(count * sizeof(T))); }
+    void* allocateBytes(size_t bytes);
+
+    // forgets every allocation and keeps the memory
+    void reset();
+    // gives every block back to the heap
+    void release();
+
+    size_t getUsed() const              { return used; }        // bytes handed out since the last reset
+    size_t getCapacity() const          { return capacity; }
+    size_t getHeapAllocations() const   { return heapAllocations; }
+
+private:
+    ScratchArena(const ScratchArena&);              // not copyable
+    ScratchArena& operator=(const ScratchArena&);
+
+    struct Block;
+    void addBlock(size_t size);
+
+    Block* blocks = nullptr;    // newest first, allocations come from the newest
+    size_t used = 0;
+    size_t capacity = 0;
+    size_t heapAllocations = 0;
+};
+
+#endif
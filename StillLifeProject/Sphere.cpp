@@ -23,6 +23,7 @@
 #include <iomanip>
 #include <cmath>
 #include "Sphere.h"
+#include "MeshGenerators.h"
 
 
 
@@ -35,7 +36,10 @@ const int MIN_STACK_COUNT  = 2;
 ///////////////////////////////////////////////////////////////////////////////
 // ctor
 ///////////////////////////////////////////////////////////////////////////////
-Sphere::Sphere(float radius, int sectors, int stacks, bool smooth) : interleavedStride(32)
+Sphere::Sphere(float radius, int sectors, int stacks, bool smooth, int dataFlags) : dataFlags(dataFlags), released(false),
+                                                                                   vertexCount(0), indexCount(0), lineIndexCount(0),
+                                                                                   vertices(0), normals(0), texCoords(0), indices(0),
+                                                                                   lineIndices(0), interleavedVertices(0), interleavedStride(32)
 {
     set(radius, sectors, stacks, smooth);
 }
@@ -55,11 +59,7 @@ void Sphere::set(float radius, int sectors, int stacks, bool smooth)
     if(sectors < MIN_STACK_COUNT)
         this->sectorCount = MIN_STACK_COUNT;
     this->smooth = smooth;
-
-    if(smooth)
-        buildVerticesSmooth();
-    else
-        buildVerticesFlat();
+    build();
 }
 
 void Sphere::setRadius(float radius)
@@ -86,10 +86,29 @@ void Sphere::setSmooth(bool smooth)
         return;
 
     this->smooth = smooth;
-    if(smooth)
-        buildVerticesSmooth();
-    else
-        buildVerticesFlat();
+    build();
+}
+
+void Sphere::setDataFlags(int dataFlags)
+{
+    if(this->dataFlags == dataFlags && !released)
+        return;
+
+    this->dataFlags = dataFlags;
+    build();
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// free the CPU arrays, e.g. once they are copied to a GPU buffer
+// the counts are kept, drawing in VertexArray mode needs a rebuild
+///////////////////////////////////////////////////////////////////////////////
+void Sphere::releaseData()
+{
+    clearArrays();
+    arena.release();
+    released = true;
 }
 
 
@@ -119,6 +138,9 @@ void Sphere::printSelf() const
 ///////////////////////////////////////////////////////////////////////////////
 void Sphere::draw() const
 {
+    if(!interleavedVertices)
+        return;
+
     // interleaved array
     glEnableClientState(GL_VERTEX_ARRAY);
     glEnableClientState(GL_NORMAL_ARRAY);
@@ -127,7 +149,7 @@ void Sphere::draw() const
     glNormalPointer(GL_FLOAT, interleavedStride, &interleavedVertices[3]);
     glTexCoordPointer(2, GL_FLOAT, interleavedStride, &interleavedVertices[6]);
 
-    glDrawElements(GL_TRIANGLES, (unsigned int)indices.size(), GL_UNSIGNED_INT, indices.data());
+    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, indices);
 
     glDisableClientState(GL_VERTEX_ARRAY);
     glDisableClientState(GL_NORMAL_ARRAY);
@@ -142,6 +164,11 @@ void Sphere::draw() const
 ///////////////////////////////////////////////////////////////////////////////
 void Sphere::drawLines(const float lineColor[4]) const
 {
+    // positions from whichever vertex array the build kept
+    bool interleaved = interleavedVertices != 0;
+    if(!lineIndices || (!interleaved && !vertices))
+        return;
+
     // set line colour
     glColor4fv(lineColor);
     glMaterialfv(GL_FRONT, GL_DIFFUSE,   lineColor);
@@ -150,9 +177,9 @@ void Sphere::drawLines(const float lineColor[4]) const
     glDisable(GL_LIGHTING);
     glDisable(GL_TEXTURE_2D);
     glEnableClientState(GL_VERTEX_ARRAY);
-    glVertexPointer(3, GL_FLOAT, 0, vertices.data());
+    glVertexPointer(3, GL_FLOAT, interleaved ? interleavedStride : 0, interleaved ? interleavedVertices : vertices);
 
-    glDrawElements(GL_LINES, (unsigned int)lineIndices.size(), GL_UNSIGNED_INT, lineIndices.data());
+    glDrawElements(GL_LINES, lineIndexCount, GL_UNSIGNED_INT, lineIndices);
 
     glDisableClientState(GL_VERTEX_ARRAY);
     glEnable(GL_LIGHTING);
@@ -205,15 +232,35 @@ void Sphere::updateRadius()
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// dealloc vectors
+// forget the arrays, their memory stays in the arena for the next build
 ///////////////////////////////////////////////////////////////////////////////
 void Sphere::clearArrays()
 {
-    std::vector<float>().swap(vertices);
-    std::vector<float>().swap(normals);
-    std::vector<float>().swap(texCoords);
-    std::vector<unsigned int>().swap(indices);
-    std::vector<unsigned int>().swap(lineIndices);
+    arena.reset();
+    vertices = normals = texCoords = interleavedVertices = 0;
+    indices = lineIndices = 0;
+}
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+// build the arrays selected by dataFlags
+// both builders write the interleaved array, the separate ones are copied out
+// of it and the interleaved one is dropped when dataFlags does not ask for it
+///////////////////////////////////////////////////////////////////////////////
+void Sphere::build()
+{
+    clearArrays();
+    released = false;
+    if(smooth)
+        buildVerticesSmooth();
+    else
+        buildVerticesFlat();
+
+    if(dataFlags & SPHERE_SEPARATE)
+        buildSeparateArrays();
+    if(!(dataFlags & SPHERE_INTERLEAVED))
+        interleavedVertices = 0;
 }
 
 
@@ -225,89 +272,22 @@ void Sphere::clearArrays()
 // z = r * sin(u)
 // where u: stack(latitude) angle (-90 <= u <= 90)
 //       v: sector(longitude) angle (0 <= v <= 360)
+// The interleaved array is written in place by the table driven generator
+// (MeshGenerators.h), line indices are skipped unless dataFlags asks for them.
 ///////////////////////////////////////////////////////////////////////////////
 void Sphere::buildVerticesSmooth()
 {
-    const float PI = acos(-1);
-
-    // clear memory of prev arrays
-    clearArrays();
-
-    float x, y, z, xy;                              // vertex position
-    float nx, ny, nz, lengthInv = 1.0f / radius;    // normal
-    float s, t;                                     // texCoord
-
-    float sectorStep = 2 * PI / sectorCount;
-    float stackStep = PI / stackCount;
-    float sectorAngle, stackAngle;
-
-    for(int i = 0; i <= stackCount; ++i)
-    {
-        stackAngle = PI / 2 - i * stackStep;        // starting from pi/2 to -pi/2
-        xy = radius * cosf(stackAngle);             // r * cos(u)
-        z = radius * sinf(stackAngle);              // r * sin(u)
-
-        // add (sectorCount+1) vertices per stack
-        // the first and last vertices have same position and normal, but different tex coords
-        for(int j = 0; j <= sectorCount; ++j)
-        {
-            sectorAngle = j * sectorStep;           // starting from 0 to 2pi
+    vertexCount = (unsigned int)USphereVertexCount(sectorCount, stackCount);
+    indexCount = (unsigned int)USphereIndexCount(sectorCount, stackCount);
+    lineIndexCount = (dataFlags & SPHERE_LINES) ? (unsigned int)USphereLineIndexCount(sectorCount, stackCount) : 0;
 
-            // vertex position
-            x = xy * cosf(sectorAngle);             // r * cos(u) * cos(v)
-            y = xy * sinf(sectorAngle);             // r * cos(u) * sin(v)
-            addVertex(x, y, z);
-
-            // normalized vertex normal
-            nx = x * lengthInv;
-            ny = y * lengthInv;
-            nz = z * lengthInv;
-            addNormal(nx, ny, nz);
-
-            // vertex tex coord between [0, 1]
-            s = (float)j / sectorCount;
-            t = (float)i / stackCount;
-            addTexCoord(s, t);
-        }
-    }
-
-    // indices
-    //  k1--k1+1
-    //  |  / |
-    //  | /  |
-    //  k2--k2+1
-    unsigned int k1, k2;
-    for(int i = 0; i < stackCount; ++i)
-    {
-        k1 = i * (sectorCount + 1);     // beginning of current stack
-        k2 = k1 + sectorCount + 1;      // beginning of next stack
-
-        for(int j = 0; j < sectorCount; ++j, ++k1, ++k2)
-        {
-            // 2 triangles per sector excluding 1st and last stacks
-            if(i != 0)
-            {
-                addIndices(k1, k2, k1+1);   // k1---k2---k1+1
-            }
-
-            if(i != (stackCount-1))
-            {
-                addIndices(k1+1, k2, k2+1); // k1+1---k2---k2+1
-            }
-
-            // vertical lines for all stacks
-            lineIndices.push_back(k1);
-            lineIndices.push_back(k2);
-            if(i != 0)  // horizontal lines except 1st stack
-            {
-                lineIndices.push_back(k1);
-                lineIndices.push_back(k1 + 1);
-            }
-        }
-    }
+    interleavedVertices = arena.allocate<float>((std::size_t)vertexCount * MESH_FLOATS_PER_VERTEX);
+    UGenerateSphereVertices(radius, sectorCount, stackCount, 0, stackCount + 1, interleavedVertices, arena);
 
-    // generate interleaved vertex array as well
-    buildInterleavedVertices();
+    indices = arena.allocate<unsigned int>(indexCount);
+    if(lineIndexCount > 0)
+        lineIndices = arena.allocate<unsigned int>(lineIndexCount);
+    UGenerateSphereIndices(sectorCount, stackCount, indices, lineIndices);
 }
 
 
@@ -325,13 +305,14 @@ void Sphere::buildVerticesFlat()
     {
         float x, y, z, s, t;
     };
-    std::vector<Vertex> tmpVertices;
+    Vertex* tmpVertices = arena.allocate<Vertex>((std::size_t)(stackCount + 1) * (sectorCount + 1));
 
     float sectorStep = 2 * PI / sectorCount;
     float stackStep = PI / stackCount;
     float sectorAngle, stackAngle;
 
     // compute all vertices first, each vertex contains (x,y,z,s,t) except normal
+    Vertex* vertex = tmpVertices;
     for(int i = 0; i <= stackCount; ++i)
     {
         stackAngle = PI / 2 - i * stackStep;        // starting from pi/2 to -pi/2
@@ -340,27 +321,31 @@ void Sphere::buildVerticesFlat()
 
         // add (sectorCount+1) vertices per stack
         // the first and last vertices have same position and normal, but different tex coords
-        for(int j = 0; j <= sectorCount; ++j)
+        for(int j = 0; j <= sectorCount; ++j, ++vertex)
         {
             sectorAngle = j * sectorStep;           // starting from 0 to 2pi
 
-            Vertex vertex;
-            vertex.x = xy * cosf(sectorAngle);      // x = r * cos(u) * cos(v)
-            vertex.y = xy * sinf(sectorAngle);      // y = r * cos(u) * sin(v)
-            vertex.z = z;                           // z = r * sin(u)
-            vertex.s = (float)j/sectorCount;        // s
-            vertex.t = (float)i/stackCount;         // t
-            tmpVertices.push_back(vertex);
+            vertex->x = xy * cosf(sectorAngle);     // x = r * cos(u) * cos(v)
+            vertex->y = xy * sinf(sectorAngle);     // y = r * cos(u) * sin(v)
+            vertex->z = z;                          // z = r * sin(u)
+            vertex->s = (float)j/sectorCount;       // s
+            vertex->t = (float)i/stackCount;        // t
         }
     }
 
-    // clear memory of prev arrays
-    clearArrays();
+    // 1 triangle per sector on the first and last stacks, a quad on the others
+    std::size_t quadStacks = stackCount > 2 ? stackCount - 2 : 0;
+    std::size_t triangleStacks = stackCount - quadStacks;
+    interleavedVertices = arena.allocate<float>(sectorCount * (3 * triangleStacks + 4 * quadStacks) * MESH_FLOATS_PER_VERTEX);
+    indices = arena.allocate<unsigned int>(sectorCount * (3 * triangleStacks + 6 * quadStacks));
+    if(dataFlags & SPHERE_LINES)
+        lineIndices = arena.allocate<unsigned int>(sectorCount * (2 + 4 * (std::size_t)(stackCount - 1)));
+    vertexCount = indexCount = lineIndexCount = 0;
 
     Vertex v1, v2, v3, v4;                          // 4 vertex positions and tex coords
-    std::vector<float> n;                           // 1 face normal
+    float n[3];                                     // 1 face normal
 
-    int i, j, k, vi1, vi2;
+    int i, j, vi1, vi2;
     int index = 0;                                  // index for vertex
     for(i = 0; i < stackCount; ++i)
     {
@@ -382,174 +367,127 @@ void Sphere::buildVerticesFlat()
             // otherwise, store 2 triangles (quad) per sector
             if(i == 0) // a triangle for first stack ==========================
             {
-                // put a triangle
-                addVertex(v1.x, v1.y, v1.z);
-                addVertex(v2.x, v2.y, v2.z);
-                addVertex(v4.x, v4.y, v4.z);
-
-                // put tex coords of triangle
-                addTexCoord(v1.s, v1.t);
-                addTexCoord(v2.s, v2.t);
-                addTexCoord(v4.s, v4.t);
-
-                // put normal
-                n = computeFaceNormal(v1.x,v1.y,v1.z, v2.x,v2.y,v2.z, v4.x,v4.y,v4.z);
-                for(k = 0; k < 3; ++k)  // same normals for 3 vertices
-                {
-                    addNormal(n[0], n[1], n[2]);
-                }
+                // put a triangle with the same normal for its 3 vertices
+                computeFaceNormal(v1.x,v1.y,v1.z, v2.x,v2.y,v2.z, v4.x,v4.y,v4.z, n);
+                addVertex(v1.x, v1.y, v1.z, n, v1.s, v1.t);
+                addVertex(v2.x, v2.y, v2.z, n, v2.s, v2.t);
+                addVertex(v4.x, v4.y, v4.z, n, v4.s, v4.t);
 
                 // put indices of 1 triangle
                 addIndices(index, index+1, index+2);
 
                 // indices for line (first stack requires only vertical line)
-                lineIndices.push_back(index);
-                lineIndices.push_back(index+1);
+                addLineIndices(index, index+1);
 
                 index += 3;     // for next
             }
             else if(i == (stackCount-1)) // a triangle for last stack =========
             {
-                // put a triangle
-                addVertex(v1.x, v1.y, v1.z);
-                addVertex(v2.x, v2.y, v2.z);
-                addVertex(v3.x, v3.y, v3.z);
-
-                // put tex coords of triangle
-                addTexCoord(v1.s, v1.t);
-                addTexCoord(v2.s, v2.t);
-                addTexCoord(v3.s, v3.t);
-
-                // put normal
-                n = computeFaceNormal(v1.x,v1.y,v1.z, v2.x,v2.y,v2.z, v3.x,v3.y,v3.z);
-                for(k = 0; k < 3; ++k)  // same normals for 3 vertices
-                {
-                    addNormal(n[0], n[1], n[2]);
-                }
+                // put a triangle with the same normal for its 3 vertices
+                computeFaceNormal(v1.x,v1.y,v1.z, v2.x,v2.y,v2.z, v3.x,v3.y,v3.z, n);
+                addVertex(v1.x, v1.y, v1.z, n, v1.s, v1.t);
+                addVertex(v2.x, v2.y, v2.z, n, v2.s, v2.t);
+                addVertex(v3.x, v3.y, v3.z, n, v3.s, v3.t);
 
                 // put indices of 1 triangle
                 addIndices(index, index+1, index+2);
 
                 // indices for lines (last stack requires both vert/hori lines)
-                lineIndices.push_back(index);
-                lineIndices.push_back(index+1);
-                lineIndices.push_back(index);
-                lineIndices.push_back(index+2);
+                addLineIndices(index, index+1);
+                addLineIndices(index, index+2);
 
                 index += 3;     // for next
             }
             else // 2 triangles for others ====================================
             {
-                // put quad vertices: v1-v2-v3-v4
-                addVertex(v1.x, v1.y, v1.z);
-                addVertex(v2.x, v2.y, v2.z);
-                addVertex(v3.x, v3.y, v3.z);
-                addVertex(v4.x, v4.y, v4.z);
-
-                // put tex coords of quad
-                addTexCoord(v1.s, v1.t);
-                addTexCoord(v2.s, v2.t);
-                addTexCoord(v3.s, v3.t);
-                addTexCoord(v4.s, v4.t);
-
-                // put normal
-                n = computeFaceNormal(v1.x,v1.y,v1.z, v2.x,v2.y,v2.z, v3.x,v3.y,v3.z);
-                for(k = 0; k < 4; ++k)  // same normals for 4 vertices
-                {
-                    addNormal(n[0], n[1], n[2]);
-                }
+                // put quad vertices: v1-v2-v3-v4 with the same normal
+                computeFaceNormal(v1.x,v1.y,v1.z, v2.x,v2.y,v2.z, v3.x,v3.y,v3.z, n);
+                addVertex(v1.x, v1.y, v1.z, n, v1.s, v1.t);
+                addVertex(v2.x, v2.y, v2.z, n, v2.s, v2.t);
+                addVertex(v3.x, v3.y, v3.z, n, v3.s, v3.t);
+                addVertex(v4.x, v4.y, v4.z, n, v4.s, v4.t);
 
                 // put indices of quad (2 triangles)
                 addIndices(index, index+1, index+2);
                 addIndices(index+2, index+1, index+3);
 
                 // indices for lines
-                lineIndices.push_back(index);
-                lineIndices.push_back(index+1);
-                lineIndices.push_back(index);
-                lineIndices.push_back(index+2);
+                addLineIndices(index, index+1);
+                addLineIndices(index, index+2);
 
                 index += 4;     // for next
             }
         }
     }
-
-    // generate interleaved vertex array as well
-    buildInterleavedVertices();
 }
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// generate interleaved vertices: V/N/T
+// copy the separate V, N and T arrays out of the interleaved vertices
 // stride must be 32 bytes
 ///////////////////////////////////////////////////////////////////////////////
-void Sphere::buildInterleavedVertices()
+void Sphere::buildSeparateArrays()
 {
-    std::vector<float>().swap(interleavedVertices);
+    vertices = arena.allocate<float>((std::size_t)vertexCount * 3);
+    normals = arena.allocate<float>((std::size_t)vertexCount * 3);
+    texCoords = arena.allocate<float>((std::size_t)vertexCount * 2);
 
-    std::size_t i, j;
-    std::size_t count = vertices.size();
-    for(i = 0, j = 0; i < count; i += 3, j += 2)
+    for(std::size_t i = 0; i < vertexCount; ++i)
     {
-        interleavedVertices.push_back(vertices[i]);
-        interleavedVertices.push_back(vertices[i+1]);
-        interleavedVertices.push_back(vertices[i+2]);
-
-        interleavedVertices.push_back(normals[i]);
-        interleavedVertices.push_back(normals[i+1]);
-        interleavedVertices.push_back(normals[i+2]);
-
-        interleavedVertices.push_back(texCoords[j]);
-        interleavedVertices.push_back(texCoords[j+1]);
+        const float* vertex = &interleavedVertices[i * MESH_FLOATS_PER_VERTEX];
+        for(int k = 0; k < 3; ++k)
+        {
+            vertices[i * 3 + k] = vertex[k];
+            normals[i * 3 + k] = vertex[3 + k];
+        }
+        texCoords[i * 2] = vertex[6];
+        texCoords[i * 2 + 1] = vertex[7];
     }
 }
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// add single vertex to array
+// add single interleaved vertex (V/N/T) to array
 ///////////////////////////////////////////////////////////////////////////////
-void Sphere::addVertex(float x, float y, float z)
+void Sphere::addVertex(float x, float y, float z, const float normal[3], float s, float t)
 {
-    vertices.push_back(x+.7);
-    vertices.push_back(y-2);
-    vertices.push_back(z+1.2);
+    float* vertex = &interleavedVertices[(std::size_t)vertexCount++ * MESH_FLOATS_PER_VERTEX];
+    vertex[0] = x;
+    vertex[1] = y;
+    vertex[2] = z;
+    vertex[3] = normal[0];
+    vertex[4] = normal[1];
+    vertex[5] = normal[2];
+    vertex[6] = s;
+    vertex[7] = t;
 }
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// add single normal to array
+// add 3 indices to array
 ///////////////////////////////////////////////////////////////////////////////
-void Sphere::addNormal(float nx, float ny, float nz)
+void Sphere::addIndices(unsigned int i1, unsigned int i2, unsigned int i3)
 {
-    normals.push_back(nx);
-    normals.push_back(ny);
-    normals.push_back(nz);
+    indices[indexCount++] = i1;
+    indices[indexCount++] = i2;
+    indices[indexCount++] = i3;
 }
 
 
 
 ///////////////////////////////////////////////////////////////////////////////
-// add single texture coord to array
+// add a line to the line indices, if they are built
 ///////////////////////////////////////////////////////////////////////////////
-void Sphere::addTexCoord(float s, float t)
+void Sphere::addLineIndices(unsigned int i1, unsigned int i2)
 {
-    texCoords.push_back(s);
-    texCoords.push_back(t);
-}
-
-
+    if(!lineIndices)
+        return;
 
-///////////////////////////////////////////////////////////////////////////////
-// add 3 indices to array
-///////////////////////////////////////////////////////////////////////////////
-void Sphere::addIndices(unsigned int i1, unsigned int i2, unsigned int i3)
-{
-    indices.push_back(i1);
-    indices.push_back(i2);
-    indices.push_back(i3);
+    lineIndices[lineIndexCount++] = i1;
+    lineIndices[lineIndexCount++] = i2;
 }
 
 
@@ -558,13 +496,14 @@ void Sphere::addIndices(unsigned int i1, unsigned int i2, unsigned int i3)
 // return face normal of a triangle v1-v2-v3
 // if a triangle has no surface (normal length = 0), then return a zero vector
 ///////////////////////////////////////////////////////////////////////////////
-std::vector<float> Sphere::computeFaceNormal(float x1, float y1, float z1,  // v1
-                                             float x2, float y2, float z2,  // v2
-                                             float x3, float y3, float z3)  // v3
+void Sphere::computeFaceNormal(float x1, float y1, float z1,  // v1
+                               float x2, float y2, float z2,  // v2
+                               float x3, float y3, float z3,  // v3
+                               float normal[3])
 {
     const float EPSILON = 0.000001f;
 
-    std::vector<float> normal(3, 0.0f);     // default return value (0,0,0)
+    normal[0] = normal[1] = normal[2] = 0.0f;   // default return value (0,0,0)
     float nx, ny, nz;
 
     // find 2 edge vectors: v1-v2, v1-v3
@@ -590,6 +529,4 @@ std::vector<float> Sphere::computeFaceNormal(float x1, float y1, float z1,  // v
         normal[1] = ny * lengthInv;
         normal[2] = nz * lengthInv;
     }
-
-    return normal;
 }
@@ -1,9 +1,19 @@
 #include <iostream>         // cout, cerr
-#include <cstdlib>          // EXIT_FAILURE
+#include <cstdlib>          // EXIT_FAILURE, strtoul
+#include <cerrno>           // ERANGE
+#include <cstdint>          // SIZE_MAX
+#include <cstdio>           // remove
+#include <cstring>          // memcmp, strchr
+#include <chrono>           // startup benchmarks
+#include <fstream>
+#include <algorithm>
+#include <cfloat>           // FLT_MAX
+#include <list>             // mapped mesh cache files
+#include <map>              // texture cache
+#include <string>
+#include <vector>
 #include <GL/glew.h>        // GLEW library
 #include <GLFW/glfw3.h>     // GLFW library
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>      // Image loading Utility functions
 
 // GLM Math Header inclusions
 #include <glm/glm.hpp>
@@ -12,6 +22,22 @@
 
 #include <learnOpengl/camera.h> // Camera class
 #include <learnOpengl/Sphere.h> 
+#include "GLResources.h"        // GPU resource registry
+#include "TextureDecoder.h"     // threaded image decoding
+#include "CookedTexture.h"      // precooked mip chains
+#include "ImagePreprocess.h"    // flip / expand / pad before upload
+#include "ImageDecode.h"        // JPEG/PNG decoder with SIMD kernels
+#include "MappedFile.h"         // content hashing of texture files
+#include "TextureStreamer.h"    // mip streaming for the material array
+#include "GeometryPool.h"       // shared vertex / index buffers
+#include "IndirectDraws.h"      // instanced and multi-draw indirect submission
+#include "StreamBuffer.h"       // persistently mapped per-frame data
+#include "GLCallCounter.h"      // GL calls per frame
+#include "MeshOptimizer.h"      // vertex cache and overdraw ordering
+#include "MeshGenerators.h"     // table driven SIMD mesh generators
+#include "MeshCache.h"          // generated meshes cached on disk
+#include "AllocationCounter.h"  // heap allocations of the mesh rebuild benchmark
+#include "TessellatedShapes.h"  // analytic primitives as tessellation patches
 
 
 using namespace std; // Standard namespace
@@ -20,6 +46,9 @@ using namespace std; // Standard namespace
 #ifndef GLSL
 #define GLSL(Version, Source) "#version " #Version " core \n" #Source
 #endif
+#ifndef GLSL_EXTENSION
+#define GLSL_EXTENSION(Version, Extension, Source) "#version " #Version " core \n#extension " #Extension " : require \n" #Source
+#endif
 
 // Unnamed namespace
 namespace
@@ -30,39 +59,235 @@ namespace
     const int WINDOW_WIDTH = 800;
     const int WINDOW_HEIGHT = 600;
 
-    // Stores the GL data relative to a given mesh
+    // A level of detail of a mesh, error is the largest distance of its surface from the true shape
+    const int MAX_MESH_LODS = 4;
+    struct MeshLod
+    {
+        MeshRange range;
+        float error;
+    };
+
+    // LOD chains: segments around each primitive per level, the finest is the original tessellation
+    const int CYLINDER_SEGMENTS[MAX_MESH_LODS] = { 100, 48, 24, 12 };
+    const int TORUS_SEGMENTS[MAX_MESH_LODS] = { 16, 12, 8, 6 };
+    const int SPHERE_SECTORS[MAX_MESH_LODS] = { 100, 48, 24, 12 };
+    const int SPHERE_STACKS[MAX_MESH_LODS] = { 20, 12, 8, 6 };
+
+    // The vase mouth's tube is a fifth of its ring radius, the scene draw scales the ring
+    const float TORUS_TUBE_RADIUS = 0.2f;
+
+    // Stores the GL data relative to a given mesh, shared by every scene draw instancing it
+    // The geometry itself lives in gGeometry
     struct GLMesh
     {
-        GLuint vao;         // Handle for the vertex array object
-        GLuint vbos[2];         // Handle for the vertex buffer object
-        GLuint nIndices;    // Number of indices of the mesh
+        glm::vec3 center;   // Bounding sphere in mesh space, sizes the mesh on screen
+        float radius;
+        MeshLod lods[MAX_MESH_LODS];    // finest first
+        int lodCount = 0;
+        bool tessellated = false;   // drawn from patches instead of the pool
+        PatchRange patches;
     };
 
+    // Every texture, buffer, vertex array and program is created and released through here
+    GLResourceRegistry gResources;
+
+    // Every mesh's vertices and indices, drawn through one vertex array
+    GeometryPool gGeometry;
+
     // Main GLFW window
     GLFWwindow* gWindow = nullptr;
 
-    // Triangle mesh data
-    GLMesh gMesh;  // bowl base
-    GLMesh gMesh2; // bowl
-    GLMesh gMesh3; // vase base
-    GLMesh gMesh4; // plane
-    GLMesh gMesh5; // vase base
-    GLMesh gMesh6; // vase stem
-    GLMesh gMesh7; // vase mouth
-    GLMesh gMesh8; // ramekin lip
-
-    // Textures
-    GLuint gTextureId; // mortar (2)
-    GLuint gTextureId2; // wood
-    GLuint gTextureId3; // glass
-    GLuint gTextureId4; // porcelain
-    GLuint gTextureId5; // detail
+    // Triangle mesh data, one unit mesh per primitive type
+    GLMesh gCylinderMesh;   // radius 1, circles at z 0 and 1
+    GLMesh gTorusMesh;      // ring radius 1 around the Z axis
+    GLMesh gSphereMesh;     // radius 1
+    GLMesh gTableMesh;      // plane
+
+    // Materials, each one samples a layer of the material array
+    enum SceneTexture
+    {
+        TEX_MORTAR,     // mortar (2)
+        TEX_WOOD,       // wood
+        TEX_GLASS,      // glass
+        TEX_PORCELAIN,  // porcelain
+        TEX_DETAIL,     // detail
+        TEX_COUNT
+    };
+
+    // Every scene image is resampled to one size and stored as a layer of a single GL_TEXTURE_2D_ARRAY.
+    // All meshes draw with the same texture and sampler bound, only the material uniform changes.
+    const int MATERIAL_LAYER_SIZE = 512;
+    GLuint gMaterialArray = 0;
+    GLuint gMaterialSampler = 0;
+    bool gLinearFiltering = false;  // toggled with F, nearest filtering otherwise
+
+    // Layer of each material and its wrap mode (0 mirrored repeat, 1 clamp to edge), applied in the fragment shader
+    struct Material
+    {
+        int layer;
+        int wrap;
+    };
+    Material gMaterials[TEX_COUNT];
+
+    // Mip streaming (--stream-textures): only the small levels are loaded up front, finer levels follow
+    // the screen size of the meshes using each material, within a GPU memory budget (--texture-budget-kb)
+    TextureStreamer gTextureStreamer;
+    bool gStreamTextures = false;
+    size_t gTextureBudget = 4096 * 1024;
+
+    // Scene texture files, the wrap type ('m' mirrored repeat, 'c' clamp to edge) and the material using them
+    struct TextureRequest
+    {
+        const char* filename;
+        char wrapType;
+        SceneTexture slot;
+    };
+    const TextureRequest gTextureRequests[] = {
+        { "mortar.jpg",    'm', TEX_MORTAR },
+        { "wood.jpg",      'm', TEX_WOOD },
+        { "glass.jpg",     'm', TEX_GLASS },
+        { "porcelain.jpg", 'm', TEX_PORCELAIN },
+        { "wood.jpg",      'c', TEX_DETAIL }
+    };
+    const int gNumTextureRequests = sizeof(gTextureRequests) / sizeof(gTextureRequests[0]);
+
+    // Texture memory actually allocated against what the same levels would take as RGBA8
+    size_t gTextureBytes = 0;
+    size_t gTextureBytesUncompressed = 0;
+
+    // GPU time spent on the scene draw calls, measured with timer queries one frame behind
+    struct GpuTimer
+    {
+        GLuint queries[2];
+        int frame = 0;
+        double totalMs = 0.0;
+        unsigned int samples = 0;
+    };
+    GpuTimer gSceneTimer;
+
+    // Each image is decoded and uploaded once, into its own layer of the material array.
+    // Layers are found by path first, then by a hash of the file contents, so copies of an image
+    // under another name share a layer too.
+    struct TextureCache
+    {
+        map<string, int> byPath;
+        map<unsigned long long, int> byContent;
+        vector<string> layerFiles;      // image stored in each layer
+        unsigned int loads = 0;         // layers decoded and uploaded
+        unsigned int hits = 0;          // lookups served by path without touching the image file
+        unsigned int contentHits = 0;   // new paths whose contents already have a layer
+        unsigned int failures = 0;      // lookups whose image could not be read
+    };
+    TextureCache gTextureCache;
+
+    // Places the unit cylinder where DrawCylinder(cx, cy, z, r, length) puts its circles
+    glm::mat4 UCylinderTransform(float cx, float cy, float z, float r, float length)
+    {
+        return glm::translate(glm::vec3(cx, cy, z)) * glm::scale(glm::vec3(r, r, length - z));
+    }
+
+    // Every object of the scene is an instance of a unit mesh with its own transform, material and level of
+    // detail. Instances of the same mesh and level are drawn together.
+    struct SceneDraw
+    {
+        GLMesh* mesh;
+        SceneTexture material;
+        glm::mat4 transform;    // mesh space to model space
+        int lod;                // selected level, drawn from mesh->lods[lod].range
+    };
+    SceneDraw gSceneDraws[] = {
+        { &gCylinderMesh, TEX_MORTAR, UCylinderTransform(-2.0f, -2.0f, 0.5f, 1.5f, 2.00f), 0 },        // bowl
+        { &gCylinderMesh, TEX_MORTAR, UCylinderTransform(-2.0f, -2.0f, 0.0f, 1.0f, 1.5f), 0 },         // bowl base
+        { &gCylinderMesh, TEX_PORCELAIN, UCylinderTransform(-0.5f, -3.4f, 0.0f, 0.5f, 0.5f), 0 },      // ramekin
+        { &gTorusMesh, TEX_GLASS, glm::translate(glm::vec3(0.75f, -1.90f, 3.20f)) * glm::scale(glm::vec3(0.5f)), 0 }, // vase mouth
+        { &gCylinderMesh, TEX_GLASS, UCylinderTransform(.75f, -1.90f, 2.0f, 0.45f, 3.2f), 0 },         // vase stem
+        { &gSphereMesh, TEX_GLASS, glm::translate(glm::vec3(0.7f, -2.0f, 1.2f)) * glm::scale(glm::vec3(1.20f)), 0 }, // vase base
+        { &gTableMesh, TEX_WOOD, glm::mat4(1.0f), 0 },                                                   // table
+        { &gCylinderMesh, TEX_DETAIL, UCylinderTransform(-.5f, -3.4f, .501f, 0.41f, 0.0f), 0 }         // ramekin lip
+    };
+    const int gNumSceneDraws = sizeof(gSceneDraws) / sizeof(gSceneDraws[0]);
 
     glm::vec2 gUVScale(5.0f, 5.0f);
     GLint gTexWrapMode = GL_REPEAT;
 
+    // Instances of the visible draws, grouped by mesh and level. The multi-draw indirect path submits them in
+    // one glMultiDrawElementsIndirect call, reading model matrices and materials from a storage buffer; otherwise
+    // every mesh and level is one instanced draw reading them as vertex attributes. Toggled with M when supported.
+    IndirectDrawList gIndirectDraws;
+    bool gIndirectDrawsAvailable = false;
+    bool gUseIndirectDraws = false;
+
+    // Per-frame data (draw records, commands) is sub-allocated from a persistently mapped ring of
+    // STREAM_BUFFER_REGIONS regions, --no-stream-buffer respecifies buffers every frame instead
+    StreamBuffer gFrameStream;
+    const size_t FRAME_STREAM_REGION_BYTES = 1024 * 1024;
+
+    // Store positions as normalized shorts inside the scene bounds (16-byte vertices), --float-positions keeps floats
+    bool gQuantizePositions = true;
+
+    // Reorder generated meshes for the post-transform cache, overdraw and vertex fetch, --no-mesh-optimize skips it
+    bool gOptimizeMeshes = true;
+
+    // Generated meshes are written to .slmesh files and mapped from them on later launches, --no-mesh-cache skips it
+    bool gUseMeshCache = true;
+
+    // Generators of the pool meshes, the names are part of the mesh cache keys
+    enum ShapeGenerator
+    {
+        SHAPE_CYLINDER,
+        SHAPE_TORUS,
+        SHAPE_SPHERE,
+        SHAPE_TABLE         // literal data, neither generated nor cached
+    };
+    const char* const SHAPE_NAMES[] = { "cylinder", "torus", "sphere", "table" };
+
+    // A mesh level on its way into the pool, in the pool's input layout; params are its generator's arguments.
+    // Generated shapes fill vertices and indices, shapes found in the mesh cache read from the mapped file.
+    struct PoolShape
+    {
+        PoolShape(ShapeGenerator generator, GLMesh* mesh, int lod, float error) : generator(generator), mesh(mesh), lod(lod), error(error) {}
+
+        const PoolVertex* getVertices() const   { return cached ? cached->getVertices() : vertices.data(); }
+        size_t getVertexCount() const           { return cached ? cached->getVertexCount() : vertices.size(); }
+        const GLuint* getIndices() const        { return cached ? cached->getIndices() : indices.data(); }
+        size_t getIndexCount() const            { return cached ? cached->getIndexCount() : indices.size(); }
+
+        ShapeGenerator generator;
+        GLMesh* mesh;
+        int lod;
+        float error;
+        vector<float> params;
+        const CachedMesh* cached = nullptr;
+        vector<PoolVertex> vertices;
+        vector<GLuint> indices;
+    };
+
+    // Level of detail: each mesh draws its coarsest level whose error covers at most gLodPixelError pixels.
+    // A coarser level is only taken once its error is below LOD_HYSTERESIS of that, so meshes near the
+    // limit don't pop back and forth. L toggles, --no-lod starts with the finest levels.
+    bool gUseLods = true;
+    float gLodPixelError = 1.0f;
+    const float LOD_HYSTERESIS = 0.7f;
+
+    // Tessellation path: cylinders, torus and sphere are patches with their analytic parameters and no
+    // triangles are generated for them on the CPU. The levels follow the camera distance and --lod-error.
+    TessellatedShapes gTessShapes;
+    bool gUseTessellation = false;
+
+    // Triangles submitted by the scene draws, reported at exit
+    struct TriangleStats
+    {
+        unsigned long long total = 0;
+        size_t peak = 0;
+        unsigned int frames = 0;
+        unsigned int lodSwitches = 0;
+    };
+    TriangleStats gTriangleStats;
+
     // Shader programs
     GLuint gProgramId;
+    GLuint gIndirectProgramId = 0;  // same shading, per-draw data from the draw records
+    GLuint gTessProgramId = 0;      // same shading, surfaces evaluated by the tessellation shaders
     GLuint gLampProgramId;  // LAMP ONE
     GLuint gLampProgramId2; // LAMP TWO
     GLuint gLampProgramId3; // LAMP THREE
@@ -79,9 +304,6 @@ namespace
     float gLastFrame = 0.0f;
     float modifier = 0.002f; // variable for spinning
 
-    // Object Color
-    glm::vec3 gObjectColor(1.f,1.0f, 1.0f);
-
     // Light Positions
     glm::vec3 gLightPosition(0.0f,0.0f,4.0f); // ambien
     glm::vec3 gLightPosition2(2.0f,1.0f,-4.0f); // diffuse
@@ -92,6 +314,43 @@ namespace
     glm::vec3 gLightColor2(0.7f,0.0f,0.0f);
     glm::vec3 gLightColor3(1.0f,1.0f,1.0f);
 
+    // Camera, lights, texture scale and position dequantization shared by every scene shader, written once
+    // per frame into the current region of gFrameStream (or gFrameUniformBuffer without one) and bound to
+    // the FrameData block. std140: vec3s are padded to vec4.
+    struct FrameUniforms
+    {
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::vec4 viewPosition;
+        glm::vec4 lightColors[3];       // ambient, diffuse and specular lamps
+        glm::vec4 lightPositions[3];
+        glm::vec4 positionScale;
+        glm::vec4 positionOffset;
+        glm::vec4 uvScale;              // xy
+    };
+    const GLuint FRAME_UNIFORM_BINDING = 0;
+    GLuint gFrameUniformBuffer = 0;
+    GLint gFrameUniformAlignment = 256;
+
+    // The tessellation program's uniforms outside the block, looked up once after linking
+    struct TessUniforms
+    {
+        GLint model = -1;
+        GLint material = -1;
+        GLint viewportHeight = -1;
+        GLint maxPixelError = -1;
+    };
+    TessUniforms gTessUniforms;
+
+    // GL calls made by the frames, reported at exit
+    struct GLCallStats
+    {
+        unsigned long long total = 0;
+        unsigned long long peak = 0;
+        unsigned int frames = 0;
+    };
+    GLCallStats gGLCallStats;
+
 }
 
 /* User-defined Function prototypes to:
@@ -104,36 +363,311 @@ void UResizeWindow(GLFWwindow* window, int width, int height);
 void UProcessInput(GLFWwindow* window);
 void UMousePositionCallback(GLFWwindow* window, double xpos, double ypos);
 void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset);
-void UCreateMesh(GLMesh& mesh, GLMesh& mesh2, GLMesh& mesh3, GLMesh& mesh4, GLMesh& mesh5, GLMesh& mesh6, GLMesh& mesh7, GLMesh& mesh8);
-void UDestroyMesh(GLMesh& mesh, GLMesh& mesh2, GLMesh& mesh3, GLMesh& mesh4, GLMesh& mesh5, GLMesh& mesh6, GLMesh& mesh7, GLMesh& mesh8);
-bool UCreateTexture(const char* filename, GLuint& textureId, char wrapType);
-void UDestroyTexture(GLuint textureId);
+void UCreateMesh(GLMesh& cylinder, GLMesh& torus, GLMesh& sphere, GLMesh& table);
+void UDestroyMesh(GLMesh& cylinder, GLMesh& torus, GLMesh& sphere, GLMesh& table);
+vector<PoolVertex> UPoolVertices(const GLfloat* source, size_t vertexCount, int floatsPerVertex, int normalOffset, int uvOffset);
+void UGenerateShape(PoolShape& shape, ScratchArena& scratch);
+unsigned long long UShapeCacheKey(const PoolShape& shape);
+void UAddPoolMesh(const PoolShape& shape);
+void UComputeMeshBounds(GLMesh& mesh, const PoolVertex* vertices, size_t vertexCount);
+void UAddTessellatedMesh(GLMesh& mesh, const PatchRange& patches);
+GLuint UCreateArrayTexture(GLenum internalFormat, int levels, int layers, const char* label);
+bool UUploadMaterialLayer(const DecodedImage& image, GLuint arrayId, int layer);
+bool UCookedInternalFormat(const CookedTextureHeader& header, const char* cookedFile, GLenum& internalFormat);
+void UUploadCookedMaterialLayer(const CookedTexture& cooked, GLenum internalFormat, GLuint arrayId, int layer);
+void UCreateMaterialSampler();
+void USetSamplerFiltering(bool linear);
+void UBindMaterials();
+void USetMaterial(SceneTexture material, GLint location);
+bool UHashFile(const char* filename, unsigned long long& hash);
+int UGetMaterialLayer(const char* filename);
+bool ULoadTextures();
+int UWantedTextureLevel(const GLMesh& mesh, const glm::mat4& modelView, const glm::mat4& projection, int viewportHeight);
+void UStreamTextures(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection);
+float UPixelsPerUnit(const GLMesh& mesh, const glm::mat4& modelView, const glm::mat4& projection, int viewportHeight);
+void USelectLods(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection);
+void UDestroyTextureCache();
+vector<string> USceneTextureFiles();
+bool UCookTextures(CookedTextureFormat format);
+void UBenchmarkTextureLoading();
+bool UHasArgument(int argc, char* argv[], const char* flag);
+const char* UArgumentValue(int argc, char* argv[], const char* flag);
+void UCreateGpuTimer(GpuTimer& timer);
+void UBeginGpuTimer(GpuTimer& timer);
+void UEndGpuTimer(GpuTimer& timer);
+void UDestroyGpuTimer(GpuTimer& timer);
 void URender2D();
 void URender3D();
-bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId);
+int UResidentMipLevel(int layer);
+bool USphereInFrustum(const glm::mat4& modelViewProjection, const glm::vec3& center, float radius);
+void UCreateFrameUniforms();
+void UWriteFrameUniforms(const glm::mat4& view, const glm::mat4& projection);
+void ULegacySceneUniforms(GLuint programId, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection);
+void UBenchmarkFrameUniforms();
+void URecordFrameCalls(unsigned long long firstCall);
+void UDrawScene(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection);
+GLuint USceneProgram();
+size_t UDrawTessellatedScene(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection);
+void UBenchmarkDrawSubmission();
+void UBenchmarkMeshRebuild();
+void UBenchmarkMeshCache();
+bool UCompileShader(GLenum type, const char* source, const char* stageName, GLuint& shaderId);
+bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId,
+                          const char* tessControlSource = nullptr, const char* tessEvaluationSource = nullptr);
 void UDestroyShaderProgram(GLuint programId);
 
-/* Vertex Shader Source Code*/
+/* Vertex Shader Source Code, model matrix and material come per instance*/
 const GLchar* vertexShaderSource = GLSL(440,
     layout(location = 0) in vec3 position; // (location 1 omitted b/c vert color not used)
     layout(location = 1) in vec3 normal; // VAP position 1 for normals
     layout(location = 2) in vec2 textureCoordinate;
+    layout(location = 3) in mat4 model; // locations 3-6, matches DrawRecord in IndirectDraws.h
+    layout(location = 7) in ivec4 material;
 
     out vec3 vertexNormal; // For outgoing normals to fragment shader
     out vec3 vertexFragmentPos; // For outgoing color / pixels to fragment shader
     out vec2 vertexTextureCoordinate;
+    flat out ivec3 vertexMaterial; // layer, wrap, finest resident mip level
 
-    //Global variables for the  transform matrices
-    uniform mat4 model;
-    uniform mat4 view;
-    uniform mat4 projection;
+    // Per-frame state shared by the scene shaders, matches FrameUniforms. Positions may be stored
+    // quantized inside the geometry pool bounds, positionScale and positionOffset restore them.
+    layout(std140, binding = 0) uniform FrameData
+    {
+        mat4 view;
+        mat4 projection;
+        vec4 viewPosition;
+        vec4 lightColors[3];
+        vec4 lightPositions[3];
+        vec4 positionScale;
+        vec4 positionOffset;
+        vec4 uvScale;
+    };
 
     void main()
     {
-        gl_Position = projection * view * model * vec4(position, 1.0f); // transforms vertices to clip coordinates
-        vertexFragmentPos = vec3(model * vec4(position, 1.0f)); // Gets fragment / pixel position in world space only (exclude view and projection)
+        vec4 localPosition = vec4(positionOffset.xyz + positionScale.xyz * position, 1.0f);
+        gl_Position = projection * view * model * localPosition; // transforms vertices to clip coordinates
+        vertexFragmentPos = vec3(model * localPosition); // Gets fragment / pixel position in world space only (exclude view and projection)
         vertexNormal = mat3(transpose(inverse(model))) * normal; // get normal vectors in world space only and exclude normal translation properties
         vertexTextureCoordinate = textureCoordinate;
+        vertexMaterial = material.xyz;
+    }
+    );
+
+
+/* Vertex Shader Source Code for the multi-draw indirect path, per-instance data comes from the draw records*/
+const GLchar* indirectVertexShaderSource = GLSL_EXTENSION(440, GL_ARB_shader_draw_parameters,
+    layout(location = 0) in vec3 position;
+    layout(location = 1) in vec3 normal;
+    layout(location = 2) in vec2 textureCoordinate;
+
+    out vec3 vertexNormal;
+    out vec3 vertexFragmentPos;
+    out vec2 vertexTextureCoordinate;
+    flat out ivec3 vertexMaterial;
+
+    // matches DrawRecord in IndirectDraws.h
+    struct DrawRecord
+    {
+        mat4 model;
+        ivec4 material;
+    };
+    layout(std430, binding = 0) readonly buffer DrawRecords
+    {
+        DrawRecord draws[];
+    };
+
+    // matches FrameUniforms
+    layout(std140, binding = 0) uniform FrameData
+    {
+        mat4 view;
+        mat4 projection;
+        vec4 viewPosition;
+        vec4 lightColors[3];
+        vec4 lightPositions[3];
+        vec4 positionScale;
+        vec4 positionOffset;
+        vec4 uvScale;
+    };
+
+    void main()
+    {
+        // each command's instances are stored together from its baseInstance on
+        DrawRecord draw = draws[gl_BaseInstanceARB + gl_InstanceID];
+        mat4 model = draw.model;
+        vec4 localPosition = vec4(positionOffset.xyz + positionScale.xyz * position, 1.0f);
+        gl_Position = projection * view * model * localPosition;
+        vertexFragmentPos = vec3(model * localPosition);
+        vertexNormal = mat3(transpose(inverse(model))) * normal;
+        vertexTextureCoordinate = textureCoordinate;
+        vertexMaterial = draw.material.xyz;
+    }
+    );
+
+
+/* Shaders for the tessellation path, one control point per patch carries the primitive's parameters*/
+const GLchar* tessVertexShaderSource = GLSL(440,
+    layout(location = 0) in vec4 origin;
+    layout(location = 1) in vec4 shape;
+    layout(location = 2) in vec4 range;
+    layout(location = 3) in vec4 detail;
+    layout(location = 4) in int kind;
+
+    out vec4 controlOrigin;
+    out vec4 controlShape;
+    out vec4 controlRange;
+    out vec4 controlDetail;
+    flat out int controlKind;
+
+    void main()
+    {
+        controlOrigin = origin;
+        controlShape = shape;
+        controlRange = range;
+        controlDetail = detail;
+        controlKind = kind;
+    }
+    );
+
+
+/* Tessellation control: levels from the primitive's distance, the same for all its patches so the edges match*/
+const GLchar* tessControlShaderSource = GLSL(440,
+    layout(vertices = 1) out;
+
+    in vec4 controlOrigin[];
+    in vec4 controlShape[];
+    in vec4 controlRange[];
+    in vec4 controlDetail[];
+    flat in int controlKind[];
+
+    patch out vec4 patchOrigin;
+    patch out vec4 patchShape;
+    patch out vec4 patchRange;
+    patch out int patchKind;
+
+    // matches FrameUniforms
+    layout(std140, binding = 0) uniform FrameData
+    {
+        mat4 view;
+        mat4 projection;
+        vec4 viewPosition;
+        vec4 lightColors[3];
+        vec4 lightPositions[3];
+        vec4 positionScale;
+        vec4 positionOffset;
+        vec4 uvScale;
+    };
+    uniform mat4 model;
+    uniform float viewportHeight;
+    uniform float maxPixelError;
+
+    // segments an arc of this radius needs over the given turns for its chord error to stay under maxPixelError,
+    // UTessSegments repeats it on the CPU for the triangle statistics
+    float segments(float radius, float turns, float pixelsPerUnit)
+    {
+        if (radius <= 0.0f || turns <= 0.0f)
+            return 1.0f;
+        float pixels = radius * pixelsPerUnit;
+        return clamp(ceil(3.14159265f * sqrt(pixels / (2.0f * maxPixelError)) * turns), 1.0f, 64.0f);
+    }
+
+    void main()
+    {
+        patchOrigin = controlOrigin[0];
+        patchShape = controlShape[0];
+        patchRange = controlRange[0];
+        patchKind = controlKind[0];
+
+        // perspective projections divide by the view depth, orthographic ones keep w = 1
+        vec4 eye = view * model * vec4(controlOrigin[0].xyz, 1.0f);
+        float w = projection[2][3] != 0.0f ? max(-eye.z, 0.01f) : 1.0f;
+        float pixelsPerUnit = length(vec3(model[0])) * projection[1][1] * viewportHeight * 0.5f / w;
+
+        float levelU = segments(controlDetail[0].x, controlDetail[0].y, pixelsPerUnit);
+        float levelV = segments(controlDetail[0].z, controlDetail[0].w, pixelsPerUnit);
+        gl_TessLevelOuter[0] = levelV;  // u = 0 edge
+        gl_TessLevelOuter[1] = levelU;  // v = 0 edge
+        gl_TessLevelOuter[2] = levelV;  // u = 1 edge
+        gl_TessLevelOuter[3] = levelU;  // v = 1 edge
+        gl_TessLevelInner[0] = levelU;
+        gl_TessLevelInner[1] = levelV;
+    }
+    );
+
+
+/* Tessellation evaluation: places each generated vertex on the analytic surface, matching the CPU generators*/
+const GLchar* tessEvaluationShaderSource = GLSL(440,
+    layout(quads, equal_spacing, ccw) in;
+
+    patch in vec4 patchOrigin;
+    patch in vec4 patchShape;
+    patch in vec4 patchRange;
+    patch in int patchKind;
+
+    out vec3 vertexNormal;
+    out vec3 vertexFragmentPos;
+    out vec2 vertexTextureCoordinate;
+    flat out ivec3 vertexMaterial;
+
+    // matches FrameUniforms
+    layout(std140, binding = 0) uniform FrameData
+    {
+        mat4 view;
+        mat4 projection;
+        vec4 viewPosition;
+        vec4 lightColors[3];
+        vec4 lightPositions[3];
+        vec4 positionScale;
+        vec4 positionOffset;
+        vec4 uvScale;
+    };
+    uniform mat4 model;
+    uniform ivec3 uMaterial;
+
+    void main()
+    {
+        float u = mix(patchRange.x, patchRange.y, gl_TessCoord.x);  // turns around the axis
+        float v = mix(patchRange.z, patchRange.w, gl_TessCoord.y);
+        float theta = 6.28318531f * u;
+        vec2 around = vec2(cos(theta), sin(theta));
+
+        vec3 position;
+        vec3 normal;
+        vec2 uv;
+        if (patchKind == 0)         // cylinder side, from z0 to z1
+        {
+            position = vec3(patchOrigin.xy + patchShape.x * around, mix(patchShape.y, patchShape.z, v));
+            normal = vec3(around, 0.0f);
+            uv = around * 0.5f + 0.5f;
+        }
+        else if (patchKind == 1)    // cylinder cap, v runs from the centre to the rim
+        {
+            position = vec3(patchOrigin.xy + patchShape.x * v * around, patchShape.y);
+            normal = vec3(0.0f, 0.0f, patchShape.z);
+            uv = v * around * 0.5f + 0.5f;
+        }
+        else if (patchKind == 2)    // torus, v runs around the tube
+        {
+            float phi = 6.28318531f * v;
+            vec3 tube = vec3(around * cos(phi), sin(phi));
+            position = patchOrigin.xyz + vec3(patchShape.y * around, 0.0f) + patchShape.x * tube;
+            normal = tube;
+            uv = vec2(u, v);
+        }
+        else                        // sphere, v runs from the +Z pole to the -Z pole
+        {
+            float phi = 3.14159265f * (0.5f - v);
+            normal = vec3(around * cos(phi), sin(phi));
+            position = patchOrigin.xyz + patchShape.x * normal;
+            uv = vec2(u, v);
+        }
+
+        vec4 localPosition = vec4(position, 1.0f);
+        gl_Position = projection * view * model * localPosition;
+        vertexFragmentPos = vec3(model * localPosition);
+        vertexNormal = mat3(transpose(inverse(model))) * normal;
+        vertexTextureCoordinate = uv;
+        vertexMaterial = uMaterial;
     }
     );
 
@@ -144,53 +678,60 @@ const GLchar* fragmentShaderSource = GLSL(440,
     in vec3 vertexNormal; // For incoming normals
     in vec3 vertexFragmentPos; // For incoming fragment position
     in vec2 vertexTextureCoordinate;
+    flat in ivec3 vertexMaterial; // layer, wrap (0 mirrored repeat, 1 clamp to edge), finest resident mip level
 
     out vec4 fragmentColor;
 
-    // Uniform / Global variables for object color, light color, light position, and camera/view position
-    uniform vec3 objectColor;
-    uniform vec3 viewPosition;
-    // LAMP ONE (ambient)
-    uniform vec3 lightColor; 
-    uniform vec3 lightPos; 
-    // LAMP TWO (diffuse)
-    uniform vec3 lightColor2;
-    uniform vec3 lightPos2;
-    // LAMP THREE (spectral)
-    uniform vec3 lightColor3;
-    uniform vec3 lightPos3;
-
-    uniform sampler2D uTexture;
-    uniform vec2 uvScale;
+    // Light colors and positions, camera/view position and texture scale, matches FrameUniforms.
+    // The lamps are LAMP ONE (ambient), LAMP TWO (diffuse) and LAMP THREE (spectral).
+    layout(std140, binding = 0) uniform FrameData
+    {
+        mat4 view;
+        mat4 projection;
+        vec4 viewPosition;
+        vec4 lightColors[3];
+        vec4 lightPositions[3];
+        vec4 positionScale;
+        vec4 positionOffset;
+        vec4 uvScale;
+    };
+
+    uniform sampler2DArray uMaterials; // every scene image, one per layer
 
     void main() /*Phong lighting model calculations to generate ambient, diffuse, and specular components*/
     {
         // LAMP ONE 
         //Calculate Ambient lighting
         float ambientStrength =.30f; // Set ambient or global lighting strength
-        vec3 ambient = ambientStrength * lightColor; // Generate ambient light color
-        vec3 lightDirection = normalize(lightPos - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
+        vec3 ambient = ambientStrength * lightColors[0].xyz; // Generate ambient light color
+        vec3 lightDirection = normalize(lightPositions[0].xyz - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
 
         // LAMP TWO
         //Calculate Diffuse lighting
         vec3 norm = normalize(vertexNormal); // Normalize vectors to 1 unit
-        vec3 lightDirection2 = normalize(lightPos2 - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
+        vec3 lightDirection2 = normalize(lightPositions[1].xyz - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
         float impact = max(dot(norm, lightDirection2), 0.0);// Calculate diffuse impact by generating dot product of normal and light
-        vec3 diffuse = impact * lightColor2+ .35; // Generate diffuse light color
+        vec3 diffuse = impact * lightColors[1].xyz+ .35; // Generate diffuse light color
 
         // LAMP THREE
         //Calculate Specular lighting
         float specularIntensity = 0.6f; // Set specular light strength
         float highlightSize = 6.0f; // Set specular highlight size
-        vec3 lightDirection3 = normalize(lightPos3 - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
-        vec3 viewDir = normalize(viewPosition - vertexFragmentPos); // Calculate view direction
+        vec3 lightDirection3 = normalize(lightPositions[2].xyz - vertexFragmentPos); // Calculate distance (light direction) between light source and fragments/pixels on cube
+        vec3 viewDir = normalize(viewPosition.xyz - vertexFragmentPos); // Calculate view direction
         vec3 reflectDir = reflect(-lightDirection3, norm);// Calculate reflection vector
         //Calculate specular component
         float specularComponent = pow(max(dot(viewDir, reflectDir), 0.0), highlightSize);
-        vec3 specular = specularIntensity * specularComponent * lightColor3;
+        vec3 specular = specularIntensity * specularComponent * lightColors[2].xyz;
 
        // Texture holds the color to be used for all three components
-        vec4 textureColor = texture(uTexture, vertexTextureCoordinate * uvScale);
+        // The sampler clamps, mirrored repeat is applied here; the LOD of the unwrapped
+        // coordinates keeps mip selection continuous across the mirror seams.
+        // Levels finer than vertexMaterial.z are not streamed in yet and are never sampled.
+        vec2 uv = vertexTextureCoordinate * uvScale.xy;
+        vec2 wrappedUV = vertexMaterial.y == 0 ? 1.0 - abs(mod(uv, 2.0) - 1.0) : uv;
+        float lod = max(textureQueryLod(uMaterials, uv).y, float(vertexMaterial.z));
+        vec4 textureColor = textureLod(uMaterials, vec3(wrappedUV, vertexMaterial.x), lod);
 
         // Calculate phong result
         vec3 phong = ((ambient+diffuse) + (diffuse) + (specular) )* textureColor.xyz;
@@ -227,38 +768,128 @@ const GLchar* lampFragmentShaderSource = GLSL(440,
     }
     );
 
-    // Images are loaded with Y axis going down, but OpenGL's Y axis goes up, so let's flip it
-    void flipImageVertically(unsigned char* image, int width, int height, int channels)
-    {
-        for (int j = 0; j < height / 2; ++j)
-        {
-            int index1 = j * width * channels;
-            int index2 = (height - 1 - j) * width * channels;
-
-            for (int i = width * channels; i > 0; --i)
-            {
-                unsigned char tmp = image[index1];
-                image[index1] = image[index2];
-                image[index2] = tmp;
-                ++index1;
-                ++index2;
-            }
-        }
-    }
-
 
 int main(int argc, char* argv[])
 {
+    // Offline step: cook the scene textures into .sltex files and exit
+    if (UHasArgument(argc, argv, "--cook"))
+        return UCookTextures(COOKED_FORMAT_RGBA8) ? EXIT_SUCCESS : EXIT_FAILURE;
+    if (UHasArgument(argc, argv, "--cook-bc1"))
+        return UCookTextures(COOKED_FORMAT_BC1) ? EXIT_SUCCESS : EXIT_FAILURE;
+    if (UHasArgument(argc, argv, "--cook-bc7"))
+        return UCookTextures(COOKED_FORMAT_BC7) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    // CPU-only micro-benchmark, no window needed
+    if (UHasArgument(argc, argv, "--bench-preprocess"))
+    {
+        UBenchmarkPreprocess();
+        return EXIT_SUCCESS;
+    }
+    if (UHasArgument(argc, argv, "--bench-decode"))
+    {
+        UBenchmarkImageDecoding(USceneTextureFiles());
+        return EXIT_SUCCESS;
+    }
+    if (UHasArgument(argc, argv, "--bench-decode-threads"))
+    {
+        UInitImageDecoder();
+        UBenchmarkParallelDecoding(USceneTextureFiles());
+        return EXIT_SUCCESS;
+    }
+    if (UHasArgument(argc, argv, "--bench-meshgen"))
+    {
+        UBenchmarkMeshGeneration();
+        UBenchmarkMeshRebuild();
+        return EXIT_SUCCESS;
+    }
+    if (UHasArgument(argc, argv, "--bench-meshcache"))
+    {
+        gOptimizeMeshes = !UHasArgument(argc, argv, "--no-mesh-optimize");
+        UBenchmarkMeshCache();
+        return EXIT_SUCCESS;
+    }
+
     if (!UInitialize(argc, argv, &gWindow))
         return EXIT_FAILURE;
 
+    // The tessellation path needs tessellation shaders, without them the primitives are generated meshes
+    if (UHasArgument(argc, argv, "--tessellate"))
+    {
+        gUseTessellation = UTessellationSupported() && UCreateShaderProgram(tessVertexShaderSource, fragmentShaderSource, gTessProgramId,
+                                                                            tessControlShaderSource, tessEvaluationShaderSource);
+        if (!gUseTessellation)
+            cout << "WARNING: Tessellation shaders unavailable, using generated meshes" << endl;
+        else
+        {
+            gTessUniforms.model = glGetUniformLocation(gTessProgramId, "model");
+            gTessUniforms.material = glGetUniformLocation(gTessProgramId, "uMaterial");
+            gTessUniforms.viewportHeight = glGetUniformLocation(gTessProgramId, "viewportHeight");
+            gTessUniforms.maxPixelError = glGetUniformLocation(gTessProgramId, "maxPixelError");
+        }
+    }
+
     // Create the mesh
-    UCreateMesh(gMesh,gMesh2,gMesh3,gMesh4,gMesh5,gMesh6, gMesh7, gMesh8); // Calls the function to create the Vertex Buffer Object
+    gQuantizePositions = !UHasArgument(argc, argv, "--float-positions");
+    gOptimizeMeshes = !UHasArgument(argc, argv, "--no-mesh-optimize");
+    gUseMeshCache = !UHasArgument(argc, argv, "--no-mesh-cache");
+    gUseLods = !UHasArgument(argc, argv, "--no-lod");
+    if (const char* error = UArgumentValue(argc, argv, "--lod-error"))
+        gLodPixelError = max((float)atof(error), 0.01f);
+    UCreateMesh(gCylinderMesh, gTorusMesh, gSphereMesh, gTableMesh); // Calls the function to create the Vertex Buffer Object
+    if (UStreamBufferSupported() && !UHasArgument(argc, argv, "--no-stream-buffer"))
+        gFrameStream.create(gResources, "per-frame data", FRAME_STREAM_REGION_BYTES);
+    cout << "INFO: Per-frame data: " << (gFrameStream.isCreated() ? "persistently mapped stream buffer" : "buffers respecified every frame") << endl;
+    gIndirectDraws.create(gResources, gGeometry, gFrameStream.isCreated() ? &gFrameStream : nullptr);
+    UCreateFrameUniforms();
 
     // Create the shader program
     if (!UCreateShaderProgram(vertexShaderSource, fragmentShaderSource, gProgramId)) 
         return EXIT_FAILURE;
 
+    // The indirect path reads the records at gl_BaseInstanceARB + gl_InstanceID, so it needs
+    // ARB_shader_draw_parameters and storage buffers; without them every mesh is drawn on its own
+    if (UIndirectDrawsSupported() && UCreateShaderProgram(indirectVertexShaderSource, fragmentShaderSource, gIndirectProgramId))
+    {
+        gIndirectDrawsAvailable = true;
+        gUseIndirectDraws = !UHasArgument(argc, argv, "--no-mdi");
+    }
+    cout << "INFO: Scene submission: " << (gUseIndirectDraws ? "multi-draw indirect" : "one instanced draw per mesh")
+         << (gIndirectDrawsAvailable ? " (M toggles)" : "") << endl;
+    glUseProgram(gProgramId);
+
+    // Pick the decoder kernels before the worker threads start decoding
+    cout << "INFO: Image decoder using " << UImageDecodeKernelsName(UInitImageDecoder()) << " kernels" << endl;
+
+    // Load every scene texture once, the render functions only bind them
+    gStreamTextures = UHasArgument(argc, argv, "--stream-textures");
+    if (const char* budget = UArgumentValue(argc, argv, "--texture-budget-kb"))
+    {
+        // a positive number of KB, nothing after it; strtoul would wrap a minus sign around
+        char* end = nullptr;
+        errno = 0;
+        unsigned long kilobytes = strchr(budget, '-') ? 0 : strtoul(budget, &end, 10);
+        if (end && end != budget && *end == '\0' && errno != ERANGE && kilobytes > 0 && kilobytes <= SIZE_MAX / 1024)
+            gTextureBudget = (size_t)kilobytes * 1024;
+        else
+            cout << "WARNING: Invalid --texture-budget-kb value \"" << budget << "\", using " << gTextureBudget / 1024 << " KB" << endl;
+    }
+    UCreateMaterialSampler();
+    if (!ULoadTextures())
+        return EXIT_FAILURE;
+
+    gResources.report(cout);
+
+    if (UHasArgument(argc, argv, "--bench-textures"))
+        UBenchmarkTextureLoading();
+    if (UHasArgument(argc, argv, "--bench-submission"))
+        UBenchmarkDrawSubmission();
+    if (UHasArgument(argc, argv, "--bench-uniforms"))
+        UBenchmarkFrameUniforms();
+    // the benchmarks' frames are not part of the run reported at exit
+    gFrameStream.resetStats();
+
+    UCreateGpuTimer(gSceneTimer);
+
     // Sets the background color of the window to black (it will be implicitely used by glClear)
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
@@ -281,22 +912,63 @@ int main(int argc, char* argv[])
 
     }
 
+    // Triangles the scene draws submitted with the levels of detail picked each frame
+    if (gTriangleStats.frames)
+        cout << "INFO: Scene draws submitted " << gTriangleStats.total / gTriangleStats.frames << " triangles per frame on average, "
+             << gTriangleStats.peak << " at most, " << gTriangleStats.lodSwitches << " LOD switches (" << gTriangleStats.frames << " frames"
+             << (gUseTessellation ? ", patch triangles estimated from their tessellation levels" : "") << ")" << endl;
+    if (gFrameStream.isCreated())
+        gFrameStream.printStats(cout, "Per-frame data");
+    if (gGLCallStats.frames)
+        cout << "INFO: GL calls per frame: " << gGLCallStats.total / gGLCallStats.frames << " on average, " << gGLCallStats.peak
+             << " at most" << endl;
+
     // Release mesh data
-    UDestroyMesh(gMesh,gMesh2,gMesh3,gMesh4,gMesh5, gMesh6, gMesh7, gMesh8);
+    UDestroyMesh(gCylinderMesh, gTorusMesh, gSphereMesh, gTableMesh);
 
-    // Release texture
-    UDestroyTexture(gTextureId);
-    UDestroyTexture(gTextureId2);
-    UDestroyTexture(gTextureId3);
-    UDestroyTexture(gTextureId4);
-    UDestroyTexture(gTextureId5);
+    // Release textures
+    UDestroyTextureCache();
+    UDestroyGpuTimer(gSceneTimer);
 
     // Release shader program
     UDestroyShaderProgram(gProgramId);
+    UDestroyShaderProgram(gIndirectProgramId);
+    UDestroyShaderProgram(gTessProgramId);
+    gIndirectDraws.destroy(gResources);
+    gFrameStream.destroy(gResources);
+    gResources.destroy(GL_RESOURCE_BUFFER, gFrameUniformBuffer);
+
+    // Anything still alive at this point was never released, report it and free it
+    gResources.reportLeaks(cout);
+    gResources.destroyAll();
 
     exit(EXIT_SUCCESS); // Terminates the program successfully
 }
 
+// Returns true if flag was passed on the command line
+bool UHasArgument(int argc, char* argv[], const char* flag)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (string(argv[i]) == flag)
+            return true;
+    }
+    return false;
+}
+
+
+// Returns the argument following flag on the command line, nullptr if there is none
+const char* UArgumentValue(int argc, char* argv[], const char* flag)
+{
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (string(argv[i]) == flag)
+            return argv[i + 1];
+    }
+    return nullptr;
+}
+
+
 // Initialize GLFW, GLEW, and create a window
 bool UInitialize(int argc, char* argv[], GLFWwindow** window)
 {
@@ -339,6 +1011,7 @@ bool UInitialize(int argc, char* argv[], GLFWwindow** window)
         std::cerr << glewGetErrorString(GlewInitResult) << std::endl;
         return false;
     }
+    UInstallGLCallCounters();  // before any other GL call, so the frames' counts are complete
 
     // Displays GPU OpenGL version
     cout << "INFO: OpenGL Version: " << glGetString(GL_VERSION) << endl;
@@ -369,6 +1042,27 @@ void UProcessInput(GLFWwindow* window)
         gCamera.ProcessKeyboard(DOWN, gDeltaTime);
     if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS)
         Is3D = !Is3D;
+
+    // F switches nearest / trilinear filtering on the shared samplers, no texture is touched
+    static bool filterKeyDown = false;
+    bool filterKey = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+    if (filterKey && !filterKeyDown)
+        USetSamplerFiltering(!gLinearFiltering);
+    filterKeyDown = filterKey;
+
+    // M switches between multi-draw indirect and one instanced draw per mesh
+    static bool submitKeyDown = false;
+    bool submitKey = glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS;
+    if (submitKey && !submitKeyDown && gIndirectDrawsAvailable)
+        gUseIndirectDraws = !gUseIndirectDraws;
+    submitKeyDown = submitKey;
+
+    // L switches level of detail selection on and off, off draws the finest levels
+    static bool lodKeyDown = false;
+    bool lodKey = glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS;
+    if (lodKey && !lodKeyDown)
+        gUseLods = !gUseLods;
+    lodKeyDown = lodKey;
     if (Is3D) {
 
         URender3D();
@@ -419,6 +1113,8 @@ void UMouseScrollCallback(GLFWwindow* window, double xoffset, double yoffset)
 // Functioned called to render a frame
 void URender2D()
 {
+    unsigned long long firstCall = UGLCallCount();
+
     // Enable z-depth
     glEnable(GL_DEPTH_TEST);
 
@@ -439,114 +1135,26 @@ void URender2D()
     // Creates a perspective projection
     glm::mat4 orthoProjection = glm::ortho(-2.0f, 2.0f, -2.0f, 2.0f, 0.1f, 100.0f);
 
-    // Set the shader to be used
-    glUseProgram(gProgramId);
-
-    // Retrieves and passes transform matrices to the Shader program
-    GLint modelLoc = glGetUniformLocation(gProgramId, "model");
-    GLint viewLoc = glGetUniformLocation(gProgramId, "view");
-    GLint projLoc = glGetUniformLocation(gProgramId, "projection");
-
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(orthoProjection));
-
-    // Reference matrix uniforms from the Cube Shader program for the cub color, light color, light position, and camera position 
-    // LAMP ONE
-    GLint objectColorLoc = glGetUniformLocation(gProgramId, "objectColor");
-    GLint lightColorLoc = glGetUniformLocation(gProgramId, "lightColor");
-    GLint lightPositionLoc = glGetUniformLocation(gProgramId, "lightPos");
-    // LAMP TWO
-    GLint lightColorLoc2 = glGetUniformLocation(gProgramId, "lightColor2");
-    GLint lightPositionLoc2 = glGetUniformLocation(gProgramId, "lightPos2");
-    // LAMP THREE
-    GLint objectColorLoc2 = glGetUniformLocation(gProgramId, "objectColor");
-    GLint lightColorLoc3 = glGetUniformLocation(gProgramId, "lightColor3");
-    GLint lightPositionLoc3 = glGetUniformLocation(gProgramId, "lightPos3");
-    GLint viewPositionLoc = glGetUniformLocation(gProgramId, "viewPosition");
-
-    // Pass color, light, and camera data to the Cube Shader program's corresponding uniforms
-    // LAMP ONE
-    glUniform3f(objectColorLoc, gObjectColor.r, gObjectColor.g, gObjectColor.b);
-    glUniform3f(lightColorLoc, gLightColor.r, gLightColor.g, gLightColor.b);
-    glUniform3f(lightPositionLoc, gLightPosition.x, gLightPosition.y, gLightPosition.z);
-    // LAMP TWO
-    glUniform3f(lightColorLoc2, gLightColor2.r, gLightColor2.g, gLightColor2.b);
-    glUniform3f(lightPositionLoc2, gLightPosition2.x, gLightPosition2.y, gLightPosition2.z);
-    // LAMP THREE
-    glUniform3f(lightColorLoc3, gLightColor3.r, gLightColor3.g, gLightColor3.b);
-    glUniform3f(lightPositionLoc3, gLightPosition3.x, gLightPosition3.y, gLightPosition3.z);
-
-    const glm::vec3 cameraPosition = gCamera.Position;
-    glUniform3f(viewPositionLoc, cameraPosition.x, cameraPosition.y, cameraPosition.z);
-
-    GLint UVScaleLoc = glGetUniformLocation(gProgramId, "uvScale");
-    glUniform2fv(UVScaleLoc, 1, glm::value_ptr(gUVScale));
-
-    glUseProgram(gProgramId);
-
-    // chars to specify which type of texture wrap to use in UCreateTexture
-    char mirroredRepeat = 'm';
-    char clampToEdge= 'c';
-
-    // Load texture files
-    const char* texFileName = "mortar.jpg";
-    const char* texFileName2 = "wood.jpg";
-    const char* texFileName3 = "glass.jpg";
-    const char* texFileName4 = "porcelain.jpg";
+    // Set the shader to be used, the indirect one reads model matrices and materials from the draw records
+    glUseProgram(USceneProgram());
 
-    // call UCreateTexture to set textures
-    UCreateTexture(texFileName,  gTextureId,  mirroredRepeat);
-    UCreateTexture(texFileName2, gTextureId2, mirroredRepeat);
-    UCreateTexture(texFileName3, gTextureId3, mirroredRepeat);
-    UCreateTexture(texFileName4, gTextureId4, mirroredRepeat);
-    UCreateTexture(texFileName2, gTextureId5, clampToEdge);
+    // View, projection, lights, camera and texture scale for every scene program, one write per frame
+    gFrameStream.beginFrame();
+    UWriteFrameUniforms(view, orthoProjection);
 
+    // pick the levels of detail and stream in the texture detail this view needs before the draws
+    USelectLods(model, view, orthoProjection);
+    UStreamTextures(model, view, orthoProjection);
 
     // BIND VERTEX ARRAYS & ACTIVATE AND BIND EACH TEXTURES TO DRAW EACH SHAPE
-    // gMesh
-    glBindVertexArray(gMesh.vao); // Activate the VBOs
-    glActiveTexture(GL_TEXTURE0);    // bind texture
-    glBindTexture(GL_TEXTURE_2D, gTextureId);
-    glDrawElements(GL_TRIANGLES, gMesh.nIndices, GL_UNSIGNED_SHORT, NULL);    // Draws the triangles for the bowl
-
-    // gMesh2 
-    glBindVertexArray(gMesh2.vao); // Activate the VBOS
-    glBindTexture(GL_TEXTURE_2D, gTextureId);
-    glDrawElements(GL_TRIANGLES, gMesh2.nIndices, GL_UNSIGNED_SHORT, NULL);    // Draws the triangles for the bowl base
-
-    // gMesh3
-    glBindVertexArray(gMesh3.vao); // Activate VBOS
-    glBindTexture(GL_TEXTURE_2D, gTextureId4);
-    glDrawElements(GL_TRIANGLES, gMesh3.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle for the ramekin
-
-    // gMesh4
-    glBindVertexArray(gMesh4.vao); // Activate VBOS
-    glBindTexture(GL_TEXTURE_2D, gTextureId3);
-    glDrawElements(GL_TRIANGLES, gMesh4.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle for the vase mouth
-
-    // gMesh5
-    glBindVertexArray(gMesh5.vao); // Activate VBOS
-    glBindTexture(GL_TEXTURE_2D, gTextureId3);
-    glDrawElements(GL_TRIANGLES, gMesh5.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle for the vase stem
-
-    // gMesh6
-    glBindVertexArray(gMesh6.vao); // Activate VBOS
-    glBindTexture(GL_TEXTURE_2D, gTextureId3);
-    glDrawElements(GL_TRIANGLES, gMesh6.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle for the vase base
-
-    // gMesh7
-    glBindVertexArray(gMesh7.vao); // Activate VBOS
-    glBindTexture(GL_TEXTURE_2D, gTextureId2);
-    glDrawElements(GL_TRIANGLES, gMesh7.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle for the table
-
-    // gMesh8
-    glBindVertexArray(gMesh8.vao); // Activate VBOS
-    glBindTexture(GL_TEXTURE_2D, gTextureId5);
-    glDrawElements(GL_TRIANGLES, gMesh8.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle for ramekin detail
+    UBeginGpuTimer(gSceneTimer);
+    UDrawScene(model, view, orthoProjection);
+    UEndGpuTimer(gSceneTimer);
+    gFrameStream.endFrame();
 
     // Deactivate the Vertex Array Object
     glBindVertexArray(0);
+    URecordFrameCalls(firstCall);
 
     // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
     glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
@@ -558,6 +1166,8 @@ void URender2D()
 // Functioned called to render a frame
 void URender3D()
 {
+    unsigned long long firstCall = UGLCallCount();
+
     // Enable z-depth
     glEnable(GL_DEPTH_TEST);
 
@@ -578,326 +1188,481 @@ void URender3D()
     // Creates a perspective projection
     glm::mat4 projection = glm::perspective(glm::radians(gCamera.Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
 
-    // Set the shader to be used
-    glUseProgram(gProgramId);
-
-    // Retrieves and passes transform matrices to the Shader program
-    GLint modelLoc = glGetUniformLocation(gProgramId, "model");
-    GLint viewLoc = glGetUniformLocation(gProgramId, "view");
-    GLint projLoc = glGetUniformLocation(gProgramId, "projection");
-
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
-
-    // Reference matrix uniforms from the Cube Shader program for the cub color, light color, light position, and camera position 
-    // LAMP ONE
-    GLint objectColorLoc = glGetUniformLocation(gProgramId, "objectColor");
-    GLint lightColorLoc = glGetUniformLocation(gProgramId, "lightColor");
-    GLint lightPositionLoc = glGetUniformLocation(gProgramId, "lightPos");
-    // LAMP TWO
-    GLint lightColorLoc2 = glGetUniformLocation(gProgramId, "lightColor2");
-    GLint lightPositionLoc2 = glGetUniformLocation(gProgramId, "lightPos2");
-    // LAMP THREE
-    GLint objectColorLoc2 = glGetUniformLocation(gProgramId, "objectColor");
-    GLint lightColorLoc3 = glGetUniformLocation(gProgramId, "lightColor3");
-    GLint lightPositionLoc3 = glGetUniformLocation(gProgramId, "lightPos3");
-    GLint viewPositionLoc = glGetUniformLocation(gProgramId, "viewPosition");
-
-    // Pass color, light, and camera data to the Cube Shader program's corresponding uniforms
-    // LAMP ONE
-    glUniform3f(objectColorLoc, gObjectColor.r, gObjectColor.g, gObjectColor.b);
-    glUniform3f(lightColorLoc, gLightColor.r, gLightColor.g, gLightColor.b);
-    glUniform3f(lightPositionLoc, gLightPosition.x, gLightPosition.y, gLightPosition.z);
-    // LAMP TWO
-    glUniform3f(lightColorLoc2, gLightColor2.r, gLightColor2.g, gLightColor2.b);
-    glUniform3f(lightPositionLoc2, gLightPosition2.x, gLightPosition2.y, gLightPosition2.z);
-    // LAMP THREE
-    glUniform3f(lightColorLoc3, gLightColor3.r, gLightColor3.g, gLightColor3.b);
-    glUniform3f(lightPositionLoc3, gLightPosition3.x, gLightPosition3.y, gLightPosition3.z);
-
-    const glm::vec3 cameraPosition = gCamera.Position;
-    glUniform3f(viewPositionLoc, cameraPosition.x, cameraPosition.y, cameraPosition.z);
-
-    GLint UVScaleLoc = glGetUniformLocation(gProgramId, "uvScale");
-    glUniform2fv(UVScaleLoc, 1, glm::value_ptr(gUVScale));
-
-    glUseProgram(gProgramId);
-
-    // chars to specify which type of texture wrap to use in UCreateTexture
-    char mirroredRepeat = 'm';
-    char clampToEdge = 'c';
+    // Set the shader to be used, the indirect one reads model matrices and materials from the draw records
+    glUseProgram(USceneProgram());
 
-    // Load texture files
-    const char* texFileName = "mortar.jpg";
-    const char* texFileName2 = "wood.jpg";
-    const char* texFileName3 = "glass.jpg";
-    const char* texFileName4 = "porcelain.jpg";
-
-
-    // call UCreateTexture to set textures
-    UCreateTexture(texFileName, gTextureId, mirroredRepeat);
-    UCreateTexture(texFileName2, gTextureId2, mirroredRepeat);
-    UCreateTexture(texFileName3, gTextureId3, mirroredRepeat);
-    UCreateTexture(texFileName4, gTextureId4, mirroredRepeat);
-    UCreateTexture(texFileName2, gTextureId5, clampToEdge);
+    // View, projection, lights, camera and texture scale for every scene program, one write per frame
+    gFrameStream.beginFrame();
+    UWriteFrameUniforms(view, projection);
 
+    // pick the levels of detail and stream in the texture detail this view needs before the draws
+    USelectLods(model, view, projection);
+    UStreamTextures(model, view, projection);
 
     // BIND VERTEX ARRAYS & ACTIVATE AND BIND EACH TEXTURES TO DRAW EACH SHAPE
-    // gMesh
-    glBindVertexArray(gMesh.vao); // Activate the VBOs
-    glActiveTexture(GL_TEXTURE0);    // bind texture
-    glBindTexture(GL_TEXTURE_2D, gTextureId);
-    glDrawElements(GL_TRIANGLES, gMesh.nIndices, GL_UNSIGNED_SHORT, NULL);    // Draws the triangles for the bowl
-
-    // gMesh2 
-    glBindVertexArray(gMesh2.vao); // Activate the VBOS
-    glBindTexture(GL_TEXTURE_2D, gTextureId);
-    glDrawElements(GL_TRIANGLES, gMesh2.nIndices, GL_UNSIGNED_SHORT, NULL);    // Draws the triangles for the bowl base
-
-    // gMesh3
-    glBindVertexArray(gMesh3.vao); // Activate VBOS
-    glBindTexture(GL_TEXTURE_2D, gTextureId4);
-    glDrawElements(GL_TRIANGLES, gMesh3.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle for the ramekin
-
-    // gMesh4
-    glBindVertexArray(gMesh4.vao); // Activate VBOS
-    glBindTexture(GL_TEXTURE_2D, gTextureId3);
-    glDrawElements(GL_TRIANGLES, gMesh4.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle for the vase mouth
-
-    // gMesh5
-    glBindVertexArray(gMesh5.vao); // Activate VBOS
-    glBindTexture(GL_TEXTURE_2D, gTextureId3);
-    glDrawElements(GL_TRIANGLES, gMesh5.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle for the vase stem
-
-    // gMesh6
-    glBindVertexArray(gMesh6.vao); // Activate VBOS
-    glBindTexture(GL_TEXTURE_2D, gTextureId3);
-    glDrawElements(GL_TRIANGLES, gMesh6.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle for the vase base
-
-    // gMesh7
-    glBindVertexArray(gMesh7.vao); // Activate VBOS
-    glBindTexture(GL_TEXTURE_2D, gTextureId2);
-    glDrawElements(GL_TRIANGLES, gMesh7.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle for the table
-
-    // gMesh8
-    glBindVertexArray(gMesh8.vao); // Activate VBOS
-    glBindTexture(GL_TEXTURE_2D, gTextureId5);
-    glDrawElements(GL_TRIANGLES, gMesh8.nIndices, GL_UNSIGNED_SHORT, NULL); // Draws the triangle for ramekin detail
+    UBeginGpuTimer(gSceneTimer);
+    UDrawScene(model, view, projection);
+    UEndGpuTimer(gSceneTimer);
+    gFrameStream.endFrame();
 
     // Deactivate the Vertex Array Object
     glBindVertexArray(0);
+    URecordFrameCalls(firstCall);
 
     // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
     glfwSwapBuffers(gWindow);    // Flips the the back buffer with the front buffer every frame.
 
 }
 
-// method for drawing cylider
-void DrawCylinder(float cx, float cy, float z, float r, int num_segments, float length, float u, float v, GLfloat vertexArray[], GLushort indiceArray[])
+// Fills the FrameData block for this frame's view: one write into the frame's region of the stream buffer and
+// one bind, or one glBufferSubData into gFrameUniformBuffer without it
+void UWriteFrameUniforms(const glm::mat4& view, const glm::mat4& projection)
 {
-  
-    // fill vertex array for top circle of cylinder
-    for (int i = 0; i < num_segments + 1; i++)
+    FrameUniforms frame;
+    frame.view = view;
+    frame.projection = projection;
+    frame.viewPosition = glm::vec4(gCamera.Position, 1.0f);
+    frame.lightColors[0] = glm::vec4(gLightColor, 1.0f);
+    frame.lightColors[1] = glm::vec4(gLightColor2, 1.0f);
+    frame.lightColors[2] = glm::vec4(gLightColor3, 1.0f);
+    frame.lightPositions[0] = glm::vec4(gLightPosition, 1.0f);
+    frame.lightPositions[1] = glm::vec4(gLightPosition2, 1.0f);
+    frame.lightPositions[2] = glm::vec4(gLightPosition3, 1.0f);
+    const GLfloat* scale = gGeometry.getPositionScale();      // dequantizes the pool's positions
+    const GLfloat* offset = gGeometry.getPositionOffset();
+    frame.positionScale = glm::vec4(scale[0], scale[1], scale[2], 0.0f);
+    frame.positionOffset = glm::vec4(offset[0], offset[1], offset[2], 0.0f);
+    frame.uvScale = glm::vec4(gUVScale.x, gUVScale.y, 0.0f, 0.0f);
+
+    StreamAllocation allocation = gFrameStream.allocate(sizeof(frame), gFrameUniformAlignment);
+    if (allocation.data)
     {
-        float theta = 2.0f * 3.1415926f * float(i) / float(num_segments);//get the current angle
-        float x = r * cosf(theta);//calculate the x component
-        float y = r * sinf(theta);//calculate the y component
-
-        vertexArray[(i * 5) + 0] = x + cx;
-        vertexArray[(i * 5) + 1] = y + cy;
-        vertexArray[(i * 5) + 2] = z;
-        vertexArray[(i * 5) + 3] = ((x + r) / (2 * r));
-        vertexArray[(i * 5) + 4] = ((y + r) / (2 * r));
-
-        //cout << u << "|" << v << endl;
+        memcpy(allocation.data, &frame, sizeof(frame));
+        glBindBufferRange(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, allocation.buffer, allocation.offset, sizeof(frame));
+        return;
     }
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, gFrameUniformBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frame), &frame);
+}
 
-    // connect triangles for top circle
-    for (GLushort i = 0; i < num_segments - 2; i++)
-    {
-        indiceArray[(i * 3) + 0] = 0;
-        indiceArray[(i * 3) + 1] = i + 1;
-        // logic for connecting last triangle to fist triangle
-        if (i + 1 == num_segments) { 
-            indiceArray[(i * 3) + 2] = (i + 1) - num_segments;
-        }
-        else
-        {
-            indiceArray[(i * 3) + 2] = i + 2;
-        }
-    }
 
-    z = length; // value for setting z for bottom circle of cylinder
-    int vertexArrayOffset = (num_segments) * 5; // value to offset vertex Array for second circle
-    int indiceArrayOffset = (num_segments - 2) * 3; // value to offset indice array for second circle
-    int totalCircleSegments = vertexArrayOffset / 5; // value for calculating cylinder slat pairings
- 
-    // fill vertex array
-    for (int i = 0; i < num_segments; i++)
-    {
-        float theta = 2.0f * 3.1415926f * float(i) / float(num_segments);//get the current angle
-        float x = r * cosf(theta);//calculate the x component
-        float y = r * sinf(theta);//calculate the y component
+// The FrameData store used without a stream buffer, and the offset alignment of the stream buffer slices
+void UCreateFrameUniforms()
+{
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &gFrameUniformAlignment);
+    gFrameUniformAlignment = max(gFrameUniformAlignment, 1);
+    gFrameUniformBuffer = gResources.createBuffer("frame uniforms");
+    glBindBuffer(GL_UNIFORM_BUFFER, gFrameUniformBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    gResources.setSize(GL_RESOURCE_BUFFER, gFrameUniformBuffer, sizeof(FrameUniforms));
+}
 
-        vertexArray[vertexArrayOffset + (i * 5) + 0] = x + cx;
-        vertexArray[vertexArrayOffset + (i * 5) + 1] = y + cy;
-        vertexArray[vertexArrayOffset + (i * 5) + 2] = z;
-        vertexArray[vertexArrayOffset + (i * 5) + 3] = ((x + r) / (2 * r));
-        vertexArray[vertexArrayOffset + (i * 5) + 4] = ((y + r) / (2 * r));
-        //cout << u << "|" << v << endl;
- 
-    }
 
-    // connect triangles for bottom circle
-    for (GLushort i = 0; i < num_segments - 2; i++)
+// Adds the GL calls made since firstCall to the frame statistics
+void URecordFrameCalls(unsigned long long firstCall)
+{
+    unsigned long long calls = UGLCallCount() - firstCall;
+    gGLCallStats.total += calls;
+    gGLCallStats.peak = max(gGLCallStats.peak, calls);
+    ++gGLCallStats.frames;
+}
+
+
+// Startup benchmark: GL calls and CPU time per frame to hand the scene programs their per-frame state, with
+// UWriteFrameUniforms and with a replay of the per-uniform sequence the scene used before the FrameData block.
+// The replay runs against today's programs, so it is an estimate of the old cost, not a before/after measurement.
+void UBenchmarkFrameUniforms()
+{
+    const int frames = 1000;
+    glm::mat4 model(1.0f);
+    glm::mat4 view = gCamera.GetViewMatrix();
+    glm::mat4 projection = glm::perspective(glm::radians(gCamera.Zoom), (GLfloat)WINDOW_WIDTH / (GLfloat)WINDOW_HEIGHT, 0.1f, 100.0f);
+
+    cout << "INFO: Frame uniforms benchmark (" << frames << " frames)" << endl;
+    glUseProgram(gProgramId);
+    for (int mode = 0; mode < 2; ++mode)
     {
-        indiceArray[indiceArrayOffset + (i * 3) + 0] = totalCircleSegments + 0;
-        indiceArray[indiceArrayOffset + (i * 3) + 1] = totalCircleSegments + (i + 1);
-        // logic for connecting last triangle to first
-        if (i + 1 == num_segments) { 
-            indiceArray[indiceArrayOffset + (i * 3) + 2] = (totalCircleSegments + (i + 1)) - num_segments;
-        }
-        else
+        // only the uniform work is counted and timed, not the stream buffer's fences
+        unsigned long long calls = 0;
+        double ms = 0.0;
+        glFinish();
+        for (int frame = 0; frame < frames; ++frame)
         {
-            indiceArray[indiceArrayOffset + (i * 3) + 2] = totalCircleSegments + (i + 2);
+            gFrameStream.beginFrame();
+            unsigned long long firstCall = UGLCallCount();
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            if (mode == 0)
+                ULegacySceneUniforms(gProgramId, model, view, projection);
+            else
+                UWriteFrameUniforms(view, projection);
+            ms += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+            calls += UGLCallCount() - firstCall;
+            gFrameStream.endFrame();
         }
+        cout << "    " << (mode == 0 ? "per-uniform calls (replayed)" : "uniform block") << ": " << (double)calls / frames << " GL calls, "
+             << ms * 1000.0 / frames << " us per frame" << endl;
     }
+    glFinish();
+}
+
+
+// The per-uniform sequence the scene programs were fed with before the FrameData block, kept for
+// --bench-uniforms. The current programs no longer have these uniforms, so the lookups return -1 and the
+// sets are ignored; what is measured is the cost of making the calls.
+void ULegacySceneUniforms(GLuint programId, const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection)
+{
+    // Retrieves and passes transform matrices to the Shader program
+    GLint modelLoc = glGetUniformLocation(programId, "model");
+    GLint viewLoc = glGetUniformLocation(programId, "view");
+    GLint projLoc = glGetUniformLocation(programId, "projection");
+
+    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection));
+
+    // Reference matrix uniforms from the Cube Shader program for the cub color, light color, light position, and camera position 
+    // LAMP ONE
+    GLint objectColorLoc = glGetUniformLocation(programId, "objectColor");
+    GLint lightColorLoc = glGetUniformLocation(programId, "lightColor");
+    GLint lightPositionLoc = glGetUniformLocation(programId, "lightPos");
+    // LAMP TWO
+    GLint lightColorLoc2 = glGetUniformLocation(programId, "lightColor2");
+    GLint lightPositionLoc2 = glGetUniformLocation(programId, "lightPos2");
+    // LAMP THREE
+    GLint objectColorLoc2 = glGetUniformLocation(programId, "objectColor");
+    GLint lightColorLoc3 = glGetUniformLocation(programId, "lightColor3");
+    GLint lightPositionLoc3 = glGetUniformLocation(programId, "lightPos3");
+    GLint viewPositionLoc = glGetUniformLocation(programId, "viewPosition");
+
+    // Pass color, light, and camera data to the Cube Shader program's corresponding uniforms
+    // LAMP ONE
+    glUniform3f(objectColorLoc, 1.0f, 1.0f, 1.0f);
+    glUniform3f(lightColorLoc, gLightColor.r, gLightColor.g, gLightColor.b);
+    glUniform3f(lightPositionLoc, gLightPosition.x, gLightPosition.y, gLightPosition.z);
+    // LAMP TWO
+    glUniform3f(lightColorLoc2, gLightColor2.r, gLightColor2.g, gLightColor2.b);
+    glUniform3f(lightPositionLoc2, gLightPosition2.x, gLightPosition2.y, gLightPosition2.z);
+    // LAMP THREE
+    glUniform3f(lightColorLoc3, gLightColor3.r, gLightColor3.g, gLightColor3.b);
+    glUniform3f(lightPositionLoc3, gLightPosition3.x, gLightPosition3.y, gLightPosition3.z);
+
+    const glm::vec3 cameraPosition = gCamera.Position;
+    glUniform3f(viewPositionLoc, cameraPosition.x, cameraPosition.y, cameraPosition.z);
+
+    GLint UVScaleLoc = glGetUniformLocation(programId, "uvScale");
+    glUniform2fv(UVScaleLoc, 1, glm::value_ptr(gUVScale));
+
+    // dequantizes the pool's positions
+    glUniform3fv(glGetUniformLocation(programId, "positionScale"), 1, gGeometry.getPositionScale());
+    glUniform3fv(glGetUniformLocation(programId, "positionOffset"), 1, gGeometry.getPositionOffset());
+}
 
-    int indiceOffsetSlats = indiceArrayOffset * 2; // value to offset indice array values for cylinder slats
 
-    for (int i = 0; i < num_segments; i++)
+// True unless the sphere is completely outside one of the frustum planes of modelViewProjection.
+// The planes are rows of the matrix combined (Gribb/Hartmann), so they are in the sphere's model space.
+bool USphereInFrustum(const glm::mat4& modelViewProjection, const glm::vec3& center, float radius)
+{
+    const glm::mat4& m = modelViewProjection;
+    for (int axis = 0; axis < 3; ++axis)
     {
-        indiceArray[indiceOffsetSlats + (i * 6)] = i;
-        indiceArray[indiceOffsetSlats + (i * 6) + 3] = i;
-        // logic for connecting last triangle to first
-        if (i + 1 == num_segments) { 
-            indiceArray[indiceOffsetSlats + (i * 6) + 1] = num_segments;
-            indiceArray[indiceOffsetSlats + (i * 6) + 2] = (i + 1) + totalCircleSegments - 1;
-            indiceArray[indiceOffsetSlats + (i * 6) + 4] = 0;
-            indiceArray[indiceOffsetSlats + (i * 6) + 5] = totalCircleSegments;
-        }
-        else
+        for (int side = -1; side <= 1; side += 2)
         {
-            indiceArray[indiceOffsetSlats + (i * 6) + 1] = i + 1;
-            indiceArray[indiceOffsetSlats + (i * 6) + 2] = (i + 1) + totalCircleSegments;
-            indiceArray[indiceOffsetSlats + (i * 6) + 4] = i + (totalCircleSegments);
-            indiceArray[indiceOffsetSlats + (i * 6) + 5] = i + totalCircleSegments + 1;
+            float a = m[0][3] + side * m[0][axis];
+            float b = m[1][3] + side * m[1][axis];
+            float c = m[2][3] + side * m[2][axis];
+            float d = m[3][3] + side * m[3][axis];
+            float distance = a * center.x + b * center.y + c * center.z + d;
+            if (distance < -radius * sqrt(a * a + b * b + c * c))
+                return false;
         }
     }
+    return true;
 }
 
 
-void DrawTorus(float x, float y, float z, vector <GLfloat>& vertices, vector <GLushort>& indices, float r, float R, int nr, int nR) {
+// Draws every scene object. The visible ones (culled against the view frustum) are added as instances of
+// their mesh and level, then submitted with one glMultiDrawElementsIndirect call or one instanced draw each.
+void UDrawScene(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection)
+{
+    gGeometry.bind();   // one vertex array holds every mesh
+    UBindMaterials();   // material array and sampler, shared by every draw
 
-    const float pi = 3.1415926f; // variable for calulating pi
-    float du = 2 * pi / nR; // calculate arch for outer ring
-    float dv = 2 * pi / nr; // calculate arch for inner ring
-    int counter = 1; // counter for sending vertices to index array
+    size_t triangles = 0;
+    glm::mat4 modelViewProjection = projection * view * model;
+    gIndirectDraws.clear();
+    for (int i = 0; i < gNumSceneDraws; ++i)
+    {
+        const SceneDraw& draw = gSceneDraws[i];
+        const GLMesh& mesh = *draw.mesh;
+        if (mesh.tessellated || !USphereInFrustum(modelViewProjection * draw.transform, mesh.center, mesh.radius))
+            continue;
+        const MeshRange& range = mesh.lods[draw.lod].range;
+        const Material& material = gMaterials[draw.material];
+        glm::mat4 instanceModel = model * draw.transform;
+        gIndirectDraws.add(range, glm::value_ptr(instanceModel), material.layer, material.wrap, UResidentMipLevel(material.layer));
+        triangles += range.indexCount / 3;
+    }
+    if (gUseIndirectDraws)
+        gIndirectDraws.submit(gGeometry);
+    else
+        gIndirectDraws.submitInstanced(gGeometry);
 
+    if (gUseTessellation)
+        triangles += UDrawTessellatedScene(model, view, projection);
 
-    for (size_t i = 0; i < nR; i++) {
+    gTriangleStats.total += triangles;
+    gTriangleStats.peak = max(gTriangleStats.peak, triangles);
+    ++gTriangleStats.frames;
+}
 
-        float u = i * du;
 
-        for (size_t j = 0; j <= nr; j++) {
+// The program the scene's meshes are drawn with, the indirect one reads model matrices and materials from the draw records
+GLuint USceneProgram()
+{
+    return gUseIndirectDraws ? gIndirectProgramId : gProgramId;
+}
 
-            float v = (j % nr) * dv;
-            // float values used to adjust torus position
-            float xSkew = 0.75;
-            float ySkew = 1.90;
-            float zSkew = 3.20;
 
-            for (size_t k = 0; k < 2; k++)
-            {              
-                float uu = u + k * du;
-                // compute vertex
-                 x = (R + r * cos(v)) * cos(uu) + xSkew ;
-                 y = (R + r * cos(v)) * sin(uu) - ySkew;
-                 z = r * sin(v) + zSkew;
+// Draws the tessellated meshes with their own program, which gets the same uniforms as the scene program.
+// The scene program is bound again afterwards. Returns the triangles the patches are tessellated into,
+// estimated on the CPU from the same levels the control shader picks.
+size_t UDrawTessellatedScene(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection)
+{
+    size_t triangles = 0;
+    int width = 0, height = 0;
+    glfwGetFramebufferSize(gWindow, &width, &height);
+
+    // the FrameData block is already bound, only the levels' inputs are set here
+    glUseProgram(gTessProgramId);
+    glUniform1f(gTessUniforms.viewportHeight, (GLfloat)height);
+    glUniform1f(gTessUniforms.maxPixelError, gLodPixelError);
+
+    // the patches are unit shapes too, each draw places them with its own model matrix
+    gTessShapes.bind();
+    glm::mat4 modelViewProjection = projection * view * model;
+    for (int i = 0; i < gNumSceneDraws; ++i)
+    {
+        const SceneDraw& draw = gSceneDraws[i];
+        const GLMesh& mesh = *draw.mesh;
+        if (!mesh.tessellated || !USphereInFrustum(modelViewProjection * draw.transform, mesh.center, mesh.radius))
+            continue;
+        glm::mat4 instanceModel = model * draw.transform;
+        glUniformMatrix4fv(gTessUniforms.model, 1, GL_FALSE, glm::value_ptr(instanceModel));
+        USetMaterial(draw.material, gTessUniforms.material);
+        gTessShapes.draw(mesh.patches);
+
+        // a quad domain with inner levels u x v is split into 2 u v triangles
+        glm::mat4 modelView = view * instanceModel;
+        float scale = glm::length(glm::vec3(instanceModel[0])) * projection[1][1] * height * 0.5f;
+        for (GLint p = mesh.patches.first; p < mesh.patches.first + mesh.patches.count; ++p)
+        {
+            const TessPatch& patch = gTessShapes.getPatch(p);
+            glm::vec4 eye = modelView * glm::vec4(patch.origin[0], patch.origin[1], patch.origin[2], 1.0f);
+            float w = projection[2][3] != 0.0f ? max(-eye.z, 0.01f) : 1.0f;
+            float levelU = UTessSegments(patch.detail[0], patch.detail[1], scale / w, gLodPixelError);
+            float levelV = UTessSegments(patch.detail[2], patch.detail[3], scale / w, gLodPixelError);
+            triangles += (size_t)(2.0f * levelU * levelV);
+        }
+    }
 
-                float tx = uu / (2 * pi); // calculate texCoordinate u
-                float ty = v / (2 * pi);  // calculate texCooridnate v
+    glUseProgram(USceneProgram());
+    return triangles;
+}
+
+
+// Startup benchmark: CPU time to submit N copies of the scene objects as one draw per object, one instanced
+// draw per mesh and one glMultiDrawElementsIndirect call. The GPU is drained between frames and not timed;
+// the uniforms are left as they are, only the submission cost matters here. With a frame stream, the draw list
+// writes into a stream buffer of its own whose regions hold the largest count, so every step times the
+// persistent mapping rather than the respecifying fallback, and the run's stream statistics stay untouched.
+void UBenchmarkDrawSubmission()
+{
+    const int objectCounts[] = { 8, 100, 1000, 10000, 100000 };
+    const int objectCountsSize = (int)(sizeof(objectCounts) / sizeof(objectCounts[0]));
+    const int frames = 5;
 
-                // add vertex to vertice vector
-                vertices.push_back(x);
-                vertices.push_back(y);
-                vertices.push_back(z);
-                vertices.push_back(tx); 
-                vertices.push_back(ty);
+    StreamBuffer benchStream;
+    if (gFrameStream.isCreated())
+    {
+        // records plus one command per scene draw at most, with room for their alignment
+        size_t regionBytes = objectCounts[objectCountsSize - 1] * sizeof(DrawRecord)
+            + gNumSceneDraws * sizeof(DrawElementsIndirectCommand) + 4096;
+        if (benchStream.create(gResources, "draw submission benchmark", regionBytes))
+            gIndirectDraws.setStream(&benchStream);
+    }
 
-                counter++;
+    cout << "INFO: Draw submission benchmark (CPU ms per frame, " << frames << " frames each, per-frame data "
+         << (benchStream.isCreated() ? "in a persistently mapped stream buffer" : "in buffers respecified every frame") << ")" << endl;
+    gGeometry.bind();
+    UBindMaterials();
+    for (int c = 0; c < objectCountsSize; ++c)
+    {
+        int count = objectCounts[c];
+        unsigned int overflowsBefore = benchStream.getStats().overflows;
+        vector<glm::mat4> models(count);
+        for (int i = 0; i < count; ++i)
+        {
+            const SceneDraw& draw = gSceneDraws[i % gNumSceneDraws];
+            models[i] = glm::translate(glm::vec3((i % 64) * 0.1f, (i / 64 % 64) * 0.1f, (i / 4096) * -0.1f)) * draw.transform;
+        }
 
-                // logic for adding values to indice array
-                if (counter % 4 == 0) // adds to vector only after obtaining 4 values (two triangles)
+        // one draw per object, instanced per mesh, then multi-draw indirect when available
+        const int modes = gIndirectDrawsAvailable ? 3 : 2;
+        double ms[3] = { 0.0, 0.0, 0.0 };
+        for (int mode = 0; mode < modes; ++mode)
+        {
+            glUseProgram(mode == 2 ? gIndirectProgramId : gProgramId);
+            for (int frame = 0; frame < frames; ++frame)
+            {
+                glFinish();
+                chrono::steady_clock::time_point start = chrono::steady_clock::now();
+                benchStream.beginFrame();
+                gIndirectDraws.clear();
+                for (int i = 0; i < count; ++i)
                 {
-                    indices.push_back(counter - 1);
-                    indices.push_back(counter - 2);
-                    indices.push_back(counter - 3);
-                    indices.push_back(counter - 2);
-                    indices.push_back(counter - 3);
-                    indices.push_back(counter - 4);
-                }
-                else if (counter % 2 == 0) { // connects the triangles that mod 4 skips
-                    if (counter != 2) { // logic to ensure mod 2 is only used AFTER the first four points are added to the vector
-                        indices.push_back(counter - 4);
-                        indices.push_back(counter - 3);
-                        indices.push_back(counter - 2);
-                        indices.push_back(counter - 2);
-                        indices.push_back(counter - 3);
-                        indices.push_back(counter - 1);
-                    }
+                    const SceneDraw& draw = gSceneDraws[i % gNumSceneDraws];
+                    if (draw.mesh->tessellated)
+                        continue;
+                    const Material& material = gMaterials[draw.material];
+                    gIndirectDraws.add(draw.mesh->lods[draw.lod].range, glm::value_ptr(models[i]), material.layer, material.wrap,
+                                       UResidentMipLevel(material.layer));
                 }
+                if (mode == 2)
+                    gIndirectDraws.submit(gGeometry);
+                else
+                    gIndirectDraws.submitInstanced(gGeometry, mode == 0);
+                benchStream.endFrame();
+                ms[mode] += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
             }
-            // increment angle
-            v += dv;
         }
+
+        cout << "    " << count << " objects: one draw per object " << ms[0] / frames << " ms, instanced " << ms[1] / frames
+             << " ms (" << (ms[1] > 0.0 ? ms[0] / ms[1] : 0.0) << "x)";
+        if (gIndirectDrawsAvailable)
+            cout << ", multi-draw indirect " << ms[2] / frames << " ms (" << (ms[2] > 0.0 ? ms[0] / ms[2] : 0.0) << "x)";
+        // should not happen with the regions sized above, but those uploads fell back to respecifying buffers
+        if (unsigned int overflows = benchStream.getStats().overflows - overflowsBefore)
+            cout << ", " << overflows << " stream buffer overflows";
+        cout << endl;
     }
+    glFinish();
+    glBindVertexArray(0);
+
+    gIndirectDraws.setStream(gFrameStream.isCreated() ? &gFrameStream : nullptr);
+    if (benchStream.isCreated())
+        benchStream.destroy(gResources);
 }
 
 
+// method for drawing cylider
+// Returns (x, y, z, nx, ny, nz, u, v) vertices and the triangles, see UGenerateCylinder.
+// Both are allocated exactly once from the arena and generated in place.
+GeneratedMesh DrawCylinder(float cx, float cy, float z, float r, int num_segments, float length, ScratchArena& arena)
+{
+    GeneratedMesh mesh;
+    mesh.vertexCount = UCylinderVertexCount(num_segments);
+    mesh.indexCount = UCylinderIndexCount(num_segments);
+    mesh.vertices = arena.allocate<GLfloat>(mesh.vertexCount * MESH_FLOATS_PER_VERTEX);
+    mesh.indices = arena.allocate<GLuint>(mesh.indexCount);
+    UGenerateCylinder(cx, cy, z, r, num_segments, length, mesh.vertices, mesh.indices, arena);
+    return mesh;
+}
 
-// Implements the UCreateMesh function
-void UCreateMesh(GLMesh& mesh, GLMesh& mesh2, GLMesh& mesh3, GLMesh& mesh4, GLMesh& mesh5, GLMesh& mesh6, GLMesh& mesh7, GLMesh& mesh8)
+
+// Ring of radius R around the Z axis through (x, y, z), tube radius r, see UGenerateTorus
+GeneratedMesh DrawTorus(float x, float y, float z, ScratchArena& arena, float r, float R, int nr, int nR) {
+
+    GeneratedMesh mesh;
+    mesh.vertexCount = UTorusVertexCount(nr, nR);
+    mesh.indexCount = UTorusIndexCount(nr, nR);
+    mesh.vertices = arena.allocate<GLfloat>(mesh.vertexCount * MESH_FLOATS_PER_VERTEX);
+    mesh.indices = arena.allocate<GLuint>(mesh.indexCount);
+    UGenerateTorus(x, y, z, r, R, nr, nR, mesh.vertices, mesh.indices, arena);
+    return mesh;
+}
+
+
+// Rebuilds every level of the generated meshes, plus flat shaded spheres, over and over. After the first
+// round has sized the arenas, counts every operator new of the rounds that follow, which should be none.
+void UBenchmarkMeshRebuild()
 {
+    const int rounds = 200;
+    ScratchArena scratch;
+    Sphere smoothSphere(1.0f, SPHERE_SECTORS[0], SPHERE_STACKS[0], true);
+    Sphere flatSphere(1.0f, SPHERE_SECTORS[0], SPHERE_STACKS[0], false);
+
+    chrono::steady_clock::time_point start;
+    for (int round = 0; round <= rounds; ++round)
+    {
+        if (round == 1)
+        {
+            UStartCountingAllocations();
+            start = chrono::steady_clock::now();
+        }
+        for (int lod = 0; lod < MAX_MESH_LODS; ++lod)
+        {
+            scratch.reset();
+            DrawCylinder(0.0f, 0.0f, 0.0f, 1.0f, CYLINDER_SEGMENTS[lod], 1.0f, scratch);
+            DrawTorus(0.0f, 0.0f, 0.0f, scratch, TORUS_TUBE_RADIUS, 1.0f, TORUS_SEGMENTS[lod], TORUS_SEGMENTS[lod]);
+            smoothSphere.set(1.0f, SPHERE_SECTORS[lod], SPHERE_STACKS[lod], true);
+            flatSphere.set(1.0f, SPHERE_SECTORS[lod], SPHERE_STACKS[lod], false);
+        }
+    }
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    size_t allocations = UStopCountingAllocations();
+
+    cout << "INFO: Mesh rebuild benchmark (" << MAX_MESH_LODS << " levels of cylinder, torus, smooth and flat sphere)" << endl;
+    cout << "    " << ms / rounds << " ms per rebuild, " << allocations << " heap allocations in " << rounds
+         << " rebuilds after the first, arenas " << scratch.getCapacity() + smoothSphere.getDataSize() + flatSphere.getDataSize()
+         << " bytes" << endl;
+}
 
-    const int numSegments = 100; // value to determine number of triangles for cydlinder shapes
 
-    // BOWL (cylinder)
-    GLfloat bowlVerts[((numSegments + 1) * 5) * 2]; // vertex values for bowl
-    GLushort bowlIndices[((numSegments * 3) * 4) - 12]; // indice values for bowl
-    DrawCylinder(-2.0f, -2.0f, 0.5f, 1.5f, numSegments, 2.00f, 1.0f, 0.0f, bowlVerts, bowlIndices); // draw cylinder
 
-    // BOWL BASE (cyldinder)
-    GLfloat bowlBaseVerts[((numSegments + 1) * 5) * 2];  // vertex valus for bowl basae=
-    GLushort indices[((numSegments * 3) * 4) - 12]; // indice values for bowl base
-    DrawCylinder(-2.0f, -2.0f, 0.0f, 1.0f, numSegments, 1.5f, 1.0f, 1.0f, bowlBaseVerts, indices); // draw cylinder
+// Implements the UCreateMesh function
+// Every primitive type is one unit mesh, the scene draws place and scale it
+void UCreateMesh(GLMesh& cylinder, GLMesh& torus, GLMesh& sphere, GLMesh& table)
+{
 
-    // RAMEKIN (cylinder)
-    GLfloat ramekinVerts[((numSegments + 1) * 5) * 2];  // vertex values for ramekin
-    GLushort ramekinIndices[((numSegments * 3) * 4) - 12]; // indice values for ramekin
-    DrawCylinder(-0.5f, -3.4, 0.0f, 0.5f, numSegments, 0.5f, 1.0f, 1.0f, ramekinVerts, ramekinIndices); // draw cylinder
+    const float pi = 3.1415926f;
+    const int floatsPerVertex = 3;
+    const int floatsPerUV = 2;
 
-    // RAMEKIN LIP (cylinder)
-    GLfloat ramekinLipVerts[((numSegments + 1) * 5) * 2]; // vertex values for ramekin lip
-    GLushort ramekinLipIndices[((numSegments * 3) * 4) - 12]; // indice values for ramekin lip
-    DrawCylinder(-.5, -3.4, .501 , 0.41, numSegments, 0.0, 1.0, 1.0, ramekinLipVerts, ramekinLipIndices); // draw cylinder
+    // Floats per vertex of the plane (x, y, z, r, g, b, a, u, v)
+    const int planeStride = floatsPerVertex + floatsPerUV + 4;
 
-    // VASE MOUTH (torus)
-    vector <GLfloat> vaseMouthVerts; // vertex values for vase mouth
-    vector <GLushort> vaseMouthIndices; // indice values for vase mouth
-    const int innerSegments = 16; // value for inner ring of value torus
-    const int outerSegments = 16; // value for outer ring value of torus
-    DrawTorus(0.0, 0.0, 0.0, vaseMouthVerts, vaseMouthIndices, 0.1, .5, innerSegments, outerSegments); // draw torus
+    // Every shape in the order they are added to the pool
+    vector<PoolShape> shapes;
 
-    // VASE STEM (cylinder)
-    GLfloat stemVerts[((numSegments + 1) * 5) * 2];  // vertex values for vase stem
-    GLushort stemIndices[((numSegments * 3) * 4) - 12]; // indice values for vase stem
-    DrawCylinder(.75f, -1.90, 2.0f, 0.45f, numSegments, 3.2f, 1.0f, 1.0f, stemVerts, stemIndices); // draw cylinder
+    cout << "INFO: Mesh generators using " << UMeshKernelsName(UGetMeshKernels()) << " kernels" << endl;
 
-    // VASE BASE (sphere)
-    Sphere vaseBase(1.20, 100, 20, true); // instantiate Sphere object with radius, sector, and stack values
+    if (gUseTessellation)
+    {
+        gTessShapes.create(gResources);
+        UAddTessellatedMesh(cylinder, gTessShapes.addCylinder(0.0f, 0.0f, 0.0f, 1.0f, 1.0f));
+        UAddTessellatedMesh(torus, gTessShapes.addTorus(0.0f, 0.0f, 0.0f, TORUS_TUBE_RADIUS, 1.0f));
+        UAddTessellatedMesh(sphere, gTessShapes.addSphere(0.0f, 0.0f, 0.0f, 1.0f));
+        gTessShapes.upload();
+        cout << "INFO: Tessellated primitives: " << gTessShapes.getPatchCount() << " patches in " << gTessShapes.getByteSize() << " bytes" << endl;
+    }
 
+    for (int lod = 0; lod < MAX_MESH_LODS && !gUseTessellation; ++lod)
+    {
+        // CYLINDER (bowl, bowl base, ramekin, ramekin lip, vase stem)
+        float segments = (float)CYLINDER_SEGMENTS[lod];
+        shapes.push_back(PoolShape(SHAPE_CYLINDER, &cylinder, lod, 1.0f - cosf(pi / segments)));
+        shapes.back().params = { 0.0f, 0.0f, 0.0f, 1.0f, segments, 1.0f };
+
+        // TORUS (vase mouth), the error is the larger of the ring and the tube chord errors
+        segments = (float)TORUS_SEGMENTS[lod];
+        shapes.push_back(PoolShape(SHAPE_TORUS, &torus, lod, (1.0f + TORUS_TUBE_RADIUS) * (1.0f - cosf(pi / segments))));
+        shapes.back().params = { 0.0f, 0.0f, 0.0f, TORUS_TUBE_RADIUS, 1.0f, segments, segments };
+
+        // SPHERE (vase base), sectors span 2 pi and stacks pi so the longest chords come from the coarser of the two steps
+        shapes.push_back(PoolShape(SHAPE_SPHERE, &sphere, lod, 1.0f - cosf(pi / min(SPHERE_SECTORS[lod], 2 * SPHERE_STACKS[lod]))));
+        shapes.back().params = { 1.0f, (float)SPHERE_SECTORS[lod], (float)SPHERE_STACKS[lod] };
+    }
 
     // TABLE (plane)
     // vertices, color values, and texture coordinates for plane
@@ -909,335 +1674,888 @@ void UCreateMesh(GLMesh& mesh, GLMesh& mesh2, GLMesh& mesh3, GLMesh& mesh4, GLMe
     };
 
     // Indice values for plane
-    GLushort planeIndices[] = {
+    GLuint planeIndices[] = {
         0,3,2,
         0,1,2
     };
+    shapes.push_back(PoolShape(SHAPE_TABLE, &table, 0, 0.0f));
+    shapes.back().vertices = UPoolVertices(planeVerts, 4, planeStride, -1, floatsPerVertex + 4);
+    shapes.back().indices.assign(planeIndices, planeIndices + sizeof(planeIndices) / sizeof(planeIndices[0]));
+
+    // Generated shapes come from the mesh cache when it has them, already optimized. The others are generated
+    // and reordered before upload, reporting the cache efficiency with a FIFO of MESH_CACHE_SIZE, then cached.
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    list<CachedMesh> cachedMeshes;  // mapped until the pool has its copy
+    ScratchArena scratch;
+    int generatedCount = 0;
+    bool statsHeader = false;
+    for (PoolShape& shape : shapes)
+    {
+        bool generated = shape.generator != SHAPE_TABLE;
+        if (generated)
+            ++generatedCount;
+        unsigned long long key = generated ? UShapeCacheKey(shape) : 0;
+        if (generated && gUseMeshCache)
+        {
+            cachedMeshes.emplace_back();
+            if (cachedMeshes.back().open(UMeshCachePath(key).c_str(), key))
+            {
+                shape.cached = &cachedMeshes.back();
+                continue;
+            }
+            cachedMeshes.pop_back();
+        }
+
+        if (generated)
+            UGenerateShape(shape, scratch);
+
+        if (gOptimizeMeshes)
+        {
+            VertexCacheStats before = UAnalyzeVertexCache(shape.indices, shape.vertices.size());
+            UOptimizeMesh(shape.vertices, shape.indices);
+            VertexCacheStats after = UAnalyzeVertexCache(shape.indices, shape.vertices.size());
+            if (shape.lod == 0 && generated)
+            {
+                if (!statsHeader)
+                    cout << "INFO: Mesh optimization (ACMR / ATVR of the finest levels, " << MESH_CACHE_SIZE << " entry FIFO):" << endl;
+                statsHeader = true;
+                cout << "    " << SHAPE_NAMES[shape.generator] << ": " << before.acmr << " / " << before.atvr << " -> "
+                     << after.acmr << " / " << after.atvr << endl;
+            }
+        }
+
+        if (generated && gUseMeshCache)
+            UWriteCachedMesh(UMeshCachePath(key).c_str(), key, shape.vertices.data(), shape.vertices.size(),
+                             shape.indices.data(), shape.indices.size());
+    }
+    if (generatedCount > 0)
+        cout << "INFO: Generated meshes ready in " << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count()
+             << " ms, " << cachedMeshes.size() << " of " << generatedCount << " from the mesh cache"
+             << (gUseMeshCache ? "" : " (disabled)") << endl;
+
+    // Quantized positions are relative to a box around the whole scene. The pool is sized for all the shapes
+    // up front, so every add packs into its mapped range without moving the stores.
+    GLfloat boundsLow[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    GLfloat boundsHigh[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    size_t totalVertices = 0;
+    size_t totalIndices = 0;
+    size_t largestMesh = 0;
+    for (const PoolShape& shape : shapes)
+    {
+        totalVertices += shape.getVertexCount();
+        totalIndices += shape.getIndexCount();
+        largestMesh = max(largestMesh, shape.getVertexCount());
+        const PoolVertex* vertices = shape.getVertices();
+        for (size_t i = 0; i < shape.getVertexCount(); ++i)
+            for (int k = 0; k < 3; ++k)
+            {
+                boundsLow[k] = min(boundsLow[k], vertices[i].position[k]);
+                boundsHigh[k] = max(boundsHigh[k], vertices[i].position[k]);
+            }
+    }
+
+    // ALL SHAPES SHARE ONE VERTEX BUFFER, ONE INDEX BUFFER AND ONE VAO
+    chrono::steady_clock::time_point uploadStart = chrono::steady_clock::now();
+    gGeometry.create(gResources, 0, 0, gQuantizePositions, boundsLow, boundsHigh);
+    gGeometry.reserve(totalVertices, totalIndices, UIndexTypeFor(largestMesh));
+    for (const PoolShape& shape : shapes)
+        UAddPoolMesh(shape);
+    cout << "INFO: Geometry pool upload: " << gGeometry.getWrittenBytes() / 1024 << " KB packed straight into mapped buffer ranges in "
+         << chrono::duration<double, milli>(chrono::steady_clock::now() - uploadStart).count() << " ms, "
+         << gGeometry.getReallocations() << " store reallocations" << endl;
+
+    cout << "INFO: Geometry pool: " << gGeometry.getMeshCount() << " meshes and levels of detail for " << gNumSceneDraws << " objects, " << gGeometry.getVertexCount() << " vertices, "
+         << gGeometry.getIndexCount() << " " << gGeometry.getIndexSize() * 8 << "-bit indices in one vertex array, " << gGeometry.getVertexSize() << " bytes per vertex ("
+         << sizeof(PoolVertex) << " unpacked" << (gQuantizePositions ? ", quantized positions" : "") << ")" << endl;
+}
+
+
+// Runs a shape's generator with its parameters into its vertices and indices, in the pool's input layout
+void UGenerateShape(PoolShape& shape, ScratchArena& scratch)
+{
+    const vector<float>& p = shape.params;
+    scratch.reset();
+    if (shape.generator == SHAPE_SPHERE)
+    {
+        // Only the interleaved vertices and triangles are built, and freed as soon as the pool layout has its copy
+        Sphere unitSphere(p[0], (int)p[1], (int)p[2], true, SPHERE_INTERLEAVED); // instantiate Sphere object with radius, sector, and stack values
+        const int sphereStride = unitSphere.getInterleavedStride() / sizeof(float);
+        shape.vertices = UPoolVertices(unitSphere.getInterleavedVertices(), unitSphere.getInterleavedVertexCount(), sphereStride, 3, 6);
+        shape.indices.assign(unitSphere.getIndices(), unitSphere.getIndices() + unitSphere.getIndexCount());
+        unitSphere.releaseData();
+        return;
+    }
+
+    GeneratedMesh generated = shape.generator == SHAPE_CYLINDER
+        ? DrawCylinder(p[0], p[1], p[2], p[3], (int)p[4], p[5], scratch)               // draw cylinder
+        : DrawTorus(p[0], p[1], p[2], scratch, p[3], p[4], (int)p[5], (int)p[6]);      // draw torus
+    shape.vertices = UPoolVertices(generated.vertices, generated.vertexCount, MESH_FLOATS_PER_VERTEX, 3, 6);
+    shape.indices.assign(generated.indices, generated.indices + generated.indexCount);
+}
+
+
+// The generator's name, its parameters and whether the mesh is optimized, over the pool's input layout
+unsigned long long UShapeCacheKey(const PoolShape& shape)
+{
+    vector<float> params = shape.params;
+    params.push_back(gOptimizeMeshes ? 1.0f : 0.0f);
+    return UMeshCacheKey(SHAPE_NAMES[shape.generator], params.data(), (int)params.size(), POOL_VERTEX_FORMAT);
+}
+
+
+// Startup cost of production-sized meshes, far finer than the scene's levels: generating and optimizing them
+// against mapping them from the mesh cache and reading them through once, as the pool upload does
+void UBenchmarkMeshCache()
+{
+    PoolShape shapes[] = {
+        PoolShape(SHAPE_CYLINDER, nullptr, 0, 0.0f),
+        PoolShape(SHAPE_TORUS, nullptr, 0, 0.0f),
+        PoolShape(SHAPE_SPHERE, nullptr, 0, 0.0f)
+    };
+    shapes[0].params = { 0.0f, 0.0f, 0.0f, 1.0f, 4096.0f, 1.0f };
+    shapes[1].params = { 0.0f, 0.0f, 0.0f, TORUS_TUBE_RADIUS, 1.0f, 512.0f, 512.0f };
+    shapes[2].params = { 1.0f, 1024.0f, 512.0f };
+
+    cout << "INFO: Mesh cache benchmark (production tessellation" << (gOptimizeMeshes ? ", optimized" : "") << ")" << endl;
+    ScratchArena scratch;
+    double totalGenerated = 0.0;
+    double totalCached = 0.0;
+    for (PoolShape& shape : shapes)
+    {
+        unsigned long long key = UShapeCacheKey(shape);
+        string path = UMeshCachePath(key);
+
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        UGenerateShape(shape, scratch);
+        if (gOptimizeMeshes)
+            UOptimizeMesh(shape.vertices, shape.indices);
+        double generatedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        if (!UWriteCachedMesh(path.c_str(), key, shape.vertices.data(), shape.vertices.size(), shape.indices.data(), shape.indices.size()))
+            return;
+
+        // the sums keep the reads from being optimized away
+        start = chrono::steady_clock::now();
+        CachedMesh cached;
+        float sum = 0.0f;
+        GLuint indexSum = 0;
+        if (cached.open(path.c_str(), key))
+        {
+            for (size_t i = 0; i < cached.getVertexCount(); ++i)
+                sum += cached.getVertices()[i].position[0];
+            for (size_t i = 0; i < cached.getIndexCount(); ++i)
+                indexSum += cached.getIndices()[i];
+        }
+        volatile float sink = sum + (float)indexSum;
+        (void)sink;
+        double cachedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        bool same = cached.getByteSize() > 0 && cached.getVertexCount() == shape.vertices.size() && cached.getIndexCount() == shape.indices.size()
+            && memcmp(cached.getVertices(), shape.vertices.data(), shape.vertices.size() * sizeof(PoolVertex)) == 0
+            && memcmp(cached.getIndices(), shape.indices.data(), shape.indices.size() * sizeof(GLuint)) == 0;
+        size_t bytes = cached.getByteSize();
+        cached.close();
+        remove(path.c_str());
+
+        totalGenerated += generatedMs;
+        totalCached += cachedMs;
+        cout << "    " << SHAPE_NAMES[shape.generator] << " (" << shape.vertices.size() << " vertices, " << bytes / 1024 << " KB): generated "
+             << generatedMs << " ms, from cache " << cachedMs << " ms (" << (cachedMs > 0.0 ? generatedMs / cachedMs : 0.0) << "x)"
+             << (same ? "" : ", CACHED DATA DIFFERS") << endl;
+    }
+    cout << "    total: generated " << totalGenerated << " ms, from cache " << totalCached << " ms ("
+         << (totalCached > 0.0 ? totalGenerated / totalCached : 0.0) << "x)" << endl;
+}
+
 
-    const GLuint floatsPerVertex = 3;
-    const GLuint floatsPerUV = 2;
-    const GLuint floatsPerNormal = 3;
-
-    // Strides between vertex coordinates is 6 (x, y, z, r, g, b, a). A tightly packed stride is 0.
-    GLint stride = sizeof(float) * (floatsPerVertex + floatsPerUV);// calculate stride for cylinders
-    GLint planeStride = sizeof(float) * (floatsPerVertex + floatsPerUV + 4); // calculate stride for plane
-    int sphereStride = vaseBase.getInterleavedStride(); // calculate stride for sphere
-
-
-    // GENERATE AND CREATE BUFFERS AND VERTEX POINTERS FOR 3D SHAPES
-    // BEGIN FIRST SHAPE //
-    // CYLINDER (bowl) generate VAOs 
-    glGenVertexArrays(1, &mesh.vao);
-    glBindVertexArray(mesh.vao);
-
-    // Create 2 buffers
-    glGenBuffers(2, mesh.vbos);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbos[0]); // Activates the buffer
-    glBufferData(GL_ARRAY_BUFFER, sizeof(bowlVerts), bowlVerts, GL_STATIC_DRAW); // Sends verteX data to the GPU
-    mesh.nIndices = sizeof(bowlIndices) / sizeof(bowlIndices[0]); // calculate the number of indices
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.vbos[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(bowlIndices), bowlIndices, GL_STATIC_DRAW);
-
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(2);
-    // END FIRST SHAPE //
-
-    // BEGIN SECOND SHAPE //
-    //CYLINDER (base) generate VAOs 
-    glGenVertexArrays(1, &mesh2.vao); 
-    glBindVertexArray(mesh2.vao);
-
-    // Create 2 buffers 
-    glGenBuffers(2, mesh2.vbos);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh2.vbos[0]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(bowlBaseVerts), bowlBaseVerts, GL_STATIC_DRAW);
-    mesh2.nIndices = sizeof(indices) / sizeof(indices[0]);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh2.vbos[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    // Create Vertex Attribute Pointers 
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(2);
-    // END SECOND SHAPE //
-    
-    // BEGIN THIRD SHAPE //
-    //CYLINDER (bowl) generate VAOs 
-    glGenVertexArrays(1, &mesh3.vao);
-    glBindVertexArray(mesh3.vao);
-
-    // Create 2 buffers
-    glGenBuffers(2, mesh3.vbos);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh3.vbos[0]); 
-    glBufferData(GL_ARRAY_BUFFER, sizeof(ramekinVerts), ramekinVerts, GL_STATIC_DRAW);
-    mesh3.nIndices = sizeof(ramekinIndices) / sizeof(ramekinIndices[0]);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh3.vbos[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(ramekinIndices), ramekinIndices, GL_STATIC_DRAW);
-
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float) * floatsPerVertex));
-    glEnableVertexAttribArray(2);
-    // END THIRD SHAPE //
-
-    // BEGIN FOURTH SHAPE //
-    // RAMEKIN LIP (TORUS)
-    glGenVertexArrays(1, &mesh8.vao); 
-    glBindVertexArray(mesh8.vao); 
-
-    // Create 2 buffers
-    glGenBuffers(2, mesh8.vbos);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh8.vbos[0]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(ramekinLipVerts), ramekinLipVerts, GL_STATIC_DRAW);
-    mesh8.nIndices = sizeof(ramekinLipIndices) / sizeof(ramekinLipIndices[0]);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh8.vbos[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(ramekinLipIndices), ramekinLipIndices, GL_STATIC_DRAW);
-
-    // Create Vertex Attribute Pointers 
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float)* floatsPerVertex));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float)* floatsPerVertex));
-    glEnableVertexAttribArray(2);
-    // END FOURTH SHAPE //
-
-    // BEGIN FIFTH SHAPE
-    // VASE MOUTH (TORUS)
-    glGenVertexArrays(1, &mesh4.vao); 
-    glBindVertexArray(mesh4.vao); 
-
-    // Create 2 buffers
-    glGenBuffers(2, mesh4.vbos);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh4.vbos[0]); 
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float)*vaseMouthVerts.size(), vaseMouthVerts.data(), GL_STATIC_DRAW);
-    mesh4.nIndices = vaseMouthIndices.size(); // calculate the number of indices for a torus
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh4.vbos[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(GLushort)*vaseMouthIndices.size(), vaseMouthIndices.data(), GL_STATIC_DRAW);
-
-    // Create Vertex Attribute Pointers 
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float)* floatsPerVertex));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float)* floatsPerVertex));
-    glEnableVertexAttribArray(2);
-    //END FIFTH SHAPE //
-
-    // BEGIN SIXTH SHAPE
-    // VASE STEM (CYLINDER)
-    glGenVertexArrays(1, &mesh5.vao);
-    glBindVertexArray(mesh5.vao);
-    // Create 2 buffers
-    glGenBuffers(2, mesh5.vbos);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh5.vbos[0]); 
-    glBufferData(GL_ARRAY_BUFFER, sizeof(stemVerts), stemVerts, GL_STATIC_DRAW);
-    mesh5.nIndices = sizeof(stemIndices) / sizeof(stemIndices[0]);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh5.vbos[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(stemIndices), stemIndices, GL_STATIC_DRAW);
-
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, stride, 0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float)* floatsPerVertex));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float)* floatsPerVertex));
-    glEnableVertexAttribArray(2);
-    //END SIXTH SHAPE //
-
-    // BEGIN SEVENTH SHAPE
-    // VASE BASE (SPHERE)
-    glGenVertexArrays(1, &mesh6.vao); 
-    glBindVertexArray(mesh6.vao);
-
-    // Create 2 buffers
-    glGenBuffers(2, mesh6.vbos);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh6.vbos[0]); 
-    glBufferData(GL_ARRAY_BUFFER, vaseBase.getInterleavedVertexSize(), vaseBase.getInterleavedVertices(), GL_STATIC_DRAW); 
-    mesh6.nIndices = vaseBase.getIndexSize(); // calculate number of indices for a sphere
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh6.vbos[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, vaseBase.getIndexSize(), vaseBase.getIndices(), GL_STATIC_DRAW);
-
-    // Create Vertex Attribute Pointers 
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, sphereStride, 0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, sphereStride, (void*)(sizeof(float)* floatsPerVertex));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, sphereStride, (void*)(sizeof(float)* floatsPerVertex));
-    glEnableVertexAttribArray(2);
-    //END SEVENTH SHAPE //
-
-    //BEGIN EIGHT (FINAL) SHAPE //
-   // PLANE (table) generate VAOs
-    glGenVertexArrays(1, &mesh7.vao); 
-    glBindVertexArray(mesh7.vao); 
-
-    // Create 2 buffers
-    glGenBuffers(2, mesh7.vbos);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh7.vbos[0]);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(planeVerts), planeVerts, GL_STATIC_DRAW); 
-    mesh7.nIndices = sizeof(planeIndices) / sizeof(planeIndices[0]); // calculate number of indices for a plane
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh7.vbos[1]);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(planeIndices), planeIndices, GL_STATIC_DRAW);
-
-    // Create Vertex Attribute Pointers
-    glVertexAttribPointer(0, floatsPerVertex, GL_FLOAT, GL_FALSE, planeStride, 0);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(1, floatsPerNormal, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float)* floatsPerVertex));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(2, floatsPerUV, GL_FLOAT, GL_FALSE, stride, (void*)(sizeof(float)* floatsPerVertex));
-    glEnableVertexAttribArray(2);
-    //END FINAL SHAPE //
+// Converts generator output to the pool layout. normalOffset and uvOffset are float offsets inside a vertex,
+// a negative normalOffset gives +Z normals (the table's)
+vector<PoolVertex> UPoolVertices(const GLfloat* source, size_t vertexCount, int floatsPerVertex, int normalOffset, int uvOffset)
+{
+    vector<PoolVertex> vertices(vertexCount);
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        const GLfloat* src = source + i * floatsPerVertex;
+        PoolVertex& dst = vertices[i];
+        for (int k = 0; k < 3; ++k)
+        {
+            dst.position[k] = src[k];
+            dst.normal[k] = normalOffset >= 0 ? src[normalOffset + k] : (k == 2 ? 1.0f : 0.0f);
+        }
+        dst.uv[0] = src[uvOffset];
+        dst.uv[1] = src[uvOffset + 1];
+    }
+    return vertices;
 }
 
 
-void UDestroyMesh(GLMesh& mesh, GLMesh& mesh2, GLMesh& mesh3, GLMesh& mesh4, GLMesh& mesh5, GLMesh& mesh6, GLMesh& mesh7, GLMesh& mesh8)
+// Appends the next level of detail of a mesh to the geometry pool. The first level sets the bounds and
+// is drawn until the first LOD selection.
+void UAddPoolMesh(const PoolShape& shape)
 {
-    glDeleteVertexArrays(1, &mesh.vao); // BOWL
-    glDeleteBuffers(2, mesh.vbos);
+    GLMesh& mesh = *shape.mesh;
+    MeshLod& lod = mesh.lods[mesh.lodCount++];
+    lod.range = gGeometry.add(shape.getVertices(), shape.getVertexCount(), shape.getIndices(), shape.getIndexCount());
+    lod.error = shape.error;
+    if (mesh.lodCount == 1)
+        UComputeMeshBounds(mesh, shape.getVertices(), shape.getVertexCount());
+}
 
-    glDeleteVertexArrays(1, &mesh2.vao); // BOWL BASE
-    glDeleteBuffers(2, mesh2.vbos);
 
-    glDeleteVertexArrays(1, &mesh3.vao); // RAMEKIN
-    glDeleteBuffers(2, mesh3.vbos);
+// Uses patches instead of pool geometry for a mesh, its bounds come from the analytic shape
+void UAddTessellatedMesh(GLMesh& mesh, const PatchRange& patches)
+{
+    mesh.tessellated = true;
+    mesh.patches = patches;
+    mesh.center = glm::vec3(patches.center[0], patches.center[1], patches.center[2]);
+    mesh.radius = patches.radius;
+}
 
-    glDeleteVertexArrays(1, &mesh4.vao); // VASE MOUTH
-    glDeleteBuffers(2, mesh4.vbos);
 
-    glDeleteVertexArrays(1, &mesh5.vao); // VASE STEM
-    glDeleteBuffers(2, mesh5.vbos);
+// Bounding sphere around the box of the positions
+void UComputeMeshBounds(GLMesh& mesh, const PoolVertex* vertices, size_t vertexCount)
+{
+    glm::vec3 low(vertices[0].position[0], vertices[0].position[1], vertices[0].position[2]);
+    glm::vec3 high = low;
+    for (size_t i = 1; i < vertexCount; ++i)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            low[k] = min(low[k], vertices[i].position[k]);
+            high[k] = max(high[k], vertices[i].position[k]);
+        }
+    }
 
-    glDeleteVertexArrays(1, &mesh6.vao); // VASE BASE
-    glDeleteBuffers(2, mesh6.vbos);
+    mesh.center = (low + high) * 0.5f;
+    mesh.radius = 0.0f;
+    for (size_t i = 0; i < vertexCount; ++i)
+    {
+        const GLfloat* p = vertices[i].position;
+        mesh.radius = max(mesh.radius, glm::distance(mesh.center, glm::vec3(p[0], p[1], p[2])));
+    }
+}
 
-    glDeleteVertexArrays(1, &mesh7.vao); // TABLE
-    glDeleteBuffers(2, mesh7.vbos);
 
-    glDeleteVertexArrays(1, &mesh8.vao); // RAMEKIN LIP
-    glDeleteBuffers(2, mesh8.vbos);
+// The meshes are ranges of the pool or of the patches, releasing those releases all of them
+void UDestroyMesh(GLMesh& cylinder, GLMesh& torus, GLMesh& sphere, GLMesh& table)
+{
+    gGeometry.destroy(gResources);
+    if (gUseTessellation)
+        gTessShapes.destroy(gResources);
+}
 
+/*Create an immutable texture array with room for every mip level of every layer*/
+GLuint UCreateArrayTexture(GLenum internalFormat, int levels, int layers, const char* label)
+{
+    GLuint arrayId = gResources.createTexture(label);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, arrayId);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, internalFormat, MATERIAL_LAYER_SIZE, MATERIAL_LAYER_SIZE, layers);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return arrayId;
 }
 
-/*Generate and load the texture*/
-bool UCreateTexture(const char* filename, GLuint& textureId, char wrapType)
+
+/*Upload decoded pixels into level 0 of a layer, resampling them to the layer size*/
+bool UUploadMaterialLayer(const DecodedImage& decoded, GLuint arrayId, int layer)
 {
+    if (!decoded.pixels || decoded.channels != 4)
+    {
+        cout << "Not implemented to handle image with " << decoded.channels << " channels" << endl;
+        return false;
+    }
 
-    char wrap = wrapType;
-    int width, height, channels;
-    unsigned char* image = stbi_load(filename, &width, &height, &channels, 0);
-    if (image)
+    const unsigned char* pixels = decoded.pixels;
+    vector<unsigned char> resampled;
+    if (decoded.width != MATERIAL_LAYER_SIZE || decoded.height != MATERIAL_LAYER_SIZE)
     {
-        flipImageVertically(image, width, height, channels);
+        resampled.resize((size_t)MATERIAL_LAYER_SIZE * MATERIAL_LAYER_SIZE * 4);
+        UResampleRGBA(decoded.pixels, decoded.width, decoded.height, resampled.data(), MATERIAL_LAYER_SIZE, MATERIAL_LAYER_SIZE);
+        pixels = resampled.data();
+    }
+
+    glBindTexture(GL_TEXTURE_2D_ARRAY, arrayId);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, MATERIAL_LAYER_SIZE, MATERIAL_LAYER_SIZE, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return true;
+}
 
-        glGenTextures(1, &textureId);
-        glBindTexture(GL_TEXTURE_2D, textureId);
 
-        if (wrap == 'm') // mirrored repeat wrapping method
+/*GL format of a cooked texture, false if the driver cannot sample it*/
+bool UCookedInternalFormat(const CookedTextureHeader& header, const char* cookedFile, GLenum& internalFormat)
+{
+    internalFormat = GL_RGBA8;
+    if (header.format == COOKED_FORMAT_BC1)
+    {
+        if (!GLEW_EXT_texture_compression_s3tc)
         {
-            // set the texture wrapping parameters
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
-            // set texture filtering parameters
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            cout << "WARNING: " << cookedFile << " needs S3TC support, falling back to the image" << endl;
+            return false;
         }
-
-        else if (wrap == 'c') // clamp to edge wrapping method
+        internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    }
+    else if (header.format == COOKED_FORMAT_BC7)
+    {
+        if (!GLEW_VERSION_4_2 && !GLEW_ARB_texture_compression_bptc)
         {
-            // set the texture wrapping parameters
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-            // set texture filtering parameters
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            cout << "WARNING: " << cookedFile << " needs BPTC support, falling back to the image" << endl;
+            return false;
         }
+        internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+    return true;
+}
+
 
-        if (channels == 3)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, image);
-        else if (channels == 4)
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image);
+/*Copy every level of a cooked texture into a layer, no decoding or mipmap generation*/
+void UUploadCookedMaterialLayer(const CookedTexture& cooked, GLenum internalFormat, GLuint arrayId, int layer)
+{
+    // RGBA8 levels have 4 byte rows, so the default unpack alignment applies
+    glBindTexture(GL_TEXTURE_2D_ARRAY, arrayId);
+    for (uint32_t i = 0; i < cooked.getHeader().levelCount; ++i)
+    {
+        const CookedTextureLevel& level = cooked.getLevel(i);
+        if (internalFormat == GL_RGBA8)
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, layer, level.width, level.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, cooked.getLevelData(i));
         else
+            glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, layer, level.width, level.height, 1, internalFormat, (GLsizei)level.size, cooked.getLevelData(i));
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+
+/*Create the sampler used with the material array. It clamps, the shader applies mirrored repeat itself*/
+void UCreateMaterialSampler()
+{
+    gMaterialSampler = gResources.createSampler("material sampler");
+    glSamplerParameteri(gMaterialSampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glSamplerParameteri(gMaterialSampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    USetSamplerFiltering(gLinearFiltering);
+}
+
+
+/*Set the filter parameters of the sampler, the texture keeps its storage*/
+void USetSamplerFiltering(bool linear)
+{
+    gLinearFiltering = linear;
+    glSamplerParameteri(gMaterialSampler, GL_TEXTURE_MIN_FILTER, linear ? GL_LINEAR_MIPMAP_LINEAR : GL_NEAREST_MIPMAP_NEAREST);
+    glSamplerParameteri(gMaterialSampler, GL_TEXTURE_MAG_FILTER, linear ? GL_LINEAR : GL_NEAREST);
+}
+
+
+/*Bind the material array and its sampler to texture unit 0, once for all draws*/
+void UBindMaterials()
+{
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, gMaterialArray);
+    glBindSampler(0, gMaterialSampler);
+}
+
+
+/*Select the layer, wrap mode and resident mip levels for the next draw, the only per-draw material state*/
+void USetMaterial(SceneTexture material, GLint location)
+{
+    int layer = gMaterials[material].layer;
+    glUniform3i(location, layer, gMaterials[material].wrap, UResidentMipLevel(layer));
+}
+
+
+/*Finest mip level of a layer the shader may sample*/
+int UResidentMipLevel(int layer)
+{
+    return gStreamTextures ? gTextureStreamer.getResidentLevel(layer) : 0;
+}
+
+
+// 64-bit FNV-1a of a file's bytes, identifies images independently of their path
+bool UHashFile(const char* filename, unsigned long long& hash)
+{
+    MappedFile file;
+    if (!file.open(filename))
+        return false;
+
+    hash = 14695981039346656037ull;
+    const unsigned char* bytes = file.getData();
+    for (size_t i = 0; i < file.getSize(); ++i)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+    return true;
+}
+
+
+// Returns the material array layer holding filename, assigning a new layer on the first lookup of its contents.
+// Returns -1 if the file cannot be read.
+int UGetMaterialLayer(const char* filename)
+{
+    map<string, int>::const_iterator it = gTextureCache.byPath.find(filename);
+    if (it != gTextureCache.byPath.end())
+    {
+        ++gTextureCache.hits;
+        return it->second;
+    }
+
+    unsigned long long hash = 0;
+    if (!UHashFile(filename, hash))
+    {
+        ++gTextureCache.failures;
+        cout << "Failed to load texture " << filename << endl;
+        return -1;
+    }
+
+    map<unsigned long long, int>::const_iterator same = gTextureCache.byContent.find(hash);
+    if (same != gTextureCache.byContent.end())
+    {
+        ++gTextureCache.contentHits;
+        gTextureCache.byPath[filename] = same->second;
+        return same->second;
+    }
+
+    int layer = (int)gTextureCache.layerFiles.size();
+    gTextureCache.layerFiles.push_back(filename);
+    gTextureCache.byPath[filename] = layer;
+    gTextureCache.byContent[hash] = layer;
+    return layer;
+}
+
+
+// Loads all scene textures at startup into the material array
+bool ULoadTextures()
+{
+    // one layer per distinct image
+    bool success = true;
+    for (int i = 0; i < gNumTextureRequests; ++i)
+    {
+        const TextureRequest& request = gTextureRequests[i];
+        int layer = UGetMaterialLayer(request.filename);
+        success = layer >= 0 && success;
+        gMaterials[request.slot].layer = max(layer, 0);
+        gMaterials[request.slot].wrap = request.wrapType == 'c' ? 1 : 0;
+    }
+
+    const vector<string>& files = gTextureCache.layerFiles;
+    if (files.empty())
+        return false;
+
+    // Cooked files are copied straight into their layers when every layer has one at the layer size,
+    // all in the same format. Otherwise the images are decoded and the mip chain is generated.
+    vector<CookedTexture> cooked(files.size());
+    GLenum internalFormat = GL_RGBA8;
+    bool useCooked = true;
+    for (size_t i = 0; i < files.size() && useCooked; ++i)
+    {
+        string cookedFile = UCookedTexturePath(files[i].c_str());
+        GLenum format = GL_RGBA8;
+        useCooked = cooked[i].open(cookedFile.c_str())
+            && cooked[i].getHeader().width == (uint32_t)MATERIAL_LAYER_SIZE && cooked[i].getHeader().height == (uint32_t)MATERIAL_LAYER_SIZE
+            && UCookedInternalFormat(cooked[i].getHeader(), cookedFile.c_str(), format)
+            && (i == 0 || format == internalFormat);
+        internalFormat = format;
+    }
+    if (!useCooked)
+        internalFormat = GL_RGBA8;
+
+    int levelCount = UMipLevelCount(MATERIAL_LAYER_SIZE, MATERIAL_LAYER_SIZE);
+    int layerCount = (int)files.size();
+
+    // Streaming reads the levels straight from the cooked files
+    if (gStreamTextures && !useCooked)
+    {
+        cout << "WARNING: Texture streaming needs cooked textures (run with --cook), loading every mip level" << endl;
+        gStreamTextures = false;
+    }
+    if (gStreamTextures)
+    {
+        vector<string> cookedFiles;
+        for (size_t i = 0; i < files.size(); ++i)
+            cookedFiles.push_back(UCookedTexturePath(files[i].c_str()));
+
+        gMaterialArray = gTextureStreamer.create(gResources, cookedFiles, internalFormat, gTextureBudget);
+        gTextureCache.loads = layerCount;
+        cout << "INFO: Streaming " << layerCount << " material layers, " << gTextureStreamer.getStats().residentBytes / 1024
+             << " KB resident at startup, " << gTextureBudget / 1024 << " KB budget"
+             << (gTextureStreamer.isSparse() ? " (sparse)" : " (fully allocated, no ARB_sparse_texture)") << endl;
+        return gMaterialArray != 0 && success;
+    }
+
+    gMaterialArray = UCreateArrayTexture(internalFormat, levelCount, layerCount, "material array");
+
+    size_t bytes = 0, uncompressedBytes = 0;
+    if (useCooked)
+    {
+        for (int i = 0; i < layerCount; ++i)
         {
-            cout << "Not implemented to handle image with " << channels << " channels" << endl;
-            return false;
+            UUploadCookedMaterialLayer(cooked[i], internalFormat, gMaterialArray, i);
+            for (uint32_t level = 0; level < cooked[i].getHeader().levelCount; ++level)
+            {
+                bytes += (size_t)cooked[i].getLevel(level).size;
+                uncompressedBytes += (size_t)cooked[i].getLevel(level).width * cooked[i].getLevel(level).height * 4;
+            }
         }
+        cout << "INFO: Uploaded " << layerCount << " cooked material layers" << endl;
+    }
+    else
+    {
+        // decoded once each on the worker pool, only the GL uploads stay on this thread
+        vector<DecodedImage> images(files.size());
+        for (size_t i = 0; i < files.size(); ++i)
+            images[i].filename = files[i];
 
-        glGenerateMipmap(GL_TEXTURE_2D);
+        double wallSeconds = UDecodeImagesParallel(images);
+        cout << "INFO: Decoded " << images.size() << " textures in " << wallSeconds * 1000.0
+             << " ms wall-clock (--bench-decode-threads compares against one thread)" << endl;
 
-        stbi_image_free(image);
-        glBindTexture(GL_TEXTURE_2D, 0); // Unbind the texture
+        for (int i = 0; i < layerCount; ++i)
+        {
+            bool loaded = UUploadMaterialLayer(images[i], gMaterialArray, i);
+            if (!loaded)
+            {
+                ++gTextureCache.failures;
+                cout << "Failed to load texture " << files[i] << endl;
+            }
+            success = loaded && success;
+            UFreeDecodedImage(images[i]);
+        }
 
-        return true;
+        glBindTexture(GL_TEXTURE_2D_ARRAY, gMaterialArray);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+        // the full mip chain adds a third on top of level 0
+        bytes = uncompressedBytes = (size_t)MATERIAL_LAYER_SIZE * MATERIAL_LAYER_SIZE * 4 * 4 / 3 * layerCount;
     }
+    gTextureCache.loads = layerCount;
 
-    // Error loading the image
-    return false;
+    gResources.setSize(GL_RESOURCE_TEXTURE, gMaterialArray, bytes);
+    gTextureBytes += bytes;
+    gTextureBytesUncompressed += uncompressedBytes;
+
+    cout << "INFO: Texture memory: " << gTextureBytes / 1024 << " KB (" << gTextureBytesUncompressed / 1024 << " KB as RGBA8, "
+         << (gTextureBytesUncompressed - gTextureBytes) / 1024 << " KB saved by block compression)" << endl;
+
+    cout << "INFO: Texture cache: " << gTextureCache.loads << " loads, " << gTextureCache.hits << " hits, "
+         << gTextureCache.contentHits << " content hits, " << gTextureCache.failures << " failures" << endl;
+
+    return success;
 }
 
 
-void UDestroyTexture(GLuint textureId)
+// Pixels a mesh space unit covers at the centre of a mesh's bounding sphere, modelView includes the
+// draw's transform. Returns -1 if the mesh is behind the camera and FLT_MAX if the camera is inside its bounds.
+float UPixelsPerUnit(const GLMesh& mesh, const glm::mat4& modelView, const glm::mat4& projection, int viewportHeight)
 {
-    glGenTextures(1, &textureId);
+    glm::vec4 center = modelView * glm::vec4(mesh.center, 1.0f);
+    float scale = max(glm::length(glm::vec3(modelView[0])), max(glm::length(glm::vec3(modelView[1])), glm::length(glm::vec3(modelView[2]))));
+    float radius = mesh.radius * scale;
+
+    // perspective projections divide by the view depth, orthographic ones keep w = 1
+    float w = 1.0f;
+    if (projection[2][3] != 0.0f)
+    {
+        if (center.z - radius >= 0.0f)
+            return -1.0f;
+        w = -center.z;
+        if (w <= radius)
+            return FLT_MAX;
+    }
+    return scale * projection[1][1] / w * viewportHeight * 0.5f;
 }
 
-// Implements the UCreateShaders function
-bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId)
+
+// Finest mip level a mesh needs: the texels across its material (repeated uvScale times)
+// against the pixels its bounding sphere covers on screen. Returns -1 if the mesh is behind the camera.
+int UWantedTextureLevel(const GLMesh& mesh, const glm::mat4& modelView, const glm::mat4& projection, int viewportHeight)
 {
-    // Compilation and linkage error reporting
-    int success = 0;
-    char infoLog[512];
+    float pixelsPerUnit = UPixelsPerUnit(mesh, modelView, projection, viewportHeight);
+    if (pixelsPerUnit < 0.0f)
+        return -1;
+    if (pixelsPerUnit == FLT_MAX)
+        return 0;
+
+    float pixels = max(2.0f * mesh.radius * pixelsPerUnit, 1.0f);
+    float texels = MATERIAL_LAYER_SIZE * max(gUVScale.x, gUVScale.y);
+    return texels > pixels ? (int)floor(log2(texels / pixels)) : 0;
+}
 
-    // Create a Shader program object.
-    programId = glCreateProgram();
 
-    // Create the vertex and fragment shader objects
-    GLuint vertexShaderId = glCreateShader(GL_VERTEX_SHADER);
-    GLuint fragmentShaderId = glCreateShader(GL_FRAGMENT_SHADER);
+// Picks every scene draw's level of detail from its mesh's error projected to pixels, scaled by the draw's
+// transform. Draws behind the camera keep their level. Finer levels are taken as soon as the error exceeds
+// gLodPixelError, coarser ones only below LOD_HYSTERESIS of it.
+void USelectLods(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection)
+{
+    int width = 0, height = 0;
+    glfwGetFramebufferSize(gWindow, &width, &height);
 
-    // Retrive the shader source
-    glShaderSource(vertexShaderId, 1, &vtxShaderSource, NULL);
-    glShaderSource(fragmentShaderId, 1, &fragShaderSource, NULL);
+    glm::mat4 modelView = view * model;
+    for (int i = 0; i < gNumSceneDraws; ++i)
+    {
+        SceneDraw& draw = gSceneDraws[i];
+        const GLMesh& mesh = *draw.mesh;
+        int lod = 0;
+        if (gUseLods)
+        {
+            float pixelsPerUnit = UPixelsPerUnit(mesh, modelView * draw.transform, projection, height);
+            if (pixelsPerUnit < 0.0f)
+                continue;
+            lod = draw.lod;
+            while (lod > 0 && mesh.lods[lod].error * pixelsPerUnit > gLodPixelError)
+                --lod;
+            while (lod + 1 < mesh.lodCount && mesh.lods[lod + 1].error * pixelsPerUnit <= gLodPixelError * LOD_HYSTERESIS)
+                ++lod;
+        }
+        if (lod != draw.lod)
+        {
+            draw.lod = lod;
+            ++gTriangleStats.lodSwitches;
+        }
+    }
+}
 
-    // Compile the vertex shader, and print compilation errors (if any)
-    glCompileShader(vertexShaderId); // compile the vertex shader
-    // check for shader compile errors
-    glGetShaderiv(vertexShaderId, GL_COMPILE_STATUS, &success);
-    if (!success)
+
+// Asks the streamer for the detail every draw of this frame needs, then lets it upload and evict
+void UStreamTextures(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection)
+{
+    if (!gStreamTextures)
+        return;
+
+    int width = 0, height = 0;
+    glfwGetFramebufferSize(gWindow, &width, &height);
+
+    glm::mat4 modelView = view * model;
+    for (int i = 0; i < gNumSceneDraws; ++i)
     {
-        glGetShaderInfoLog(vertexShaderId, 512, NULL, infoLog);
-        std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+        int level = UWantedTextureLevel(*gSceneDraws[i].mesh, modelView * gSceneDraws[i].transform, projection, height);
+        if (level >= 0)
+            gTextureStreamer.requestLevel(gMaterials[gSceneDraws[i].material].layer, level);
+    }
+    gTextureStreamer.update(gResources);
+}
 
-        return false;
+
+// Distinct image files used by the scene
+vector<string> USceneTextureFiles()
+{
+    vector<string> files;
+    for (int i = 0; i < gNumTextureRequests; ++i)
+    {
+        if (find(files.begin(), files.end(), gTextureRequests[i].filename) == files.end())
+            files.push_back(gTextureRequests[i].filename);
     }
+    return files;
+}
+
+
+// Offline cooker: writes a .sltex next to every scene image, resampled to the material layer size
+bool UCookTextures(CookedTextureFormat format)
+{
+    vector<string> files = USceneTextureFiles();
+    bool success = true;
+    for (size_t i = 0; i < files.size(); ++i)
+        success = UCookTexture(files[i].c_str(), UCookedTexturePath(files[i].c_str()).c_str(), format, MATERIAL_LAYER_SIZE) && success;
+    return success;
+}
+
+
+// Startup benchmark: loads every scene texture from the original image and from its cooked file
+void UBenchmarkTextureLoading()
+{
+    vector<string> files = USceneTextureFiles();
+    double imageTotal = 0.0, cookedTotal = 0.0;
+    bool allCooked = true;
+
+    cout << "INFO: Texture loading benchmark (decode + upload + mipmaps into a one layer array, GL finished)" << endl;
+    int levelCount = UMipLevelCount(MATERIAL_LAYER_SIZE, MATERIAL_LAYER_SIZE);
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        glFinish();
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        DecodedImage image;
+        image.filename = files[i];
+        if (UDecodeImage(image))
+        {
+            GLuint arrayId = UCreateArrayTexture(GL_RGBA8, levelCount, 1, "benchmark layer");
+            UUploadMaterialLayer(image, arrayId, 0);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, arrayId);
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+            glFinish();
+            gResources.destroy(GL_RESOURCE_TEXTURE, arrayId);
+        }
+        UFreeDecodedImage(image);
+        double imageSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        string cookedFile = UCookedTexturePath(files[i].c_str());
+        start = chrono::steady_clock::now();
+        CookedTexture cookedTexture;
+        GLenum internalFormat = GL_RGBA8;
+        bool cooked = cookedTexture.open(cookedFile.c_str()) && cookedTexture.getHeader().width == (uint32_t)MATERIAL_LAYER_SIZE
+            && cookedTexture.getHeader().height == (uint32_t)MATERIAL_LAYER_SIZE && UCookedInternalFormat(cookedTexture.getHeader(), cookedFile.c_str(), internalFormat);
+        if (cooked)
+        {
+            GLuint arrayId = UCreateArrayTexture(internalFormat, cookedTexture.getHeader().levelCount, 1, "benchmark layer");
+            UUploadCookedMaterialLayer(cookedTexture, internalFormat, arrayId, 0);
+            glFinish();
+            gResources.destroy(GL_RESOURCE_TEXTURE, arrayId);
+        }
+        double cookedSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        cout << "    " << files[i] << ": image " << imageSeconds * 1000.0 << " ms, cooked ";
+        if (cooked)
+            cout << cookedSeconds * 1000.0 << " ms" << endl;
+        else
+            cout << "n/a (run with --cook)" << endl;
+
+        imageTotal += imageSeconds;
+        cookedTotal += cookedSeconds;
+        allCooked = allCooked && cooked;
+    }
+
+    cout << "    total: image " << imageTotal * 1000.0 << " ms";
+    if (allCooked)
+        cout << ", cooked " << cookedTotal * 1000.0 << " ms (" << (cookedTotal > 0.0 ? imageTotal / cookedTotal : 0.0) << "x)";
+    cout << endl;
+}
+
+
+// Timer queries around the scene draws, results are read a frame later so the CPU never waits on them
+void UCreateGpuTimer(GpuTimer& timer)
+{
+    glGenQueries(2, timer.queries);
+    timer.frame = 0;
+    timer.totalMs = 0.0;
+    timer.samples = 0;
+}
+
+
+void UBeginGpuTimer(GpuTimer& timer)
+{
+    glBeginQuery(GL_TIME_ELAPSED, timer.queries[timer.frame & 1]);
+}
+
+
+void UEndGpuTimer(GpuTimer& timer)
+{
+    glEndQuery(GL_TIME_ELAPSED);
+    ++timer.frame;
+
+    // collect the previous frame's query if the GPU is done with it
+    if (timer.frame >= 2)
+    {
+        GLuint previous = timer.queries[timer.frame & 1];
+        GLint available = 0;
+        glGetQueryObjectiv(previous, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (available)
+        {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(previous, GL_QUERY_RESULT, &nanoseconds);
+            timer.totalMs += nanoseconds / 1.0e6;
+            ++timer.samples;
+        }
+    }
+}
+
+
+void UDestroyGpuTimer(GpuTimer& timer)
+{
+    if (timer.samples > 0)
+        cout << "INFO: Scene draws took " << timer.totalMs / timer.samples << " ms of GPU time per frame (" << timer.samples << " frames)" << endl;
+    glDeleteQueries(2, timer.queries);
+}
+
+
+// Releases the material array and its sampler
+void UDestroyTextureCache()
+{
+    cout << "INFO: Texture cache: " << gTextureCache.loads << " loads, " << gTextureCache.hits << " hits, "
+         << gTextureCache.contentHits << " content hits, " << gTextureCache.failures << " failures" << endl;
+
+    if (gStreamTextures)
+    {
+        gTextureStreamer.printStats(cout);
+        gTextureStreamer.destroy(gResources);
+    }
+    else
+        gResources.destroy(GL_RESOURCE_TEXTURE, gMaterialArray);
+    gResources.destroy(GL_RESOURCE_SAMPLER, gMaterialSampler);
+    gMaterialArray = gMaterialSampler = 0;
+
+    gTextureCache.byContent.clear();
+    gTextureCache.byPath.clear();
+    gTextureCache.layerFiles.clear();
+}
+
+// Implements the UCreateShaders function
+// Compiles one shader stage and prints its log if compilation fails
+bool UCompileShader(GLenum type, const char* source, const char* stageName, GLuint& shaderId)
+{
+    int success = 0;
+    char infoLog[512];
+
+    shaderId = glCreateShader(type);
+    glShaderSource(shaderId, 1, &source, NULL);
+    glCompileShader(shaderId);
 
-    glCompileShader(fragmentShaderId); // compile the fragment shader
     // check for shader compile errors
-    glGetShaderiv(fragmentShaderId, GL_COMPILE_STATUS, &success);
+    glGetShaderiv(shaderId, GL_COMPILE_STATUS, &success);
     if (!success)
     {
-        glGetShaderInfoLog(fragmentShaderId, sizeof(infoLog), NULL, infoLog);
-        std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+        glGetShaderInfoLog(shaderId, sizeof(infoLog), NULL, infoLog);
+        std::cout << "ERROR::SHADER::" << stageName << "::COMPILATION_FAILED\n" << infoLog << std::endl;
+        glDeleteShader(shaderId);
+        shaderId = 0;
 
         return false;
     }
+    return true;
+}
+
+
+// Vertex and fragment stages, plus the tessellation stages when both of their sources are given
+bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSource, GLuint& programId,
+                          const char* tessControlSource, const char* tessEvaluationSource)
+{
+    // Compilation and linkage error reporting
+    int success = 0;
+    char infoLog[512];
+
+    // Create a Shader program object.
+    programId = gResources.createProgram("shader program");
+
+    // Compile every stage, and print compilation errors (if any)
+    struct Stage
+    {
+        GLenum type;
+        const char* source;
+        const char* name;
+        GLuint id;
+    };
+    Stage stages[] = {
+        { GL_VERTEX_SHADER, vtxShaderSource, "VERTEX", 0 },
+        { GL_TESS_CONTROL_SHADER, tessControlSource, "TESS_CONTROL", 0 },
+        { GL_TESS_EVALUATION_SHADER, tessEvaluationSource, "TESS_EVALUATION", 0 },
+        { GL_FRAGMENT_SHADER, fragShaderSource, "FRAGMENT", 0 }
+    };
+    bool compiled = true;
+    for (Stage& stage : stages)
+    {
+        if (stage.source && compiled)
+            compiled = UCompileShader(stage.type, stage.source, stage.name, stage.id);
+    }
 
     // Attached compiled shaders to the shader program
-    glAttachShader(programId, vertexShaderId);
-    glAttachShader(programId, fragmentShaderId);
+    for (Stage& stage : stages)
+    {
+        if (stage.id && compiled)
+            glAttachShader(programId, stage.id);
+    }
+    if (compiled)
+        glLinkProgram(programId);   // links the shader program
+
+    // The program keeps the compiled code, the shader objects are no longer needed
+    for (Stage& stage : stages)
+    {
+        if (stage.id)
+            glDeleteShader(stage.id);
+    }
+    if (!compiled)
+        return false;
 
-    glLinkProgram(programId);   // links the shader program
     // check for linking errors
     glGetProgramiv(programId, GL_LINK_STATUS, &success);
     if (!success)
@@ -1256,6 +2574,6 @@ bool UCreateShaderProgram(const char* vtxShaderSource, const char* fragShaderSou
 
 void UDestroyShaderProgram(GLuint programId)
 {
-    glDeleteProgram(programId);
+    gResources.destroy(GL_RESOURCE_PROGRAM, programId);
 }
 
@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+
+#include "StreamBuffer.h"
+
+using namespace std;
+
+
+bool UStreamBufferSupported()
+{
+    return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+}
+
+
+bool StreamBuffer::create(GLResourceRegistry& resources, const char* label, size_t bytesPerRegion)
+{
+    registry = &resources;
+    regionBytes = bytesPerRegion;
+    buffer = resources.createBuffer(label);
+
+    // coherent: writes become visible to the GPU without explicit flushes
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    size_t bytes = regionBytes * STREAM_BUFFER_REGIONS;
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, bytes, nullptr, flags);
+    mapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, bytes, flags);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    if (!mapped)
+    {
+        cout << "ERROR: Could not map the " << label << " stream buffer" << endl;
+        destroy(resources);
+        return false;
+    }
+    resources.setSize(GL_RESOURCE_BUFFER, buffer, bytes);
+
+    region = STREAM_BUFFER_REGIONS - 1;
+    used = 0;
+    stats = StreamBufferStats();
+    return true;
+}
+
+
+void StreamBuffer::destroy(GLResourceRegistry& resources)
+{
+    for (GLsync& fence : fences)
+    {
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+    if (mapped)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        mapped = nullptr;
+    }
+    resources.destroy(GL_RESOURCE_BUFFER, buffer);
+    buffer = 0;
+}
+
+
+void StreamBuffer::beginFrame()
+{
+    if (!mapped)
+        return;
+    region = (region + 1) % STREAM_BUFFER_REGIONS;
+    used = 0;
+
+    // polled first, the flush makes sure a wait can finish
+    GLsync& fence = fences[region];
+    if (fence && glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+            ;
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        ++stats.fenceWaits;
+        stats.waitMs += ms;
+        stats.maxWaitMs = max(stats.maxWaitMs, ms);
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+
+StreamAllocation StreamBuffer::allocate(size_t bytes, size_t alignment)
+{
+    StreamAllocation allocation;
+    if (!mapped)
+        return allocation;
+
+    size_t first = region * regionBytes;
+    size_t offset = (first + used + alignment - 1) / alignment * alignment;
+    if (offset + bytes > first + regionBytes)
+    {
+        ++stats.overflows;
+        return allocation;
+    }
+    used = offset + bytes - first;
+    allocation.data = mapped + offset;
+    allocation.buffer = buffer;
+    allocation.offset = (GLintptr)offset;
+    return allocation;
+}
+
+
+void StreamBuffer::endFrame()
+{
+    if (!mapped)
+        return;
+    glDeleteSync(fences[region]);
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ++stats.frames;
+    stats.peakFrameBytes = max(stats.peakFrameBytes, used);
+}
+
+
+void StreamBuffer::printStats(ostream& out, const char* label) const
+{
+    out << "INFO: " << label << " stream buffer: " << STREAM_BUFFER_REGIONS << " x " << regionBytes / 1024 << " KB regions, peak "
+        << stats.peakFrameBytes / 1024 << " KB per frame, " << stats.fenceWaits << " fence waits in " << stats.frames << " frames";
+    if (stats.fenceWaits > 0)
+        out << " (" << stats.waitMs << " ms total, " << stats.maxWaitMs << " ms max)";
+    out << ", " << stats.overflows << " overflows" << endl;
+}
@@ -0,0 +1,81 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <cstddef>
+#include <ostream>
+#include <GL/glew.h>
+
+#include "GLResources.h"
+
+// Frames a stream buffer rotates through, the CPU may run this many frames minus one ahead of the GPU
+const int STREAM_BUFFER_REGIONS = 3;
+
+// Counters reported by a stream buffer
+struct StreamBufferStats
+{
+    unsigned int frames = 0;
+    unsigned int fenceWaits = 0;    // frames that found their region still in use by the GPU
+    double waitMs = 0.0;            // blocked in those waits
+    double maxWaitMs = 0.0;
+    unsigned int overflows = 0;     // allocations that did not fit in their frame's region
+    size_t peakFrameBytes = 0;
+};
+
+// A slice of the current frame's region. data is mapped write-only memory the GPU reads from buffer at offset;
+// write whole records and never read it back, most drivers map it write-combined. Null when the region is full.
+struct StreamAllocation
+{
+    void* data = nullptr;
+    GLuint buffer = 0;
+    GLintptr offset = 0;
+};
+
+// Whether the driver has immutable buffer storage (GL 4.4) for persistent mappings
+bool UStreamBufferSupported();
+
+// Per-frame dynamic data written by the CPU straight into memory the GPU reads. One buffer is allocated with
+// glBufferStorage and stays mapped (persistent and coherent) for its whole life, split into
+// STREAM_BUFFER_REGIONS regions that the frames use in turn. Systems sub-allocate from the current region
+// and bind the buffer at the returned offset. endFrame puts a fence behind the frame's commands and
+// beginFrame waits on the fence of the region it reuses, which only blocks when the GPU is that many frames
+// behind, so writes never race the GPU and there are no driver copies or implicit synchronization.
+class StreamBuffer
+{
+public:
+    StreamBuffer() {}
+    ~StreamBuffer() {}
+
+    // Returns false if the storage cannot be created or mapped
+    bool create(GLResourceRegistry& resources, const char* label, size_t regionBytes);
+    void destroy(GLResourceRegistry& resources);
+
+    // Moves to the next region, before the frame's first allocation
+    void beginFrame();
+    // offset is a multiple of alignment, which need not be a power of two
+    StreamAllocation allocate(size_t bytes, size_t alignment);
+    // Fences the region, after the frame's last command that reads from it
+    void endFrame();
+
+    bool isCreated() const                  { return mapped != nullptr; }
+    GLuint getBuffer() const                { return buffer; }
+    size_t getRegionBytes() const           { return regionBytes; }
+    const StreamBufferStats& getStats() const { return stats; }
+    void resetStats()                       { stats = StreamBufferStats(); }
+
+    void printStats(std::ostream& out, const char* label) const;
+
+private:
+    StreamBuffer(const StreamBuffer&);              // not copyable, owns the mapping and fences
+    StreamBuffer& operator=(const StreamBuffer&);
+
+    GLResourceRegistry* registry = nullptr;
+    GLuint buffer = 0;
+    unsigned char* mapped = nullptr;
+    size_t regionBytes = 0;
+    int region = STREAM_BUFFER_REGIONS - 1;     // the first beginFrame moves to region 0
+    size_t used = 0;                            // bytes allocated from the current region
+    GLsync fences[STREAM_BUFFER_REGIONS] = {};
+    StreamBufferStats stats;
+};
+
+#endif
@@ -0,0 +1,167 @@
+#include <cmath>
+
+#include "GLCallCounter.h"
+#include "TessellatedShapes.h"
+
+using namespace std;
+
+namespace
+{
+    const int PATCHES_PER_TURN = 4;
+}
+
+
+bool UTessellationSupported()
+{
+    return GLEW_VERSION_4_0 || GLEW_ARB_tessellation_shader;
+}
+
+
+float UTessSegments(float radius, float turns, float pixelsPerUnit, float maxPixelError)
+{
+    if (radius <= 0.0f || turns <= 0.0f)
+        return 1.0f;
+    float pixels = radius * pixelsPerUnit;
+    float segments = ceil(3.14159265f * sqrt(pixels / (2.0f * maxPixelError)) * turns);
+    return segments < 1.0f ? 1.0f : (segments > 64.0f ? 64.0f : segments);
+}
+
+
+void TessellatedShapes::create(GLResourceRegistry& resources)
+{
+    registry = &resources;
+    vao = resources.createVertexArray("tessellated shapes");
+    vbo = resources.createBuffer("tessellation patches");
+
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(TessPatch), (void*)offsetof(TessPatch, origin));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(TessPatch), (void*)offsetof(TessPatch, shape));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(TessPatch), (void*)offsetof(TessPatch, range));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(TessPatch), (void*)offsetof(TessPatch, detail));
+    glEnableVertexAttribArray(3);
+    glVertexAttribIPointer(4, 1, GL_INT, sizeof(TessPatch), (void*)offsetof(TessPatch, kind));
+    glEnableVertexAttribArray(4);
+    glBindVertexArray(0);
+}
+
+
+void TessellatedShapes::destroy(GLResourceRegistry& resources)
+{
+    resources.destroy(GL_RESOURCE_VERTEX_ARRAY, vao);
+    resources.destroy(GL_RESOURCE_BUFFER, vbo);
+    vao = vbo = 0;
+    patches.clear();
+}
+
+
+PatchRange TessellatedShapes::addCylinder(float cx, float cy, float z, float r, float length)
+{
+    PatchRange range;
+    range.first = (GLint)patches.size();
+
+    // the cap further along +Z faces +Z, the other one -Z
+    const GLfloat origin[3] = { cx, cy, 0.0f };
+    const GLfloat side[3] = { r, z, length };
+    const GLfloat firstCap[3] = { r, z, z >= length ? 1.0f : -1.0f };
+    const GLfloat secondCap[3] = { r, length, z >= length ? -1.0f : 1.0f };
+    addQuarterTurns(TESS_CYLINDER_SIDE, origin, side, r, 0.0f, 0.0f);
+    addQuarterTurns(TESS_DISK, origin, firstCap, r, 0.0f, 0.0f);
+    addQuarterTurns(TESS_DISK, origin, secondCap, r, 0.0f, 0.0f);
+
+    range.count = (GLsizei)patches.size() - range.first;
+    float halfLength = fabsf(length - z) * 0.5f;
+    range.center[0] = cx;
+    range.center[1] = cy;
+    range.center[2] = (z + length) * 0.5f;
+    range.radius = sqrtf(r * r + halfLength * halfLength);
+    return range;
+}
+
+
+PatchRange TessellatedShapes::addTorus(float x, float y, float z, float tubeRadius, float ringRadius)
+{
+    PatchRange range;
+    range.first = (GLint)patches.size();
+
+    // each quarter of the ring holds the whole tube
+    const GLfloat origin[3] = { x, y, z };
+    const GLfloat shape[3] = { tubeRadius, ringRadius, 0.0f };
+    addQuarterTurns(TESS_TORUS, origin, shape, ringRadius + tubeRadius, tubeRadius, 1.0f);
+
+    range.count = (GLsizei)patches.size() - range.first;
+    range.center[0] = x;
+    range.center[1] = y;
+    range.center[2] = z;
+    range.radius = ringRadius + tubeRadius;
+    return range;
+}
+
+
+PatchRange TessellatedShapes::addSphere(float x, float y, float z, float radius)
+{
+    PatchRange range;
+    range.first = (GLint)patches.size();
+
+    // v runs pole to pole, half a turn
+    const GLfloat origin[3] = { x, y, z };
+    const GLfloat shape[3] = { radius, 0.0f, 0.0f };
+    addQuarterTurns(TESS_SPHERE, origin, shape, radius, radius, 0.5f);
+
+    range.count = (GLsizei)patches.size() - range.first;
+    range.center[0] = x;
+    range.center[1] = y;
+    range.center[2] = z;
+    range.radius = radius;
+    return range;
+}
+
+
+void TessellatedShapes::upload()
+{
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, getByteSize(), patches.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    registry->setSize(GL_RESOURCE_BUFFER, vbo, getByteSize());
+}
+
+
+void TessellatedShapes::bind() const
+{
+    glBindVertexArray(vao);
+    glPatchParameteri(GL_PATCH_VERTICES, 1);
+}
+
+
+void TessellatedShapes::draw(const PatchRange& range) const
+{
+    glDrawArrays(GL_PATCHES, range.first, range.count);
+}
+
+
+void TessellatedShapes::addQuarterTurns(TessShapeKind kind, const GLfloat origin[3], const GLfloat shape[3],
+                                        float uRadius, float vRadius, float vTurns)
+{
+    for (int i = 0; i < PATCHES_PER_TURN; ++i)
+    {
+        TessPatch patch = {};
+        for (int k = 0; k < 3; ++k)
+        {
+            patch.origin[k] = origin[k];
+            patch.shape[k] = shape[k];
+        }
+        patch.range[0] = (float)i / PATCHES_PER_TURN;
+        patch.range[1] = (float)(i + 1) / PATCHES_PER_TURN;
+        patch.range[2] = 0.0f;
+        patch.range[3] = 1.0f;
+        patch.detail[0] = uRadius;
+        patch.detail[1] = 1.0f / PATCHES_PER_TURN;
+        patch.detail[2] = vRadius;
+        patch.detail[3] = vTurns;
+        patch.kind = kind;
+        patches.push_back(patch);
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef TESSELLATED_SHAPES_H
+#define TESSELLATED_SHAPES_H
+
+#include <cstddef>
+#include <vector>
+#include <GL/glew.h>
+
+#include "GLResources.h"
+
+// Surface a patch evaluates, matches the branches of the tessellation evaluation shader
+enum TessShapeKind
+{
+    TESS_CYLINDER_SIDE = 0,
+    TESS_DISK = 1,
+    TESS_TORUS = 2,
+    TESS_SPHERE = 3
+};
+
+// One patch is a single control point, the shaders read its fields as vertex attributes 0-4
+struct TessPatch
+{
+    GLfloat origin[4];      // centre of the primitive's axis, w unused
+    GLfloat shape[4];       // side: radius, z0, z1; disk: radius, z, normal z; torus: tube and ring radius; sphere: radius
+    GLfloat range[4];       // the patch's part of the domain: u0, u1 in turns around the axis, v0, v1
+    GLfloat detail[4];      // curvature radius and turns covered along u, then along v, for the tessellation levels
+    GLint kind;             // TessShapeKind
+    GLint padding[3];
+};
+
+// The patches of one primitive and its bounding sphere
+struct PatchRange
+{
+    GLint first = 0;
+    GLsizei count = 0;
+    GLfloat center[3] = { 0.0f, 0.0f, 0.0f };
+    GLfloat radius = 0.0f;
+};
+
+// Whether the driver has tessellation shaders (GL 4.0)
+bool UTessellationSupported();
+
+// Tessellation level the control shader gives an arc of the given radius over the given turns, so its
+// chord error stays under maxPixelError at pixelsPerUnit. Mirrors segments() in the control shader.
+float UTessSegments(float radius, float turns, float pixelsPerUnit, float maxPixelError);
+
+// Cylinders, tori and spheres stored as a handful of patches with their analytic parameters instead of
+// triangle meshes. Every primitive is split into quarter turns around its axis; the control shader picks
+// the tessellation levels from the camera distance and the evaluation shader places each generated vertex
+// on the true surface. All patches of a primitive get the same levels so their shared edges match.
+class TessellatedShapes
+{
+public:
+    TessellatedShapes() {}
+    ~TessellatedShapes() {}
+
+    void create(GLResourceRegistry& resources);
+    void destroy(GLResourceRegistry& resources);
+
+    // Placed like DrawCylinder: circles at z and at length around (cx, cy), plus both caps
+    PatchRange addCylinder(float cx, float cy, float z, float r, float length);
+    // Ring around the Z axis through (x, y, z)
+    PatchRange addTorus(float x, float y, float z, float tubeRadius, float ringRadius);
+    PatchRange addSphere(float x, float y, float z, float radius);
+
+    // uploads the patches added so far, once after the adds
+    void upload();
+
+    // binds the vertex array and sets the patch size, once before any number of draws
+    void bind() const;
+    void draw(const PatchRange& range) const;
+
+    size_t getPatchCount() const    { return patches.size(); }
+    const TessPatch& getPatch(size_t i) const   { return patches[i]; }
+    size_t getByteSize() const      { return patches.size() * sizeof(TessPatch); }
+
+private:
+    void addQuarterTurns(TessShapeKind kind, const GLfloat origin[3], const GLfloat shape[3],
+                         float uRadius, float vRadius, float vTurns);
+
+    GLResourceRegistry* registry = nullptr;
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    std::vector<TessPatch> patches;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#include "ImageDecode.h"
+#include "ImagePreprocess.h"
+#include "TextureDecoder.h"
+
+using namespace std;
+
+
+bool UDecodeImage(DecodedImage& image)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    image.pixels = nullptr;
+    // JPEG colour conversion writes RGBA directly, so the preprocessing below only has to flip
+    int fileChannels = 0;
+    unsigned char* decoded = ULoadImage(image.filename.c_str(), image.width, image.height, fileChannels, 4);
+    if (decoded)
+    {
+        // flip, expand and pad while copying into the upload buffer instead of flipping in place
+        image.channels = 4;
+        PreprocessOptions options;
+        image.stride = (int)UPreprocessedStride(image.width, image.channels, options);
+        image.pixels = (unsigned char*)malloc((size_t)image.stride * image.height);
+        if (image.pixels)
+            UPreprocessImage(decoded, image.width, image.height, image.channels, image.pixels, options);
+        image.channels = UPreprocessedChannels(image.channels, options);
+        UFreeImage(decoded);
+    }
+
+    image.decodeSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return image.pixels != nullptr;
+}
+
+
+void UFreeDecodedImage(DecodedImage& image)
+{
+    free(image.pixels);
+    image.pixels = nullptr;
+}
+
+
+double UDecodeImagesParallel(vector<DecodedImage>& images, unsigned int threadCount)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    if (threadCount == 0)
+        threadCount = max(1u, thread::hardware_concurrency());
+    threadCount = min(threadCount, (unsigned int)images.size());
+
+    // each worker pulls the next undecoded image until the list is exhausted
+    atomic<size_t> next(0);
+    vector<thread> workers;
+    for (unsigned int i = 0; i < threadCount; ++i)
+    {
+        workers.push_back(thread([&images, &next]()
+        {
+            for (size_t job = next++; job < images.size(); job = next++)
+                UDecodeImage(images[job]);
+        }));
+    }
+
+    for (size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+
+void UBenchmarkParallelDecoding(const vector<string>& filenames)
+{
+    const int runs = 5;
+    const unsigned int poolThreads = max(1u, thread::hardware_concurrency());
+
+    // the first run of each also warms the file cache, so only the best one counts
+    double serialSeconds = 1e30, parallelSeconds = 1e30;
+    vector<double> imageSeconds(filenames.size(), 1e30);   // per image, from the single-thread runs
+    for (int run = 0; run < runs; ++run)
+    {
+        vector<DecodedImage> images(filenames.size());
+        for (size_t i = 0; i < filenames.size(); ++i)
+            images[i].filename = filenames[i];
+        serialSeconds = min(serialSeconds, UDecodeImagesParallel(images, 1));
+        for (size_t i = 0; i < images.size(); ++i)
+        {
+            imageSeconds[i] = min(imageSeconds[i], images[i].decodeSeconds);
+            UFreeDecodedImage(images[i]);
+        }
+
+        parallelSeconds = min(parallelSeconds, UDecodeImagesParallel(images, poolThreads));
+        for (size_t i = 0; i < images.size(); ++i)
+            UFreeDecodedImage(images[i]);
+    }
+
+    cout << "INFO: Decoding " << filenames.size() << " scene images, best of " << runs << " runs (wall-clock)" << endl;
+    for (size_t i = 0; i < filenames.size(); ++i)
+        cout << "    " << filenames[i] << ": " << imageSeconds[i] * 1000.0 << " ms" << endl;
+    cout << "    1 thread: " << serialSeconds * 1000.0 << " ms" << endl;
+    cout << "    " << poolThreads << " threads: " << parallelSeconds * 1000.0 << " ms ("
+         << (parallelSeconds > 0.0 ? serialSeconds / parallelSeconds : 0.0) << "x)" << endl;
+}
+
+
+// Images are loaded with Y axis going down, but OpenGL's Y axis goes up, so let's flip it
+void flipImageVertically(unsigned char* image, int width, int height, int channels)
+{
+    for (int j = 0; j < height / 2; ++j)
+    {
+        int index1 = j * width * channels;
+        int index2 = (height - 1 - j) * width * channels;
+
+        for (int i = width * channels; i > 0; --i)
+        {
+            unsigned char tmp = image[index1];
+            image[index1] = image[index2];
+            image[index2] = tmp;
+            ++index1;
+            ++index2;
+        }
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef TEXTURE_DECODER_H
+#define TEXTURE_DECODER_H
+
+#include <string>
+#include <vector>
+
+// Pixels decoded from an image file, flipped for OpenGL and ready to upload.
+// Every image is decoded to RGBA, so rows are always a multiple of 4 bytes (GL_UNPACK_ALIGNMENT).
+struct DecodedImage
+{
+    std::string filename;
+    unsigned char* pixels = nullptr;    // owned, release with UFreeDecodedImage
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    int stride = 0;                     // bytes from one row to the next
+    double decodeSeconds = 0.0;         // time spent decoding this image on its thread
+};
+
+// Decodes image.filename and preprocesses it for upload, returns false if the file could not be read
+bool UDecodeImage(DecodedImage& image);
+void UFreeDecodedImage(DecodedImage& image);
+
+// Decodes every image on a pool of worker threads (0 = one per hardware thread).
+// Returns the wall-clock time of the whole batch in seconds.
+double UDecodeImagesParallel(std::vector<DecodedImage>& images, unsigned int threadCount = 0);
+
+// Decodes the files on one thread and on the whole pool (best of a few runs each) and prints both
+// wall-clock times. Call UInitImageDecoder first.
+void UBenchmarkParallelDecoding(const std::vector<std::string>& filenames);
+
+// In-place byte-by-byte flip, superseded by UPreprocessImage and kept as the benchmark baseline
+void flipImageVertically(unsigned char* image, int width, int height, int channels);
+
+#endif
@@ -0,0 +1,308 @@
+#include <algorithm>
+
+#include "GLCallCounter.h"
+#include "TextureStreamer.h"
+
+using namespace std;
+
+namespace
+{
+    // Levels this size and smaller are uploaded at startup and never evicted
+    const uint32_t RESIDENT_LEVEL_SIZE = 64;
+
+    // Uploads done per frame, keeps a burst of finished reads from stalling one frame
+    const int MAX_UPLOADS_PER_FRAME = 2;
+
+    double millisecondsSince(chrono::steady_clock::time_point start)
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+}
+
+
+GLuint TextureStreamer::create(GLResourceRegistry& resources, const vector<string>& cookedFiles, GLenum format, size_t budgetBytes)
+{
+    layers = vector<Layer>(cookedFiles.size());
+    for (size_t i = 0; i < cookedFiles.size(); ++i)
+    {
+        if (!layers[i].cooked.open(cookedFiles[i].c_str()))
+        {
+            layers.clear();
+            return 0;
+        }
+    }
+
+    const CookedTextureHeader& header = layers[0].cooked.getHeader();
+    internalFormat = format;
+    levelCount = (int)header.levelCount;
+    stats = TextureStreamingStats();
+    stats.budgetBytes = budgetBytes;
+
+    // Sparse storage lets each level of each layer be committed on its own
+    GLint pageSizes = 0;
+    if (GLEW_ARB_sparse_texture)
+        glGetInternalformativ(GL_TEXTURE_2D_ARRAY, internalFormat, GL_NUM_VIRTUAL_PAGE_SIZES_ARB, 1, &pageSizes);
+    sparse = pageSizes > 0;
+
+    arrayId = resources.createTexture("streamed material array");
+    glBindTexture(GL_TEXTURE_2D_ARRAY, arrayId);
+    if (sparse)
+    {
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SPARSE_ARB, GL_TRUE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_VIRTUAL_PAGE_SIZE_INDEX_ARB, 0);
+    }
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, levelCount, internalFormat, header.width, header.height, (GLsizei)layers.size());
+
+    // Levels below the sparse page size share one mip tail, committed once for every layer
+    firstTailLevel = levelCount;
+    if (sparse)
+    {
+        glGetTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_NUM_SPARSE_LEVELS_ARB, &firstTailLevel);
+        for (int level = firstTailLevel; level < levelCount; ++level)
+        {
+            const CookedTextureLevel& size = layers[0].cooked.getLevel(level);
+            glTexPageCommitmentARB(GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, size.width, size.height, (GLsizei)layers.size(), GL_TRUE);
+        }
+    }
+
+    minResidentLevel = levelCount - 1;
+    while (minResidentLevel > 0 && layers[0].cooked.getLevel(minResidentLevel - 1).width <= RESIDENT_LEVEL_SIZE)
+        --minResidentLevel;
+    minResidentLevel = min(minResidentLevel, firstTailLevel);
+
+    // the coarse levels of every layer first, so everything can be drawn right away
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        for (int level = levelCount - 1; level >= minResidentLevel; --level)
+        {
+            commit((int)i, level, true);
+            upload((int)i, level, layers[i].cooked.getLevelData(level));
+            stats.residentBytes += levelBytes((int)i, level);
+        }
+        layers[i].residentLevel = minResidentLevel;
+        layers[i].wantedLevel = minResidentLevel;
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // without sparse storage every level is allocated up front
+    size_t allocatedBytes = stats.residentBytes;
+    if (!sparse)
+    {
+        allocatedBytes = 0;
+        for (size_t i = 0; i < layers.size(); ++i)
+            for (int level = 0; level < levelCount; ++level)
+                allocatedBytes += levelBytes((int)i, level);
+    }
+    resources.setSize(GL_RESOURCE_TEXTURE, arrayId, allocatedBytes);
+
+    stopping = false;
+    worker = thread(&TextureStreamer::workerLoop, this);
+    return arrayId;
+}
+
+
+void TextureStreamer::destroy(GLResourceRegistry& resources)
+{
+    stopWorker();
+    resources.destroy(GL_RESOURCE_TEXTURE, arrayId);
+    arrayId = 0;
+    layers.clear();
+    queued.clear();
+    finished.clear();
+}
+
+
+void TextureStreamer::requestLevel(int layer, int level)
+{
+    Layer& target = layers[layer];
+    level = max(0, min(level, minResidentLevel));
+    if (target.lastUsedFrame != frame)
+        target.wantedLevel = level;
+    else
+        target.wantedLevel = min(target.wantedLevel, level);
+    target.lastUsedFrame = frame;
+}
+
+
+void TextureStreamer::update(GLResourceRegistry& resources)
+{
+    // layers nobody drew this frame only need their resident levels
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        if (layers[i].lastUsedFrame != frame)
+            layers[i].wantedLevel = minResidentLevel;
+    }
+
+    // upload the levels the worker has read
+    vector<Load> ready;
+    {
+        lock_guard<mutex> lock(queueMutex);
+        size_t count = min(finished.size(), (size_t)MAX_UPLOADS_PER_FRAME);
+        for (size_t i = 0; i < count; ++i)
+            ready.push_back(move(finished[i]));
+        finished.erase(finished.begin(), finished.begin() + count);
+    }
+
+    if (!ready.empty())
+    {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, arrayId);
+        for (size_t i = 0; i < ready.size(); ++i)
+        {
+            Load& load = ready[i];
+            size_t bytes = levelBytes(load.layer, load.level);
+            commit(load.layer, load.level, true);
+            upload(load.layer, load.level, load.data.data());
+
+            Layer& layer = layers[load.layer];
+            layer.residentLevel = load.level;
+            layer.loading = false;
+            pendingBytes -= bytes;
+            stats.residentBytes += bytes;
+
+            double latencyMs = millisecondsSince(load.requested);
+            ++stats.streamed;
+            stats.totalLatencyMs += latencyMs;
+            stats.maxLatencyMs = max(stats.maxLatencyMs, latencyMs);
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+
+    // schedule the next finer level of every layer that needs more detail, largest shortfall first
+    vector<int> order;
+    for (size_t i = 0; i < layers.size(); ++i)
+    {
+        if (!layers[i].loading && layers[i].wantedLevel < layers[i].residentLevel)
+            order.push_back((int)i);
+    }
+    sort(order.begin(), order.end(), [this](int a, int b)
+    {
+        return layers[a].residentLevel - layers[a].wantedLevel > layers[b].residentLevel - layers[b].wantedLevel;
+    });
+
+    for (size_t i = 0; i < order.size(); ++i)
+    {
+        Layer& layer = layers[order[i]];
+        int level = layer.residentLevel - 1;
+        size_t bytes = levelBytes(order[i], level);
+        if (!makeRoom(bytes, order[i]))
+            break;
+
+        Load load;
+        load.layer = order[i];
+        load.level = level;
+        load.requested = chrono::steady_clock::now();
+        layer.loading = true;
+        pendingBytes += bytes;
+
+        lock_guard<mutex> lock(queueMutex);
+        queued.push_back(move(load));
+        wake.notify_one();
+    }
+
+    stats.pending = 0;
+    for (size_t i = 0; i < layers.size(); ++i)
+        stats.pending += layers[i].loading ? 1 : 0;
+
+    if (sparse)
+        resources.setSize(GL_RESOURCE_TEXTURE, arrayId, stats.residentBytes);
+    ++frame;
+}
+
+
+void TextureStreamer::printStats(ostream& out) const
+{
+    out << "INFO: Texture streaming (" << (sparse ? "sparse" : "fully allocated") << " array): "
+        << stats.residentBytes / 1024 << " KB resident of " << stats.budgetBytes / 1024 << " KB budget, "
+        << stats.streamed << " levels streamed in, " << stats.evicted << " evicted, " << stats.pending << " pending";
+    if (stats.streamed > 0)
+        out << ", latency avg " << stats.totalLatencyMs / stats.streamed << " ms max " << stats.maxLatencyMs << " ms";
+    out << endl;
+}
+
+
+// Drops the finest level of the least recently used layers that hold more detail than they need,
+// until bytes fit in the budget next to what is resident and in flight
+bool TextureStreamer::makeRoom(size_t bytes, int forLayer)
+{
+    while (stats.residentBytes + pendingBytes + bytes > stats.budgetBytes)
+    {
+        int victim = -1;
+        for (size_t i = 0; i < layers.size(); ++i)
+        {
+            const Layer& layer = layers[i];
+            if ((int)i == forLayer || layer.loading || layer.residentLevel >= layer.wantedLevel)
+                continue;
+            if (victim < 0 || layer.lastUsedFrame < layers[victim].lastUsedFrame)
+                victim = (int)i;
+        }
+        if (victim < 0)
+            return false;
+
+        Layer& layer = layers[victim];
+        stats.residentBytes -= levelBytes(victim, layer.residentLevel);
+        commit(victim, layer.residentLevel, false);
+        ++layer.residentLevel;
+        ++stats.evicted;
+    }
+    return true;
+}
+
+
+void TextureStreamer::upload(int layer, int level, const unsigned char* data)
+{
+    const CookedTextureLevel& size = layers[layer].cooked.getLevel(level);
+    if (internalFormat == GL_RGBA8)
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, size.width, size.height, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    else
+        glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, size.width, size.height, 1, internalFormat, (GLsizei)size.size, data);
+}
+
+
+// Commits or releases the pages of one level of one layer, the mip tail stays committed
+void TextureStreamer::commit(int layer, int level, bool resident)
+{
+    if (!sparse || level >= firstTailLevel)
+        return;
+
+    const CookedTextureLevel& size = layers[layer].cooked.getLevel(level);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, arrayId);
+    glTexPageCommitmentARB(GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, size.width, size.height, 1, resident ? GL_TRUE : GL_FALSE);
+}
+
+
+void TextureStreamer::workerLoop()
+{
+    unique_lock<mutex> lock(queueMutex);
+    while (true)
+    {
+        wake.wait(lock, [this]() { return stopping || !queued.empty(); });
+        if (stopping)
+            return;
+
+        Load load = move(queued.front());
+        queued.pop_front();
+        lock.unlock();
+
+        // the copy touches every page of the level, faulting it in from disk here
+        const CookedTexture& cooked = layers[load.layer].cooked;
+        const unsigned char* data = cooked.getLevelData(load.level);
+        load.data.assign(data, data + cooked.getLevel(load.level).size);
+
+        lock.lock();
+        finished.push_back(move(load));
+    }
+}
+
+
+void TextureStreamer::stopWorker()
+{
+    if (!worker.joinable())
+        return;
+
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+}
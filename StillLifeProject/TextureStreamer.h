@@ -0,0 +1,107 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <GL/glew.h>
+
+#include "CookedTexture.h"
+#include "GLResources.h"
+
+// Counters reported by the texture streamer
+struct TextureStreamingStats
+{
+    size_t residentBytes = 0;       // levels currently sampleable, all layers
+    size_t budgetBytes = 0;
+    unsigned int pending = 0;       // levels being read or waiting for upload
+    unsigned int streamed = 0;      // levels uploaded after startup
+    unsigned int evicted = 0;       // levels dropped to stay under the budget
+    double totalLatencyMs = 0.0;    // request to upload, summed over the streamed levels
+    double maxLatencyMs = 0.0;
+};
+
+// Streams the mip levels of a texture array from cooked files on demand.
+// At startup only the small levels of every layer are uploaded. Each frame the renderer asks for the
+// finest level it needs per layer, a worker thread reads the missing levels from the mapped files and
+// the render thread uploads a few of them per frame. Layers are refined one level at a time, coarse to fine.
+// When the budget is reached, levels finer than needed are evicted from the least recently used layers.
+// With ARB_sparse_texture the pages of evicted levels are decommitted, otherwise the full storage stays
+// allocated and the budget only limits what is resident.
+class TextureStreamer
+{
+public:
+    TextureStreamer() {}
+    ~TextureStreamer() { stopWorker(); }
+
+    // Opens the cooked files (one per layer, all the same size and format), creates the array
+    // and uploads the resident levels. Returns 0 if a file cannot be opened.
+    GLuint create(GLResourceRegistry& resources, const std::vector<std::string>& cookedFiles, GLenum internalFormat, size_t budgetBytes);
+    void destroy(GLResourceRegistry& resources);
+
+    // Finest level the current frame needs from a layer, the smallest request of the frame wins
+    void requestLevel(int layer, int level);
+
+    // Once per frame after the requests: uploads finished reads, evicts and schedules new reads
+    void update(GLResourceRegistry& resources);
+
+    // Finest level of a layer that can be sampled, the shader clamps its LOD to it
+    int getResidentLevel(int layer) const   { return layers[layer].residentLevel; }
+    int getLevelCount() const               { return levelCount; }
+    bool isSparse() const                   { return sparse; }
+    const TextureStreamingStats& getStats() const { return stats; }
+
+    void printStats(std::ostream& out) const;
+
+private:
+    struct Layer
+    {
+        CookedTexture cooked;
+        int residentLevel = 0;
+        int wantedLevel = 0;            // requested this frame
+        unsigned int lastUsedFrame = 0;
+        bool loading = false;           // a level is being read or waits for upload
+    };
+
+    struct Load
+    {
+        int layer;
+        int level;
+        std::chrono::steady_clock::time_point requested;
+        std::vector<unsigned char> data;
+    };
+
+    void workerLoop();
+    void stopWorker();
+    void upload(int layer, int level, const unsigned char* data);
+    void commit(int layer, int level, bool resident);
+    bool makeRoom(size_t bytes, int forLayer);
+    size_t levelBytes(int layer, int level) const { return (size_t)layers[layer].cooked.getLevel(level).size; }
+
+    GLuint arrayId = 0;
+    GLenum internalFormat = GL_RGBA8;
+    int levelCount = 0;
+    int minResidentLevel = 0;       // levels from here down are always resident
+    int firstTailLevel = 0;         // first level of the sparse mip tail
+    bool sparse = false;
+    unsigned int frame = 0;
+    size_t pendingBytes = 0;        // budget reserved for levels in flight
+    std::vector<Layer> layers;
+    TextureStreamingStats stats;
+
+    // worker thread, reads levels from the mapped files so page faults stay off the render thread
+    std::thread worker;
+    std::mutex queueMutex;
+    std::condition_variable wake;
+    std::deque<Load> queued;
+    std::vector<Load> finished;
+    bool stopping = false;
+};
+
+#endif
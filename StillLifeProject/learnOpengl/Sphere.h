@@ -12,13 +12,23 @@
 #ifndef GEOMETRY_SPHERE_H
 #define GEOMETRY_SPHERE_H
 
-#include <vector>
+#include <cstddef>
+#include "ScratchArena.h"
+
+// CPU arrays a build keeps, triangle indices are always built
+enum SphereData
+{
+    SPHERE_INTERLEAVED  = 0x1,              // V/N/T interleaved vertices
+    SPHERE_SEPARATE     = 0x2,              // separate vertex, normal and tex coord arrays
+    SPHERE_LINES        = 0x4,              // line indices for drawLines()
+    SPHERE_ALL          = SPHERE_INTERLEAVED | SPHERE_SEPARATE | SPHERE_LINES
+};
 
 class Sphere
 {
 public:
     // ctor/dtor
-    Sphere(float radius=1.0f, int sectorCount=36, int stackCount=18, bool smooth=true);
+    Sphere(float radius=1.0f, int sectorCount=36, int stackCount=18, bool smooth=true, int dataFlags=SPHERE_ALL);
     ~Sphere() {}
 
     // getters/setters
@@ -30,30 +40,41 @@ public:
     void setSectorCount(int sectorCount);
     void setStackCount(int stackCount);
     void setSmooth(bool smooth);
+    int getDataFlags() const                { return dataFlags; }
+    void setDataFlags(int dataFlags);       // rebuilds with the given SphereData arrays
+
+    // frees every CPU array once the data is uploaded, the counts stay valid until the next build
+    void releaseData();
+    bool isReleased() const                 { return released; }
+    std::size_t getDataSize() const         { return arena.getCapacity(); }     // # of bytes held for the CPU arrays
+
+    // every array lives in one scratch arena that is reset, not freed, by a rebuild,
+    // so rebuilding at the same or a smaller size takes nothing from the heap
+    std::size_t getHeapAllocations() const  { return arena.getHeapAllocations(); }
 
     // for vertex data
-    unsigned int getVertexCount() const     { return (unsigned int)vertices.size() / 3; }
-    unsigned int getNormalCount() const     { return (unsigned int)normals.size() / 3; }
-    unsigned int getTexCoordCount() const   { return (unsigned int)texCoords.size() / 2; }
-    unsigned int getIndexCount() const      { return (unsigned int)indices.size(); }
-    unsigned int getLineIndexCount() const  { return (unsigned int)lineIndices.size(); }
+    unsigned int getVertexCount() const     { return vertexCount; }
+    unsigned int getNormalCount() const     { return normals ? vertexCount : 0; }
+    unsigned int getTexCoordCount() const   { return texCoords ? vertexCount : 0; }
+    unsigned int getIndexCount() const      { return indexCount; }
+    unsigned int getLineIndexCount() const  { return lineIndexCount; }
     unsigned int getTriangleCount() const   { return getIndexCount() / 3; }
-    unsigned int getVertexSize() const      { return (unsigned int)vertices.size() * sizeof(float); }
-    unsigned int getNormalSize() const      { return (unsigned int)normals.size() * sizeof(float); }
-    unsigned int getTexCoordSize() const    { return (unsigned int)texCoords.size() * sizeof(float); }
-    unsigned int getIndexSize() const       { return (unsigned int)indices.size() * sizeof(unsigned int); }
-    unsigned int getLineIndexSize() const   { return (unsigned int)lineIndices.size() * sizeof(unsigned int); }
-    const float* getVertices() const        { return vertices.data(); }
-    const float* getNormals() const         { return normals.data(); }
-    const float* getTexCoords() const       { return texCoords.data(); }
-    const unsigned int* getIndices() const  { return indices.data(); }
-    const unsigned int* getLineIndices() const  { return lineIndices.data(); }
+    unsigned int getVertexSize() const      { return vertices ? vertexCount * 3 * sizeof(float) : 0; }
+    unsigned int getNormalSize() const      { return getNormalCount() * 3 * sizeof(float); }
+    unsigned int getTexCoordSize() const    { return getTexCoordCount() * 2 * sizeof(float); }
+    unsigned int getIndexSize() const       { return indices ? indexCount * sizeof(unsigned int) : 0; }
+    unsigned int getLineIndexSize() const   { return lineIndices ? lineIndexCount * sizeof(unsigned int) : 0; }
+    const float* getVertices() const        { return vertices; }
+    const float* getNormals() const         { return normals; }
+    const float* getTexCoords() const       { return texCoords; }
+    const unsigned int* getIndices() const  { return indices; }
+    const unsigned int* getLineIndices() const  { return lineIndices; }
 
     // for interleaved vertices: V/N/T
     unsigned int getInterleavedVertexCount() const  { return getVertexCount(); }    // # of vertices
-    unsigned int getInterleavedVertexSize() const   { return (unsigned int)interleavedVertices.size() * sizeof(float); }    // # of bytes
+    unsigned int getInterleavedVertexSize() const   { return interleavedVertices ? vertexCount * interleavedStride : 0; }  // # of bytes
     int getInterleavedStride() const                { return interleavedStride; }   // should be 32 bytes
-    const float* getInterleavedVertices() const     { return interleavedVertices.data(); }
+    const float* getInterleavedVertices() const     { return interleavedVertices; }
 
     // draw in VertexArray mode
     void draw() const;                                  // draw surface
@@ -69,29 +90,35 @@ private:
     // member functions
     void buildVerticesSmooth();
     void buildVerticesFlat();
-    void buildInterleavedVertices();
+    void buildSeparateArrays();
     void clearArrays();
-    void addVertex(float x, float y, float z);
-    void addNormal(float x, float y, float z);
-    void addTexCoord(float s, float t);
+    void build();
+    void addVertex(float x, float y, float z, const float normal[3], float s, float t);
     void addIndices(unsigned int i1, unsigned int i2, unsigned int i3);
-    std::vector<float> computeFaceNormal(float x1, float y1, float z1,
-                                         float x2, float y2, float z2,
-                                         float x3, float y3, float z3);
+    void addLineIndices(unsigned int i1, unsigned int i2);
+    void computeFaceNormal(float x1, float y1, float z1,
+                           float x2, float y2, float z2,
+                           float x3, float y3, float z3, float normal[3]);
 
     // memeber vars
     float radius;
     int sectorCount;                        // longitude, # of slices
     int stackCount;                         // latitude, # of stacks
     bool smooth;
-    std::vector<float> vertices;
-    std::vector<float> normals;
-    std::vector<float> texCoords;
-    std::vector<unsigned int> indices;
-    std::vector<unsigned int> lineIndices;
+    int dataFlags;                          // SphereData
+    bool released;
+    unsigned int vertexCount;
+    unsigned int indexCount;
+    unsigned int lineIndexCount;
+    ScratchArena arena;                     // holds every array below, null when not built
+    float* vertices;
+    float* normals;
+    float* texCoords;
+    unsigned int* indices;
+    unsigned int* lineIndices;
 
     // interleaved
-    std::vector<float> interleavedVertices;
+    float* interleavedVertices;
     int interleavedStride;                  // # of bytes to hop to the next vertex (should be 32 bytes)
 
 };